@@ -0,0 +1,189 @@
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffers
+ *
+ * SPSCbuf moves elements from one producer to one consumer, SPSCfanout from
+ * one producer to several consumers, each with its own read cursor. The
+ * producer can be an interrupt handler and the consumers the main loop, or
+ * the other way around, without ever disabling interrupts.
+ *
+ * The storage is static and sized by a power of two, so that the free
+ * running 16-bit indexes are turned into positions by a mask and the fill
+ * level is their difference, even across the index wrap.
+ *
+ * Each index is written by one side only. The writer publishes it with a
+ * release store, after the element copy, and the other side reads it with an
+ * acquire load, before touching the element. On Cortex-M0+ GCC emits a DMB
+ * barrier for both, on a host the same builtins are understood by
+ * ThreadSanitizer. No read-modify-write atomic is used, the M0+ has none.
+ *
+ * Plain C++11, no Arduino dependency, so it also builds on a host.
+ */
+
+#ifndef SPSCBUF_H
+#define SPSCBUF_H
+
+#include <stdint.h>
+
+#define SPSC_LOAD(index) __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define SPSC_STORE(index, value) __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+template <typename T, uint16_t SIZE>
+class SPSCbuf {
+    static_assert(SIZE >= 2 && SIZE <= 0x8000 && (SIZE & (SIZE - 1)) == 0,
+                  "SPSCbuf size must be a power of two, up to 32768");
+
+    private:
+        static const uint16_t _mask = SIZE - 1;
+        T _buffer[SIZE];
+        uint16_t _head;      // Next position to write, written by the producer
+        uint16_t _tail;      // Next position to read, written by the consumer
+        uint16_t _highWater; // Highest fill level, written by the producer
+
+    public:
+        SPSCbuf() : _head(0), _tail(0), _highWater(0) {}
+
+        // Producer: append an element, false if the buffer is full
+        bool push(const T& element) {
+            uint16_t head = _head;
+            uint16_t used = head - SPSC_LOAD(_tail);
+            if (used == SIZE) {
+                return false;
+            }
+
+            _buffer[head & _mask] = element;
+            SPSC_STORE(_head, (uint16_t)(head + 1));
+
+            if (used + 1 > _highWater) {
+                _highWater = used + 1;
+            }
+            return true;
+        }
+
+        // Consumer: take the oldest element, false if the buffer is empty
+        bool pop(T& element) {
+            uint16_t tail = _tail;
+            if (tail == SPSC_LOAD(_head)) {
+                return false;
+            }
+
+            element = _buffer[tail & _mask];
+            SPSC_STORE(_tail, (uint16_t)(tail + 1));
+            return true;
+        }
+
+        // Consumer: drop all the elements
+        void clear() {
+            SPSC_STORE(_tail, SPSC_LOAD(_head));
+        }
+
+        uint16_t size() {
+            return (uint16_t)(SPSC_LOAD(_head) - SPSC_LOAD(_tail));
+        }
+
+        bool empty() {
+            return size() == 0;
+        }
+
+        bool full() {
+            return size() == SIZE;
+        }
+
+        // Highest fill level seen since construction
+        uint16_t highWater() {
+            return _highWater;
+        }
+};
+
+/**
+ * @brief One producer, READERS consumers each reading every element.
+ *
+ * A slot is free again once all the readers have read it, so the slowest
+ * reader sets the fill level. When full, push() drops the new element and
+ * counts it: a stuck reader (e.g. the SD card) must not stall the producer.
+ * Each reader must be drained by a single consumer.
+ */
+template <typename T, uint16_t SIZE, uint8_t READERS>
+class SPSCfanout {
+    static_assert(SIZE >= 2 && SIZE <= 0x8000 && (SIZE & (SIZE - 1)) == 0,
+                  "SPSCfanout size must be a power of two, up to 32768");
+    static_assert(READERS >= 1, "SPSCfanout needs at least one reader");
+
+    private:
+        static const uint16_t _mask = SIZE - 1;
+        T _buffer[SIZE];
+        uint16_t _head;            // Written by the producer
+        uint16_t _tail[READERS];   // Each written by its reader
+        uint16_t _highWater;       // Written by the producer
+        uint32_t _dropped;         // Written by the producer
+
+        // Fill level as seen by the slowest reader
+        uint16_t used(uint16_t head) {
+            uint16_t maxUsed = 0;
+            for (uint8_t reader = 0; reader < READERS; reader++) {
+                uint16_t readerUsed = head - SPSC_LOAD(_tail[reader]);
+                if (readerUsed > maxUsed) {
+                    maxUsed = readerUsed;
+                }
+            }
+            return maxUsed;
+        }
+
+    public:
+        SPSCfanout() : _head(0), _highWater(0), _dropped(0) {
+            for (uint8_t reader = 0; reader < READERS; reader++) {
+                _tail[reader] = 0;
+            }
+        }
+
+        // Producer: append an element, false (and counted) if a reader is full
+        bool push(const T& element) {
+            uint16_t head = _head;
+            uint16_t inUse = used(head);
+            if (inUse == SIZE) {
+                _dropped++;
+                return false;
+            }
+
+            _buffer[head & _mask] = element;
+            SPSC_STORE(_head, (uint16_t)(head + 1));
+
+            if (inUse + 1 > _highWater) {
+                _highWater = inUse + 1;
+            }
+            return true;
+        }
+
+        // Reader: take its oldest unread element, false if none
+        bool pop(uint8_t reader, T& element) {
+            uint16_t tail = _tail[reader];
+            if (tail == SPSC_LOAD(_head)) {
+                return false;
+            }
+
+            element = _buffer[tail & _mask];
+            SPSC_STORE(_tail[reader], (uint16_t)(tail + 1));
+            return true;
+        }
+
+        // Reader: skip all its unread elements
+        void clear(uint8_t reader) {
+            SPSC_STORE(_tail[reader], SPSC_LOAD(_head));
+        }
+
+        // Elements not read yet by a reader
+        uint16_t size(uint8_t reader) {
+            return (uint16_t)(SPSC_LOAD(_head) - SPSC_LOAD(_tail[reader]));
+        }
+
+        // Highest fill level seen since construction
+        uint16_t highWater() {
+            return _highWater;
+        }
+
+        // Elements dropped because a reader was full
+        uint32_t dropped() {
+            return _dropped;
+        }
+};
+
+#endif // SPSCBUF_H
@@ -0,0 +1,155 @@
+/**
+ * @file calibration.cpp
+ * @brief Source file for the per-board calibration.
+ *
+ * The right shifts of negative values are arithmetic with GCC.
+ */
+
+#include "calibration.h"
+#include "nvm.h"
+#include <math.h>
+
+#define CALIBRATION_ONE ((int32_t)1 << CALIBRATION_Q)
+#define CALIBRATION_MAX_GAIN 64 // Keeps the Q24 multipliers in 31 bits
+#define CALIBRATION_MAX_TEMP_COEF 100000 // [ppm/°C] Keeps the Q32 coefficient in 31 bits
+
+static constexpr struct CalibrationRecord nominal = {
+    {1, 1, 1, 1}, // gain
+    {0, 0, 0, 0}, // offset
+    {1, 1, 1},    // pumpGain
+    0,            // tempCoef
+    25            // tempRef
+};
+
+static struct CalibrationRecord record = nominal;
+
+// Fixed-point form of the record
+static int32_t gain[CALIBRATION_RANGE_COUNT];   // Q24
+static int64_t offset[CALIBRATION_RANGE_COUNT]; // [aA]
+static int32_t pumpGain[CALIBRATION_PUMP_COUNT]; // Q24
+static int32_t tempCoef; // Q32 per centidegree
+static int32_t tempRef;  // [centidegree]
+
+
+static int32_t toQ24(float value) {
+    return (int32_t)lround(value * (double)CALIBRATION_ONE);
+}
+
+/**
+ * @brief Multiply by a Q24 multiplier, split so that the product stays in
+ * 64 bits: the multipliers being below 2^30, for |value| below 2^57 aA. A
+ * larger product saturates. The product is rounded to nearest, not down.
+ */
+static int64_t mulQ24(int64_t value, int32_t multiplier) {
+    int64_t high = value >> CALIBRATION_Q;
+    int64_t low = value & (CALIBRATION_ONE - 1);
+    int64_t lowProduct = (low * multiplier + (CALIBRATION_ONE >> 1)) >> CALIBRATION_Q;
+    int64_t product;
+    if (__builtin_mul_overflow(high, (int64_t)multiplier, &product)
+        || __builtin_add_overflow(product, lowProduct, &product)) {
+        return (value < 0) != (multiplier < 0) ? INT64_MIN : INT64_MAX;
+    }
+    return product;
+}
+
+static void precompute() {
+    for (uint8_t i = 0; i < CALIBRATION_RANGE_COUNT; i++) {
+        gain[i] = toQ24(record.gain[i]);
+        offset[i] = llround(record.offset[i] * 1000.0);
+    }
+    for (uint8_t i = 0; i < CALIBRATION_PUMP_COUNT; i++) {
+        pumpGain[i] = toQ24(record.pumpGain[i]);
+    }
+    // ppm/°C to a fraction per centidegree, Q32
+    tempCoef = (int32_t)lround(record.tempCoef * 1e-8 * 4294967296.0);
+    tempRef = (int32_t)lround(record.tempRef * 100);
+}
+
+static bool gainValid(float value) {
+    return value > 0 && value < CALIBRATION_MAX_GAIN;
+}
+
+
+bool calibration_init() {
+    struct CalibrationRecord stored;
+    bool found = nvm_read(&stored, sizeof(stored)) && calibration_set(stored);
+    if (!found) {
+        calibration_reset();
+    }
+    return found;
+}
+
+uint8_t calibration_range(int64_t current) {
+    // Same ranges as fpga_format_current(), in aA
+    uint64_t magnitude = current < 0 ? -current : current;
+    if (magnitude < 1000000ULL) {
+        return 0;
+    } else if (magnitude < 1000000000ULL) {
+        return 1;
+    } else if (magnitude < 1000000000000ULL) {
+        return 2;
+    }
+    return 3;
+}
+
+int64_t calibration_charge(int64_t charge, const struct rawDataFPGA& frame) {
+    const uint32_t counts[CALIBRATION_PUMP_COUNT] = {frame.cp1Count, frame.cp2Count, frame.cp3Count};
+
+    for (uint8_t i = 0; i < CALIBRATION_PUMP_COUNT; i++) {
+        if (pumpGain[i] != CALIBRATION_ONE && counts[i] != 0) {
+            int64_t pumped = (int64_t)counts[i] * conf.acc.chargeQuantaCP[i];
+            charge += mulQ24(pumped, pumpGain[i] - CALIBRATION_ONE);
+        }
+    }
+    return charge;
+}
+
+int64_t calibration_pump_charge(uint8_t pump, int64_t charge) {
+    return mulQ24(charge, pumpGain[pump]);
+}
+
+int64_t calibration_current(int64_t current, const struct rawDataFPGA& frame) {
+    uint8_t range = calibration_range(current);
+    current = mulQ24(current, gain[range]) + offset[range];
+
+    if (tempCoef != 0) {
+        // SHT41 datasheet formula, in centidegrees
+        int32_t temperature = (int32_t)(17500UL * frame.tempSht41 / 65535) - 4500;
+        int64_t correction = ((int64_t)(temperature - tempRef) * tempCoef) >> (32 - CALIBRATION_Q);
+        current = mulQ24(current, CALIBRATION_ONE + (int32_t)correction);
+    }
+    return current;
+}
+
+const struct CalibrationRecord* calibration_get() {
+    return &record;
+}
+
+bool calibration_set(const struct CalibrationRecord& newRecord) {
+    for (uint8_t i = 0; i < CALIBRATION_RANGE_COUNT; i++) {
+        if (!gainValid(newRecord.gain[i]) || isnan(newRecord.offset[i])) {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < CALIBRATION_PUMP_COUNT; i++) {
+        if (!gainValid(newRecord.pumpGain[i])) {
+            return false;
+        }
+    }
+    if (!(fabs(newRecord.tempCoef) < CALIBRATION_MAX_TEMP_COEF) || isnan(newRecord.tempRef)) {
+        return false;
+    }
+
+    record = newRecord;
+    precompute();
+    return true;
+}
+
+void calibration_reset() {
+    record = nominal;
+    precompute();
+}
+
+bool calibration_save() {
+    return nvm_write(&record, sizeof(record));
+}
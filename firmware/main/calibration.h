@@ -0,0 +1,92 @@
+/**
+ * @file calibration.h
+ * @brief Per-board calibration of the current.
+ *
+ * The record holds, as entered:
+ * - a gain and an offset per current range (fA, pA, nA, uA), the range
+ *   being picked from the uncalibrated current;
+ * - a gain per charge pump, the ratio of its real quantum to the
+ *   configured one;
+ * - a temperature coefficient, from the SHT41 reading of each frame, 0 to
+ *   disable it.
+ *
+ * On every change the record is turned into fixed-point multipliers (Q24),
+ * so applying it to a frame takes a few integer multiplications. It is
+ * kept in flash by nvm.h, loaded at boot, nominal if none is stored.
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define CALIBRATION_RANGE_COUNT 4 // fA, pA, nA, uA
+#define CALIBRATION_PUMP_COUNT 3
+#define CALIBRATION_Q 24          // Fractional bits of the multipliers
+
+/**
+ * @brief The calibration record, as stored.
+ */
+struct CalibrationRecord {
+    float gain[CALIBRATION_RANGE_COUNT];   //!< Current gain per range
+    float offset[CALIBRATION_RANGE_COUNT]; //!< Current offset per range [fA], added after the gain
+    float pumpGain[CALIBRATION_PUMP_COUNT]; //!< Real over configured quantum, per pump
+    float tempCoef;  //!< Current change per degree [ppm/°C]
+    float tempRef;   //!< Temperature of no correction [°C]
+};
+
+/**
+ * @brief Load the record stored in flash, or the nominal one.
+ * @return True if a stored record was found.
+ */
+bool calibration_init();
+
+/**
+ * @brief Current range of an uncalibrated current.
+ * @param current [aA]
+ */
+uint8_t calibration_range(int64_t current);
+
+/**
+ * @brief Correct a charge for the real quantum of the pumps.
+ * @param charge Charge counted with the configured quanta [LSB]
+ * @param frame The frame, for the activations of each pump.
+ */
+int64_t calibration_charge(int64_t charge, const struct rawDataFPGA& frame);
+
+/**
+ * @brief Correct a charge of one pump only.
+ * @param pump 0 to 2.
+ */
+int64_t calibration_pump_charge(uint8_t pump, int64_t charge);
+
+/**
+ * @brief Apply the range gain and offset and the temperature correction.
+ * @param current Current from the pump corrected charge [aA]
+ */
+int64_t calibration_current(int64_t current, const struct rawDataFPGA& frame);
+
+/**
+ * @brief The record in use.
+ */
+const struct CalibrationRecord* calibration_get();
+
+/**
+ * @brief Use a record, not yet stored.
+ * @return False if a gain is not positive.
+ */
+bool calibration_set(const struct CalibrationRecord& record);
+
+/**
+ * @brief Use the nominal record, not yet stored.
+ */
+void calibration_reset();
+
+/**
+ * @brief Store the record in use in flash.
+ */
+bool calibration_save();
+
+#endif // CALIBRATION_H
@@ -20,6 +20,7 @@ struct confACCURATE {
     uint8_t tInjection; //!< Time duration in clock cycles for activation (injection) of the charge pump. 0 is automatically corrected to 1
     uint8_t disableCP[3]; //!< Do not use the corresponding charge pump
     uint8_t singlyCPActivation; //!< If high and multiple charge pumps would activate at the same time, only the largest one activates
+    uint16_t windowPeriod; //!< Integration window period in ms, from MIN_WINDOW_PERIOD to MAX_WINDOW_PERIOD
 };
 
 /**
@@ -33,6 +34,51 @@ struct confSerial {
     bool stream;    //!< Stream flag, if true the data is streamed on serial port
     bool rawOutput; //!< Raw output flag, if true the output is raw
     bool log;       //!< Log flag, if true the data is logged on the SD card
+    bool integral;  //!< Integral flag, if true the charge integral is appended to the output
+};
+
+/**
+ * @brief Struct to hold the OLED display configuration.
+ *
+ * @warning These parameters are not FPGA releted, as for confSerial.
+*/
+struct confDisplay {
+    bool enable;     //!< If false the display is turned off and never refreshed
+    uint8_t maxRate; //!< Maximum refresh rate [Hz]
+    bool average;    //!< If true show the average of the samples since the last refresh, else the latest
+};
+
+/**
+ * @brief Struct to hold the LTC2471 ADC configuration.
+*/
+struct confAdc {
+    bool enable; //!< If true the ADC is sampled in the background
+};
+
+/**
+ * @brief Struct to hold the I2C bus configuration.
+*/
+struct confI2c {
+    uint32_t clock; //!< SCL frequency [Hz], Fast-mode Plus above 400 kHz
+};
+
+/**
+ * @brief Struct to hold the current calculation configuration.
+*/
+struct confCalc {
+    bool interval; //!< If true the current is estimated from the CP1 activation interval, where possible
+};
+
+/**
+ * @brief Struct to hold the filter stage configuration.
+*/
+struct confFilter {
+    uint8_t type;   //!< Filter, enum FilterType
+    uint8_t length; //!< Taps of the moving average and median, 1 to FILTER_MAX_LENGTH
+    uint8_t shift;  //!< IIR time constant, 2^shift windows
+    bool display;   //!< If true the screen shows the filtered current
+    bool stream;    //!< If true the serial output has the filtered current
+    bool log;       //!< If true the SD card log has the filtered current
 };
 
 /**
@@ -42,6 +88,11 @@ struct confParam {
     float dac[8];             //!< DAC configuration vector: vOutA:0, vOutB:1, ecc
     struct confACCURATE acc;  //!< ACCURATE configuration struct
     struct confSerial serial; //!< Serial configuration struct
+    struct confDisplay display; //!< Display configuration struct
+    struct confI2c i2c;       //!< I2C bus configuration struct
+    struct confAdc adc;       //!< LTC2471 configuration struct
+    struct confCalc calc;     //!< Current calculation configuration struct
+    struct confFilter filter; //!< Filter stage configuration struct
     uint32_t* UUID;           //!< Pointer to 128-bit UUID vector
 
 };
@@ -70,6 +121,18 @@ extern struct confParam conf;
 #define T_CHARGE 4
 #define T_INJECTION 4
 
+// Integration window period
+#define DEFAULT_WINDOW_PERIOD 100 // [ms]
+#define MIN_WINDOW_PERIOD 20      // [ms] A frame takes 17 ms to send at 19200 baud
+#define MAX_WINDOW_PERIOD 1000    // [ms] Longest period of the gateware, maxWindowPeriodMsC
+
+// Default display refresh rate
+#define DEFAULT_DISPLAY_RATE 4 // [Hz]
+#define MAX_DISPLAY_RATE 50    // [Hz]
+
+// Default I2C clock. The LTC2471 does not support Fast-mode Plus
+#define DEFAULT_I2C_CLOCK 400000 // [Hz]
+
 /**
  * @brief Default configuration values.
  */
@@ -85,11 +148,35 @@ constexpr struct confParam defaultConf = {
         T_CHARGE,    // tCharge (0 is corrected to 1)
         T_INJECTION, // tInjection (0 is corrected to 1)
         {0, 0, 0},   // disableCP
-        0            // singlyCPActivation
+        0,           // singlyCPActivation
+        DEFAULT_WINDOW_PERIOD // windowPeriod
     },
     { // Default confSerial values
         true,  // stream
         true,  // rawOutput
+        false, // log
+        false  // integral
+    },
+    { // Default confDisplay values
+        true,                 // enable
+        DEFAULT_DISPLAY_RATE, // maxRate
+        false                 // average
+    },
+    { // Default confI2c values
+        DEFAULT_I2C_CLOCK // clock
+    },
+    { // Default confAdc values
+        false // enable
+    },
+    { // Default confCalc values
+        false // interval
+    },
+    { // Default confFilter values
+        0,     // type, FILTER_NONE
+        4,     // length
+        3,     // shift
+        false, // display
+        false, // stream
         false  // log
     },
     nullptr // UUID pointer
@@ -134,7 +221,4 @@ const float VTH7_DEC = 2.5; // Vcharge+
 const uint32_t ADC_RESOLUTION_ACCURATE = 4096;
 const float REF_VOLTAGE = 3.0;
 
-// ADC Settings
-#define CURRENT_MEASUREMENT_DELAY 100 // Delay between current measurements [ms]
-
 #endif // CONFIG_H
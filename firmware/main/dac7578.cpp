@@ -5,6 +5,7 @@
  *  Author: vcruchet, hliverud
  */
 #include "dac7578.h"
+#include "i2cBus.h"
 #include <Arduino.h>
 #include <TimeLib.h>
 
@@ -12,11 +13,33 @@
  /* GLobal variables definition                                          */
 static DAC7578 ACCURATE_DAC;
 
+// One transaction per channel, so that updates of different channels can be queued together
+static struct I2cTransaction dacTransactions[DAC7578_NCH];
+
+// Bulk update: one write of all channels, then the readback of each one
+static struct I2cTransaction bulkTransaction;
+static uint8_t bulkBuffer[DAC7578_NCH * DAC_I2C_WR_PCKT_LEN];
+static struct I2cTransaction readTransactions[DAC7578_NCH];
+static uint8_t readBuffers[DAC7578_NCH][DAC_I2C_RD_PCKT_LEN];
+static uint16_t bulkValues[DAC7578_NCH]; // values written by the last bulk update
+
 /************************************************************************/
 
 /************************************************************************/
 /* Functions definition                                                 */
 
+// queue the write and update of one channel, ahead of the other bus users
+static void dac7578_i2c_send_ch(uint8_t ch_idx) {
+    struct I2cTransaction* t = &dacTransactions[ch_idx];
+
+    i2cbus_prepare(t, ACCURATE_DAC.address, I2C_PRIORITY_HIGH);
+    t->header[0] = (uint8_t)(DAC7578_WRU_CMD << 4 | ch_idx);
+    t->header[1] = (uint8_t)(ACCURATE_DAC.channel_val[ch_idx] >> 4); // data msb
+    t->header[2] = (uint8_t)(ACCURATE_DAC.channel_val[ch_idx] << 4); // data lsb
+    t->headerLen = DAC_I2C_WR_PCKT_LEN;
+    i2cbus_submit(t);
+}
+
 // Initializes ACCURATE_DAC fields with given address and default channel values
 void dac7578_init() {
     ACCURATE_DAC.address = DAC_ADDRESS;
@@ -34,11 +57,7 @@ void dac7578_init() {
 void dac7578_set_ch_val(uint8_t ch_idx, uint16_t ch_val, bool update) {
     ACCURATE_DAC.channel_val[ch_idx] = ch_val;
     if (update) { // directly update the modified channel
-        Wire.beginTransmission(ACCURATE_DAC.address);
-        Wire.write((DAC7578_WRU_CMD << 4) | ch_idx);
-        Wire.write(ch_val >> 4);
-        Wire.write(ch_val << 4);
-        Wire.endTransmission();
+        dac7578_i2c_send_ch(ch_idx);
     }
 }
 
@@ -64,15 +83,66 @@ uint16_t dac7578_get_ch_val(uint8_t ch_idx) {
 // send all channel parameters contained in the structure via i2c 
 void dac7578_i2c_send_all_param() {
     uint8_t i = 0;
-    uint8_t i2c_glob_wr_buffer[2];
 
+    // The DAC accepts consecutive command-data triplets in one transaction:
+    // write the input registers and update all the outputs with the last one
+    i2cbus_prepare(&bulkTransaction, ACCURATE_DAC.address, I2C_PRIORITY_HIGH);
+    for (i = 0; i <= DAC7578_NCH - 1; i++) {
+        uint8_t cmd = (i == DAC7578_NCH - 1) ? DAC7578_WRUA_CMD : DAC7578_WR_CMD;
+        bulkValues[i] = ACCURATE_DAC.channel_val[i];
+        bulkBuffer[i * DAC_I2C_WR_PCKT_LEN] = (uint8_t)(cmd << 4 | i);
+        bulkBuffer[i * DAC_I2C_WR_PCKT_LEN + 1] = (uint8_t)(bulkValues[i] >> 4); // data msb
+        bulkBuffer[i * DAC_I2C_WR_PCKT_LEN + 2] = (uint8_t)(bulkValues[i] << 4); // data lsb
+    }
+    bulkTransaction.txData = bulkBuffer;
+    bulkTransaction.txLen = sizeof(bulkBuffer);
+    i2cbus_submit(&bulkTransaction);
+
+    // Read back each DAC register, queued right behind the write
     for (i = 0; i <= DAC7578_NCH - 1; i++) {
-        Wire.beginTransmission(ACCURATE_DAC.address);
-        i2c_glob_wr_buffer[0] = (uint8_t)(DAC7578_WRU_CMD << 4 | i);
-        i2c_glob_wr_buffer[1] = (uint8_t)(ACCURATE_DAC.channel_val[i] >> 4); // data msb
-        i2c_glob_wr_buffer[2] = (uint8_t)(ACCURATE_DAC.channel_val[i] << 4); // data lsb
-        Wire.write(i2c_glob_wr_buffer, DAC_I2C_WR_PCKT_LEN);
-        delay(0.1);
-        Wire.endTransmission();
+        struct I2cTransaction* t = &readTransactions[i];
+        i2cbus_prepare(t, ACCURATE_DAC.address, I2C_PRIORITY_HIGH);
+        t->header[0] = (uint8_t)(DAC7578_RD_CMD << 4 | i);
+        t->headerLen = 1;
+        t->rxData = readBuffers[i];
+        t->rxLen = DAC_I2C_RD_PCKT_LEN;
+        i2cbus_submit(t);
+    }
+}
+
+DAC7578_Status dac7578_get_status() {
+    uint8_t i = 0;
+
+    if (bulkTransaction.status == I2C_IDLE) { // no bulk update yet
+        return DAC7578_OK;
+    }
+    if (bulkTransaction.status == I2C_PENDING) {
+        return DAC7578_PENDING;
+    }
+    for (i = 0; i <= DAC7578_NCH - 1; i++) {
+        if (readTransactions[i].status == I2C_PENDING) {
+            return DAC7578_PENDING;
+        }
+    }
+
+    if (bulkTransaction.status != I2C_OK) {
+        return DAC7578_ERR_I2C;
+    }
+    for (i = 0; i <= DAC7578_NCH - 1; i++) {
+        if (readTransactions[i].status != I2C_OK) {
+            return DAC7578_ERR_I2C;
+        }
+        uint16_t readback = ((readBuffers[i][0] << 8) | readBuffers[i][1]) >> 4;
+        if (readback != (bulkValues[i] & 0x0FFF)) {
+            return DAC7578_ERR_VERIFY;
+        }
+    }
+    return DAC7578_OK;
+}
+
+DAC7578_Status dac7578_wait() {
+    while (dac7578_get_status() == DAC7578_PENDING) {
+        i2cbus_task();
     }
+    return dac7578_get_status();
 }
@@ -26,13 +26,22 @@
 #define VTH3_CH			6
 #define VBIAS3_CH		7
 
-#define DAC7578_WRU_CMD	0x0
-#define DAC7578_RD_CMD	0x1
+#define DAC7578_WR_CMD	0x0 // write to input register n
+#define DAC7578_WRUA_CMD 0x2 // write to input register n, update all
+#define DAC7578_WRU_CMD	0x3 // write to input register n, update n
+#define DAC7578_RD_CMD	0x1 // read DAC register n
 #define DAC7578_RST_CMD 0b0111 // software reset
 
 #define DAC_I2C_WR_PCKT_LEN     3 // command, MSB, LSB
 #define DAC_I2C_RD_PCKT_LEN     2 // MSB, LSB
 
+typedef enum {
+    DAC7578_OK = 0,
+    DAC7578_PENDING = 1,        // bulk update or readback still on the bus
+    DAC7578_ERR_I2C = 2,        // a transaction failed
+    DAC7578_ERR_VERIFY = 3      // a channel read back differs from the value written
+} DAC7578_Status;
+
 class DAC7578 {
 public:
     uint8_t address;
@@ -55,7 +64,16 @@ uint16_t* dac7578_get_all_ch();
 // returns the channel value
 uint16_t dac7578_get_ch_val(uint8_t ch_idx);
 
-// send all channel parameters contained in the structure via i2c 
+// send all channel parameters contained in the structure via i2c
+// all input registers are written and updated together in one transaction,
+// then read back. The transfers are queued on the i2c engine, the function
+// does not wait for them: see dac7578_get_status()
 void dac7578_i2c_send_all_param();
 
+// status of the last bulk update and of its readback
+DAC7578_Status dac7578_get_status();
+
+// wait for the last bulk update and its readback
+DAC7578_Status dac7578_wait();
+
 #endif /* DAC7578_H_ */
@@ -0,0 +1,71 @@
+/**
+ * @file estimator.cpp
+ * @brief Source file for the current estimators.
+ */
+
+#include "estimator.h"
+#include "calibration.h"
+
+static_assert(ESTIMATOR_CLK_KHZ * 1000 == ACCURATE_CLK, "ESTIMATOR_CLK_KHZ does not match ACCURATE_CLK");
+
+
+bool estimator_interval_current(const struct rawDataFPGA& frame, int64_t* current) {
+    // Only CP1 between the two activations, else the other pumps' quanta are unknown
+    if (frame.cp1Count < 2 || frame.cp2Count != 0 || frame.cp3Count != 0) {
+        return false;
+    }
+
+    uint64_t windowCycles = (uint64_t)frame.periodMs * ESTIMATOR_CLK_KHZ;
+    if (windowCycles >= ((uint64_t)1 << ESTIMATOR_INTERVAL_BITS)) {
+        return false;
+    }
+
+    // Both intervals are counted minus one
+    uint64_t edges = (uint64_t)frame.cp1StartInterval + frame.cp1EndInterval + 2;
+    if (edges >= windowCycles) {
+        return false;
+    }
+    uint64_t cycles = windowCycles - edges;
+
+    // charge [zC] * clock [kHz] / cycles = current [aA]
+    uint64_t charge;
+    uint64_t scaled;
+    uint64_t quanta = calibration_pump_charge(0, (int64_t)(frame.cp1Count - 1) * conf.acc.chargeQuantaCP[0]);
+    if (__builtin_mul_overflow(quanta, (uint64_t)ESTIMATOR_LSB_ZC, &charge)
+        || __builtin_mul_overflow(charge, (uint64_t)ESTIMATOR_CLK_KHZ, &scaled)) {
+        return false;
+    }
+
+    *current = (int64_t)((scaled + cycles / 2) / cycles);
+    return true;
+}
+
+int64_t estimator_window_current(const struct rawDataFPGA& frame) {
+    // charge [LSB] * lsb [zC] / period [ms] = current [aA], split to stay in 64 bits
+    int64_t charge = calibration_charge(fpga_signed_charge(frame.charge), frame);
+    int64_t whole = charge / frame.periodMs;
+    int64_t rest = charge % frame.periodMs * ESTIMATOR_LSB_ZC;
+    // Rounded to nearest as the interval estimate, the rest having the sign of the charge
+    int64_t half = frame.periodMs / 2;
+    return whole * ESTIMATOR_LSB_ZC + (rest >= 0 ? rest + half : rest - half) / frame.periodMs;
+}
+
+int64_t estimator_current_aa(const struct rawDataFPGA& frame) {
+    int64_t current;
+    if (!conf.calc.interval || !estimator_interval_current(frame, &current)) {
+        current = estimator_window_current(frame);
+    }
+    return calibration_current(current, frame);
+}
+
+float estimator_current(const struct rawDataFPGA& frame) {
+    return estimator_current_aa(frame) / 1000.0f;
+}
+
+void estimator_set_interval(bool interval) {
+    conf.calc.interval = interval;
+}
+
+bool estimator_get_interval() {
+    return conf.calc.interval;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file estimator.h
+ * @brief Current estimators of a frame.
+ *
+ * The window estimator divides the charge of the frame by the window
+ * period. At low current only a few charge pump quanta fall in a window, so
+ * its result jumps by a whole quantum depending on where the activations
+ * fall relative to the window edges.
+ *
+ * The interval estimator divides the charge between the first and the last
+ * CP1 activation, (cp1Count - 1) quanta, by the exact time between them,
+ * taken from cp1StartInterval and cp1EndInterval. It is computed in integer
+ * arithmetic, in aA, and applies to the frames with at least two CP1
+ * activations and none of CP2 and CP3. The other frames, and all of them
+ * when the interval counters could wrap, fall back to the window estimator.
+ *
+ * Both are computed in integer arithmetic, in aA, the window one from the
+ * sign extended charge. The pump quanta are corrected by the calibration
+ * before the division, its range gain, offset and temperature correction are
+ * applied to the selected estimate.
+ */
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define ESTIMATOR_LSB_ZC 39339      // DEFAULT_LSB [zC]
+#define ESTIMATOR_CLK_KHZ 50000UL   // ACCURATE_CLK [kHz]
+#define ESTIMATOR_INTERVAL_BITS 24  // Width of the interval counters
+
+/**
+ * @brief Current of a frame with the interval estimator.
+ * @param current Set to the current [aA] if it applies.
+ * @return False if the frame does not allow it.
+ */
+bool estimator_interval_current(const struct rawDataFPGA& frame, int64_t* current);
+
+/**
+ * @brief Current of a frame with the window estimator [aA].
+ */
+int64_t estimator_window_current(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Calibrated current of a frame with the selected estimator [aA].
+ */
+int64_t estimator_current_aa(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Calibrated current of a frame with the selected estimator [fA].
+ */
+float estimator_current(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Select the interval estimator, or the window one.
+ */
+void estimator_set_interval(bool interval);
+
+bool estimator_get_interval();
+
+#endif // ESTIMATOR_H
@@ -0,0 +1,126 @@
+/**
+ * @file filter.cpp
+ * @brief Source file for the integer filter stage.
+ *
+ * The right shifts of negative values are arithmetic with GCC.
+ */
+
+#include "filter.h"
+#include <Arduino.h>
+#include "config.h"
+
+static int64_t iirState = 0; // Q.FILTER_FRAC_BITS [aA]
+static bool iirStarted = false;
+
+// Last currents, for the moving average and the median
+static int64_t taps[FILTER_MAX_LENGTH];
+static uint8_t tapNext = 0;
+static uint8_t tapCount = 0;
+static int64_t tapSum = 0;
+
+
+/**
+ * @brief Divide, rounding to nearest and the ties to even, so that the
+ * output has no bias for either sign.
+ * @param divisor Positive.
+ */
+static int64_t divRound(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    int64_t twice = 2 * (value % divisor); // Sign of value
+    if (twice > divisor || (twice == divisor && (quotient & 1))) {
+        quotient++;
+    } else if (twice < -divisor || (twice == -divisor && (quotient & 1))) {
+        quotient--;
+    }
+    return quotient;
+}
+
+/**
+ * @brief Divide by 2^shift, rounding as divRound().
+ *
+ * A plain right shift rounds toward minus infinity: the IIR state would stop
+ * up to 2^shift - 1 below a constant input reached from below, a bias of
+ * about -2^(shift - 1) of the Q.8 LSB on the output.
+ */
+static int64_t shiftRound(int64_t value, uint8_t shift) {
+    if (shift == 0) {
+        return value;
+    }
+    int64_t quotient = value >> shift;
+    int64_t rest = value - quotient * ((int64_t)1 << shift); // 0 to 2^shift - 1
+    int64_t half = (int64_t)1 << (shift - 1);
+    if (rest > half || (rest == half && (quotient & 1))) {
+        quotient++;
+    }
+    return quotient;
+}
+
+static int64_t pushIir(int64_t current) {
+    int64_t input = current * (1 << FILTER_FRAC_BITS);
+    if (!iirStarted) {
+        iirState = input;
+        iirStarted = true;
+    } else {
+        iirState += shiftRound(input - iirState, conf.filter.shift);
+    }
+    return shiftRound(iirState, FILTER_FRAC_BITS);
+}
+
+/**
+ * @brief Add a current to the last ones, up to the filter length.
+ */
+static void pushTap(int64_t current) {
+    uint8_t length = conf.filter.length;
+
+    if (tapCount == length) {
+        tapSum -= taps[tapNext];
+    } else {
+        tapCount++;
+    }
+    taps[tapNext] = current;
+    tapSum += current;
+    tapNext = (tapNext + 1) % length;
+}
+
+static int64_t median() {
+    int64_t sorted[FILTER_MAX_LENGTH];
+
+    // Insertion sort, at most FILTER_MAX_LENGTH values
+    for (uint8_t i = 0; i < tapCount; i++) {
+        int64_t value = taps[i];
+        int8_t j = i - 1;
+        while (j >= 0 && sorted[j] > value) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+
+    if (tapCount % 2) {
+        return sorted[tapCount / 2];
+    }
+    return divRound(sorted[tapCount / 2 - 1] + sorted[tapCount / 2], 2);
+}
+
+
+int64_t filter_push(int64_t current) {
+    switch (conf.filter.type) {
+    case FILTER_IIR:
+        return pushIir(current);
+    case FILTER_AVERAGE:
+        pushTap(current);
+        return divRound(tapSum, tapCount);
+    case FILTER_MEDIAN:
+        pushTap(current);
+        return median();
+    default:
+        return current;
+    }
+}
+
+void filter_reset() {
+    iirStarted = false;
+    tapNext = 0;
+    tapCount = 0;
+    tapSum = 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file filter.h
+ * @brief Integer filter stage on the current of the frames.
+ *
+ * The current of each frame, an integer in aA, goes through one of:
+ * - a first-order IIR, y += (x - y) / 2^k, the time constant being 2^k
+ *   windows. The state keeps FILTER_FRAC_BITS fractional bits (Q.8), so a
+ *   long time constant does not truncate the small steps. A shift, rounded
+ *   to nearest, replaces the division by the time constant.
+ * - the moving average of the last N currents, from a running sum.
+ * - the median of the last N currents, rejecting spikes shorter than N/2
+ *   frames. For an even N it is the mean of the two middle values.
+ * Until N currents are received, the average and the median take the ones
+ * received so far. No float is used.
+ *
+ * The filter runs once per frame, on reception, and its output is stored in
+ * the frame. The screen, serial stream and SD log each use it or the raw
+ * current, independently.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_MAX_LENGTH 16 // Taps of the moving average and median
+#define FILTER_MAX_SHIFT 10  // IIR time constant up to 2^10 windows
+#define FILTER_FRAC_BITS 8   // Fractional bits of the IIR state
+
+enum FilterType {
+    FILTER_NONE,
+    FILTER_IIR,
+    FILTER_AVERAGE,
+    FILTER_MEDIAN,
+    FILTER_TYPE_COUNT
+};
+
+/**
+ * @brief Filter a current.
+ * @param current The current of a frame [aA]
+ * @return The filtered current [aA]
+ */
+int64_t filter_push(int64_t current);
+
+/**
+ * @brief Forget the past currents, after a change of the filter.
+ */
+void filter_reset();
+
+#endif // FILTER_H
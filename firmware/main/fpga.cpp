@@ -6,53 +6,90 @@
  */
 
 #include "fpga.h"
+#include "timeSync.h"
+#include "perf.h"
+#include "trace.h"
+#include "estimator.h"
+#include "filter.h"
+
+SPSCfanout<struct rawDataFPGA, FPGA_FRAME_QUEUE_SIZE, FPGA_READER_COUNT> fpgaFrameQueue;
+
+// Frame parser state
+static uint8_t framePayload[FPGA_UART_FRAME_LENGTH];
+static bool frameStarted = false; // Start byte found
+static uint8_t frameReceived = 0; // Payload bytes received
+static uint64_t frameTimestamp = 0;
+static uint32_t frameLastByteMs = 0;
+
+/**
+ * @brief Read a little endian integer from the payload.
+ */
+static uint64_t payloadRead(const uint8_t* payload, uint8_t length) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        value |= ((uint64_t)payload[i] << (8 * i));
+    }
+    return value;
+}
 
-rawDataFPGA fpgaReadData() {
-    // FIXME: use of magic numbers, no bueno
-    char chargeRaw[6];
-    char cp1CountRaw[4];
-    char cp2CountRaw[4];
-    char cp3CountRaw[4];
-    char cp1StartIntervalRaw[4];
-    char cp1EndIntervalRaw[4];
-    char temperatureRaw[2];
-    char humidityRaw[2];
+static void fpgaDecodeFrame(const uint8_t* payload, struct rawDataFPGA* data) {
+    // Convert the payload to a 64-bit integer rapresentation. The charge is
+    // kept as its raw 48 bits, fpga_signed_charge() sign extends it
+    data->charge = payloadRead(payload, 6);
+    data->cp1Count = payloadRead(payload + 6, 4);
+    data->cp2Count = payloadRead(payload + 10, 4);
+    data->cp3Count = payloadRead(payload + 14, 4);
+    data->cp1StartInterval = payloadRead(payload + 18, 4);
+    data->cp1EndInterval = payloadRead(payload + 22, 4);
+    data->tempSht41 = payloadRead(payload + 26, 2);
+    data->humidSht41 = payloadRead(payload + 28, 2);
+    data->periodMs = payloadRead(payload + 30, 2);
+    // The current is divided by the period, assume the configured one
+    if (data->periodMs == 0) {
+        data->periodMs = conf.acc.windowPeriod;
+    }
+}
 
-    struct rawDataFPGA data;
-    data.valid = false;
+bool fpgaPollFrame() {
+    // A frame is sent in one go, a long gap means a lost byte
+    if (frameStarted && millis() - frameLastByteMs > FPGA_UART_FRAME_TIMEOUT_MS) {
+        frameStarted = false;
+    }
 
-    if (Serial1.find((char) FPGA_CURRENT_ADDRESS)) {
-        // Wait for the full payload to be available
-        // Read the payload
-        Serial1.readBytes(chargeRaw, 6);
-
-        // FIXME: THIS IS WRONG. rawCharge is of signed type inside the vhdl code!! What happens to leading '1's if it is negative?
-        // Convert the payload to a 64-bit integer rapresentation
-        data.charge = 0;
-        for (int i = 0; i < 6; i++) {
-            data.charge |= ((uint64_t)chargeRaw[i] << (8 * i));
+    while (Serial1.available()) {
+        uint8_t byte = Serial1.read();
+        frameLastByteMs = millis();
+
+        if (!frameStarted) {
+            if (byte == FPGA_CURRENT_ADDRESS) {
+                // Timestamp the frame as soon as its header is found
+                frameTimestamp = timesync_now_us();
+                frameStarted = true;
+                frameReceived = 0;
+            }
+            continue;
         }
 
-        Serial1.readBytes(cp1CountRaw, 4);
-        data.cp1Count = *(uint32_t*) cp1CountRaw;
-
-        Serial1.readBytes(cp2CountRaw, 4);
-        data.cp2Count = *(uint32_t*) cp2CountRaw;
-
-        Serial1.readBytes(cp3CountRaw, 4);
-        data.cp3Count = *(uint32_t*) cp3CountRaw;
-
-        Serial1.readBytes(cp1StartIntervalRaw, 4);
-        data.cp1StartInterval = *(uint32_t*) cp1StartIntervalRaw;
+        framePayload[frameReceived++] = byte;
+        if (frameReceived < FPGA_UART_FRAME_LENGTH) {
+            continue;
+        }
 
-        Serial1.readBytes(cp1EndIntervalRaw, 4);
-        data.cp1EndInterval = *(uint32_t*) cp1EndIntervalRaw;
+        struct rawDataFPGA data;
+        uint32_t decodeStart = perf_now();
+        fpgaDecodeFrame(framePayload, &data);
+        perf_record(PERF_DECODE, decodeStart);
+        data.timestamp = frameTimestamp;
+        data.valid = true;
+        frameStarted = false;
 
-        Serial1.readBytes(temperatureRaw, 2);
-        data.tempSht41 = *(uint16_t*) temperatureRaw;
+        // Filtered once, for all the consumers
+        uint32_t filterStart = perf_now();
+        data.filtered = filter_push(estimator_current_aa(data));
+        perf_record(PERF_FILTER, filterStart);
 
-        Serial1.readBytes(humidityRaw, 2);
-        data.humidSht41 = *(uint16_t*) humidityRaw;
+        // Captured raw, whether or not the frame queue has room
+        trace_capture(framePayload, frameTimestamp);
 
         // Clear the rest of the serial buffer, if not already empty.
         // This is necessary to avoid communication artifacts that
@@ -60,40 +97,22 @@ rawDataFPGA fpgaReadData() {
         while (Serial1.available()) {
             Serial1.read();
         }
-
-        data.valid = true;
+        return fpgaFrameQueue.push(data);
     }
 
-    return data;
+    return false;
 }
 
+void fpgaResetFrameParser() {
+    frameStarted = false;
+}
 
-struct IOstatus getPinStatus() {
-    struct IOstatus status;
-
-    // Read button states (HIGH means pressed if using pull-up resistors)
-    status.btn1 = digitalRead(PIN_BUTTON);
-    status.btn2 = digitalRead(PIN_BUTTON2);
-    status.btn3 = digitalRead(PIN_BUTTON3);
-
-    // Assuming HIGH means LED is ON.
-    status.led1 = digitalRead(PIN_LED);
-    status.led2 = digitalRead(PIN_LED2);
-    status.led3 = digitalRead(PIN_LED3);
-
-    // Encode the status as a string
-    status.status = "";
-    status.status += status.btn1 ? "0" : "1";
-    status.status += status.btn2 ? "0" : "1";
-    status.status += status.btn3 ? "0" : "1";
-    status.status += status.led1 ? "0" : "1";
-    status.status += status.led2 ? "0" : "1";
-    status.status += status.led3 ? "0" : "1";
 
-    return status;
+int64_t fpga_signed_charge(uint64_t charge) {
+    const uint64_t signBit = (uint64_t)1 << (FPGA_CHARGE_BITS - 1);
+    return (int64_t)((charge ^ signBit) - signBit);
 }
 
-
 uint32_t fpga_convert_volt_to_DAC(float voltage) {
     return static_cast<uint32_t>(round((voltage * ADC_RESOLUTION_ACCURATE) / REF_VOLTAGE));
 }
@@ -155,6 +174,8 @@ void sendToFPGA(uint8_t address, uint32_t value) {
 void fpgaUpdateAllParam() {
     // Disable streaming of data from FPGA, enable (n)ack to rx requests
     sendToFPGA(FPGA_UART_MANAGEMENT_ADDR, 0);
+    // A partial frame is lost with the responses
+    fpgaResetFrameParser();
 
     // Send DAC values
     sendToFPGA(FPGA_DAC_VOUTA_ADDR, fpga_convert_volt_to_DAC(conf.dac[0]));
@@ -183,18 +204,26 @@ void fpgaUpdateAllParam() {
     sendToFPGA(FPGA_ACC_DISABLE_CP2_ADDR, conf.acc.disableCP[1]);
     sendToFPGA(FPGA_ACC_DISABLE_CP3_ADDR, conf.acc.disableCP[2]);
     sendToFPGA(FPGA_ACC_SINGLY_CP_ACTIVATION_ADDR, conf.acc.singlyCPActivation);
+    sendToFPGA(FPGA_WINDOW_PERIOD_ADDR, conf.acc.windowPeriod);
 
     // Enable back streaming of data from FPGA, disable (n)ack to rx requests
     sendToFPGA(FPGA_UART_MANAGEMENT_ADDR, 1);
 }
 
+void fpgaWriteParam(uint8_t address, uint32_t value) {
+    const uint8_t message[] = {
+        0xDD, address,
+        (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value
+    };
+    Serial1.write(message, sizeof(message));
+}
+
 bool fpgaCheckResponse() {
-    // FIXME: use of magic numbers
-    char response[30] = {0};
+    char response[FPGA_UART_FRAME_LENGTH] = {0};
 
     // Read the payload
     if (Serial1.find((char) FPGA_CURRENT_ADDRESS)) {
-        Serial1.readBytes(response, 30);
+        Serial1.readBytes(response, FPGA_UART_FRAME_LENGTH);
     }
 
     // Clear the rest of the serial buffer, if not already empty.
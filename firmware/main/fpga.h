@@ -9,6 +9,7 @@
 #include <Arduino.h>
 #include <cmath>
 #include "config.h"
+#include "SPSCbuf.h"
 
 /** 
  * @defgroup fpga_addresses FPGA configuration register addresses
@@ -44,6 +45,9 @@
 
 // UART management
 #define FPGA_UART_MANAGEMENT_ADDR 0x18 /** UART management address, not to be confused with conf.serial.stream */
+
+// Window generator
+#define FPGA_WINDOW_PERIOD_ADDR 0x19 /** Integration window period address */
 /** @} */
 
 /**
@@ -52,6 +56,8 @@
  */
 #define FPGA_UART_PAYLOAD_LENGTH 6 /** Length of the payload in bytes */
 #define FPGA_UART_START_BYTE_TX 0xDD /** Start byte for the UART communication when tx*/
+#define FPGA_UART_FRAME_LENGTH 32 /** Length of a data frame after the start byte */
+#define FPGA_UART_FRAME_TIMEOUT_MS 20 /** Max gap between two bytes of a frame, it takes 17 ms at 19200 baud */
 /** @} */
 
 const uint8_t FPGA_CURRENT_ADDRESS = 0xDD; // BAD NAMING It's the start byte for the UART communication
@@ -71,22 +77,12 @@ struct rawDataFPGA {
                              // enf of sampling
     uint16_t tempSht41; // Temperature data from SHT41
     uint16_t humidSht41; // Humidity data from SHT41
+    uint16_t periodMs; // Integration window period of this frame [ms]
+    uint64_t timestamp; // Host-synchronised reception time [us]
+    int64_t filtered; // Current through the filter stage [aA]
     bool valid; // Flag to indicate if the data is valid
 };
 
-/**
- * @brief Structure to hold the current status of buttons and LEDs.
- */
-struct IOstatus {
-    bool btn1; // Button 1
-    bool btn2; // Button 2
-    bool btn3; // Button 3
-    bool led1; // LED 1
-    bool led2; // LED 2
-    bool led3; // LED 3
-    String status; // Status string
-};
-
 
 
 const float CLOCK_PERIOD = 1E8; // ^-1
@@ -94,27 +90,54 @@ const float CLOCK_PERIOD = 1E8; // ^-1
 const float TW = 0.1;
 
 const float DEFAULT_LSB = 39.339; // aC
-const int DEFAULT_PERIOD = 100; // ms
 
 
 /**
- * @brief Reads data from the FPGA and returns it in a struct.
- * @return rawDataFPGA struct containing the raw data.
+ * @brief Consumers of the decoded frames, each with its own read cursor.
  */
-struct rawDataFPGA fpgaReadData();
+enum FpgaFrameReader {
+    FPGA_READER_STREAM,  //!< Serial output
+    FPGA_READER_LOG,     //!< SD card log
+    FPGA_READER_DISPLAY, //!< Screen
+    FPGA_READER_TRIGGER, //!< Trigger engine
+    FPGA_READER_STATS,   //!< Running statistics
+    FPGA_READER_HISTORY, //!< Pyramid of aggregates
+    FPGA_READER_INTEGRATOR, //!< Charge integrator
+    FPGA_READER_SWEEP,   //!< DAC threshold sweep
+    FPGA_READER_QUANTA,  //!< Charge quanta measurement
+    FPGA_READER_COUNT
+};
+
+#define FPGA_FRAME_QUEUE_SIZE 16 // Frames buffered for the slowest reader, power of two
 
 /**
- * @brief Get the current status of the buttons and LEDs
- * @return PinStatus The status of the buttons and LEDs + string encoding
+ * @brief Decoded frames, pushed by fpgaPollFrame(), read by each consumer.
+ */
+extern SPSCfanout<struct rawDataFPGA, FPGA_FRAME_QUEUE_SIZE, FPGA_READER_COUNT> fpgaFrameQueue;
+
+/**
+ * @brief Parse the bytes received from the FPGA, without blocking.
+ * @return True if a complete frame has been decoded and queued.
  *
- * The status is encoded as follows:
- * - The first three characters represent the status of the buttons.
- *   Order is BUTTON1, BUTTON2, BUTTON3. 1 means pressed, 0 means not pressed.
- * - The last three characters represent the status of the LEDs.
- *   Order is LED1, LED2, LED3. 1 means ON, 0 means OFF.
+ * The frame is assembled across calls from whatever bytes are available, so
+ * this can be polled as often as needed. Complete frames are pushed to
+ * fpgaFrameQueue, or dropped if a reader is full.
+ */
+bool fpgaPollFrame();
+
+/**
+ * @brief Drop the partially received frame, if any.
  */
-struct IOstatus getPinStatus();
+void fpgaResetFrameParser();
+
 
+#define FPGA_CHARGE_BITS 48 // The charge is a signed 48-bit integer
+
+/**
+ * @brief Sign extend the charge of a frame.
+ * @param charge The charge as decoded, FPGA_CHARGE_BITS wide.
+ */
+int64_t fpga_signed_charge(uint64_t charge);
 
 // Calculates the current based on FPGA data readings, charge injection.
 float fpga_calc_current(uint64_t data, float lsb, int period);
@@ -143,6 +166,20 @@ void sendToFPGA(uint8_t address, uint32_t value);
  */
 void fpgaUpdateAllParam();
 
+/**
+ * @brief Write a single FPGA parameter, the others being unchanged, without
+ * stopping the streaming.
+ * @param address The address of the parameter (8-bit).
+ * @param value The value to be set (32-bit).
+ *
+ * The FPGA takes the register writes while streaming, it only does not
+ * acknowledge them, so the write is not checked. It does not wait for an
+ * acknowledge nor drop the frame being received: it takes the time to queue
+ * 6 bytes on Serial1, unlike sendToFPGA() which can wait for the timeout of
+ * Serial1, 500 ms.
+ */
+void fpgaWriteParam(uint8_t address, uint32_t value);
+
 /**
  * @brief Checks the FPGA response after a write operation.
  * 
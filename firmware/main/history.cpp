@@ -0,0 +1,134 @@
+/**
+ * @file history.cpp
+ * @brief Source file for the pyramid of aggregates.
+ */
+
+#include "history.h"
+#include "estimator.h"
+
+/**
+ * @brief Shape of a level.
+ */
+struct HistoryLevel {
+    uint16_t factor;  // Points of the level below in a point, 0 for the frames
+    uint16_t seconds; // Duration of a point
+};
+
+static constexpr struct HistoryLevel levels[HISTORY_LEVEL_COUNT] = {
+    {0, 1},
+    {10, 10},
+    {6, 60},
+    {10, 600}
+};
+
+static_assert(HISTORY_LEVEL_COUNT * HISTORY_POINTS * sizeof(struct HistoryPoint) <= HISTORY_MAX_BYTES,
+              "History rings exceed their RAM budget");
+
+static struct HistoryPoint points[HISTORY_LEVEL_COUNT][HISTORY_POINTS];
+static uint32_t pointCount[HISTORY_LEVEL_COUNT] = {0};
+static uint64_t lastTimestamp[HISTORY_LEVEL_COUNT] = {0};
+
+// Point being aggregated in each level
+static struct HistoryPoint pending[HISTORY_LEVEL_COUNT];
+static float pendingSum[HISTORY_LEVEL_COUNT] = {0};
+static uint16_t pendingCount[HISTORY_LEVEL_COUNT] = {0};
+static uint32_t pendingMs = 0; // Duration of the level 0 point [ms]
+
+static void pushLevel(uint8_t level, const struct HistoryPoint& point, uint64_t timestamp);
+
+
+/**
+ * @brief Store a complete point of a level and add it to the level above.
+ */
+static void storePoint(uint8_t level, const struct HistoryPoint& point, uint64_t timestamp) {
+    points[level][pointCount[level] % HISTORY_POINTS] = point;
+    pointCount[level]++;
+    lastTimestamp[level] = timestamp;
+
+    if (level + 1 < HISTORY_LEVEL_COUNT) {
+        pushLevel(level + 1, point, timestamp);
+    }
+}
+
+/**
+ * @brief Add a point to the point being aggregated in a level above 0.
+ */
+static void pushLevel(uint8_t level, const struct HistoryPoint& point, uint64_t timestamp) {
+    struct HistoryPoint* current = &pending[level];
+
+    if (pendingCount[level] == 0) {
+        *current = point;
+        pendingSum[level] = 0;
+    } else {
+        if (point.min < current->min) {
+            current->min = point.min;
+        }
+        if (point.max > current->max) {
+            current->max = point.max;
+        }
+    }
+    pendingSum[level] += point.mean;
+    pendingCount[level]++;
+
+    if (pendingCount[level] < levels[level].factor) {
+        return;
+    }
+
+    // The lower points all span the same time
+    current->mean = pendingSum[level] / levels[level].factor;
+    pendingCount[level] = 0;
+
+    storePoint(level, *current, timestamp);
+}
+
+
+void history_push(const struct rawDataFPGA& frame) {
+    if (!frame.valid) {
+        return;
+    }
+
+    float current = estimator_current(frame);
+    struct HistoryPoint* point = &pending[0];
+
+    if (pendingMs == 0) {
+        point->min = current;
+        point->max = current;
+        pendingSum[0] = 0;
+    } else {
+        if (current < point->min) {
+            point->min = current;
+        }
+        if (current > point->max) {
+            point->max = current;
+        }
+    }
+    // Sum of the charges, in fA ms
+    pendingSum[0] += current * frame.periodMs;
+    pendingMs += frame.periodMs;
+
+    if (pendingMs < levels[0].seconds * 1000UL) {
+        return;
+    }
+
+    point->mean = pendingSum[0] / pendingMs;
+    pendingMs = 0;
+
+    storePoint(0, *point, frame.timestamp);
+}
+
+uint16_t history_period(uint8_t level) {
+    return levels[level].seconds;
+}
+
+uint16_t history_size(uint8_t level) {
+    return pointCount[level] < HISTORY_POINTS ? pointCount[level] : HISTORY_POINTS;
+}
+
+uint64_t history_last_timestamp(uint8_t level) {
+    return lastTimestamp[level];
+}
+
+struct HistoryPoint history_get(uint8_t level, uint16_t index) {
+    uint32_t oldest = pointCount[level] - history_size(level);
+    return points[level][(oldest + index) % HISTORY_POINTS];
+}
@@ -0,0 +1,61 @@
+/**
+ * @file history.h
+ * @brief Pyramid of min/mean/max aggregates of the current.
+ *
+ * The current is aggregated at several resolutions: 1 s from the frames,
+ * then 10 s, 1 min and 10 min, each made from a fixed number of points of
+ * the level below. Each level keeps its last HISTORY_POINTS points in a
+ * ring, so a host connecting mid-run gets from 2 minutes at 1 s to 20 hours
+ * at 10 min of history in one transfer.
+ *
+ * The frames are aggregated by time, whatever the integration window
+ * period: a 1 s point closes with the first frame that brings it to 1 s or
+ * more, and its mean is weighted by the period of each frame.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include "fpga.h"
+
+#define HISTORY_LEVEL_COUNT 4
+#define HISTORY_POINTS 120       // Points kept per level
+#define HISTORY_MAX_BYTES 6144   // RAM budget of the rings
+
+/**
+ * @brief An aggregate, all in fA.
+ */
+struct HistoryPoint {
+    float min;
+    float mean;
+    float max;
+};
+
+/**
+ * @brief Add the current of a decoded frame.
+ */
+void history_push(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Duration of a point of a level [s].
+ */
+uint16_t history_period(uint8_t level);
+
+/**
+ * @brief Points available in a level, up to HISTORY_POINTS.
+ */
+uint16_t history_size(uint8_t level);
+
+/**
+ * @brief Timestamp of the last frame of the newest point of a level [us].
+ */
+uint64_t history_last_timestamp(uint8_t level);
+
+/**
+ * @brief Get a point of a level.
+ * @param index 0 for the oldest point, up to history_size() - 1.
+ */
+struct HistoryPoint history_get(uint8_t level, uint16_t index);
+
+#endif // HISTORY_H
@@ -0,0 +1,413 @@
+/**
+ * @file i2cBus.cpp
+ * @brief Source file for the asynchronous I2C transaction engine.
+ *
+ * Each transaction is at most two DMA transfers: the write, header and data
+ * chained in two descriptors, and the read. The SERCOM automatic length mode
+ * (ADDR.LENEN) handles the ACK/NACK of the bytes, so the DMA only has to feed
+ * or empty the DATA register. The DMAC interrupt moves the state machine to
+ * the next phase, i2cbus_task() catches the errors and the timeouts, which do
+ * not produce a DMA interrupt.
+ *
+ * The SERCOM interrupt can not be used, its handler belongs to Wire.
+ */
+
+#include "i2cBus.h"
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_SERCOM SERCOM3 // Wire SERCOM on this board
+#define I2C_DMAC_ID_TX SERCOM3_DMAC_ID_TX
+#define I2C_DMAC_ID_RX SERCOM3_DMAC_ID_RX
+
+#define BUSSTATE_IDLE 1
+#define BUSSTATE_OWNER 2
+
+#define I2C_LAST_BYTE_US 200 // Max wait in the interrupt for the last byte to be sent
+
+enum busPhase {
+    PHASE_IDLE,
+    PHASE_WRITE,
+    PHASE_READ
+};
+
+// DMA descriptors: the first one of each channel, the data one chained after
+// the header, and the write-back area. The firmware is the only DMAC user.
+static DmacDescriptor dmaDescriptors[I2C_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static DmacDescriptor dmaWriteback[I2C_DMA_CHANNEL + 1] __attribute__((aligned(16)));
+static DmacDescriptor dmaDataDescriptor __attribute__((aligned(16)));
+
+// One FIFO per priority, plus the completed transactions waiting for their callback
+static struct I2cTransaction* queueHead[I2C_PRIORITY_COUNT];
+static struct I2cTransaction* queueTail[I2C_PRIORITY_COUNT];
+static struct I2cTransaction* doneHead = nullptr;
+static struct I2cTransaction* doneTail = nullptr;
+
+static struct I2cTransaction* volatile current = nullptr;
+static volatile enum busPhase phase = PHASE_IDLE;
+static volatile bool dmaDone = false;
+
+static struct I2cDeviceStats stats[I2C_MAX_DEVICES];
+static uint8_t statsCount = 0;
+
+static void startNext();
+
+
+static void push(struct I2cTransaction** head, struct I2cTransaction** tail, struct I2cTransaction* t) {
+    t->next = nullptr;
+    if (*head == nullptr) {
+        *head = t;
+    } else {
+        (*tail)->next = t;
+    }
+    *tail = t;
+}
+
+static struct I2cTransaction* pop(struct I2cTransaction** head) {
+    struct I2cTransaction* t = *head;
+    if (t != nullptr) {
+        *head = t->next;
+    }
+    return t;
+}
+
+static void syncSysop() {
+    while (I2C_SERCOM->I2CM.SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+}
+
+static bool busOwned() {
+    return (I2C_SERCOM->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(BUSSTATE_OWNER);
+}
+
+static void dmaEnable(uint8_t trigger) {
+    DMAC->CHID.reg = DMAC_CHID_ID(I2C_DMA_CHANNEL);
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigger) | DMAC_CHCTRLB_TRIGACT_BEAT;
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+    dmaDone = false;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+}
+
+static void dmaDisable() {
+    DMAC->CHID.reg = DMAC_CHID_ID(I2C_DMA_CHANNEL);
+    DMAC->CHCTRLA.reg = 0;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+}
+
+/**
+ * @brief Fill a descriptor moving bytes from memory to the SERCOM.
+ *
+ * With the address increment enabled, the DMAC wants the address just past
+ * the end of the block.
+ */
+static void setTxDescriptor(DmacDescriptor* desc, const uint8_t* data, uint16_t len) {
+    desc->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_NOACT;
+    desc->BTCNT.reg = len;
+    desc->SRCADDR.reg = (uint32_t)(data + len);
+    desc->DSTADDR.reg = (uint32_t)&I2C_SERCOM->I2CM.DATA.reg;
+    desc->DESCADDR.reg = 0;
+}
+
+static void startWrite(struct I2cTransaction* t) {
+    DmacDescriptor* desc = &dmaDescriptors[I2C_DMA_CHANNEL];
+
+    if (t->headerLen > 0) {
+        setTxDescriptor(desc, t->header, t->headerLen);
+        if (t->txLen > 0) {
+            setTxDescriptor(&dmaDataDescriptor, t->txData, t->txLen);
+            desc->DESCADDR.reg = (uint32_t)&dmaDataDescriptor;
+        }
+    } else {
+        setTxDescriptor(desc, t->txData, t->txLen);
+    }
+    dmaEnable(I2C_DMAC_ID_TX);
+
+    phase = PHASE_WRITE;
+    I2C_SERCOM->I2CM.CTRLB.reg = 0;
+    I2C_SERCOM->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR(t->address << 1) | SERCOM_I2CM_ADDR_LENEN
+        | SERCOM_I2CM_ADDR_LEN(t->headerLen + t->txLen);
+    syncSysop();
+}
+
+static void startRead(struct I2cTransaction* t) {
+    DmacDescriptor* desc = &dmaDescriptors[I2C_DMA_CHANNEL];
+    desc->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_NOACT;
+    desc->BTCNT.reg = t->rxLen;
+    desc->SRCADDR.reg = (uint32_t)&I2C_SERCOM->I2CM.DATA.reg;
+    desc->DSTADDR.reg = (uint32_t)(t->rxData + t->rxLen);
+    desc->DESCADDR.reg = 0;
+    dmaEnable(I2C_DMAC_ID_RX);
+
+    // Smart mode: reading DATA acknowledges the byte, the last one is NACKed by the length counter
+    phase = PHASE_READ;
+    I2C_SERCOM->I2CM.CTRLB.reg = SERCOM_I2CM_CTRLB_SMEN;
+    I2C_SERCOM->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR((t->address << 1) | 1) | SERCOM_I2CM_ADDR_LENEN
+        | SERCOM_I2CM_ADDR_LEN(t->rxLen);
+    syncSysop();
+}
+
+/**
+ * @brief Release the bus and leave the SERCOM as Wire expects it.
+ */
+static void releaseBus() {
+    if (busOwned()) {
+        I2C_SERCOM->I2CM.CTRLB.reg = SERCOM_I2CM_CTRLB_ACKACT | SERCOM_I2CM_CTRLB_CMD(3);
+        syncSysop();
+    } else if ((I2C_SERCOM->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) != SERCOM_I2CM_STATUS_BUSSTATE(BUSSTATE_IDLE)) {
+        // Lost track of the bus after an error, force it idle
+        I2C_SERCOM->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(BUSSTATE_IDLE);
+        syncSysop();
+    }
+    I2C_SERCOM->I2CM.CTRLB.reg = 0;
+    I2C_SERCOM->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST | SERCOM_I2CM_STATUS_LENERR;
+    I2C_SERCOM->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+    syncSysop();
+}
+
+static struct I2cDeviceStats* getDeviceStats(uint8_t address) {
+    for (uint8_t i = 0; i < statsCount; i++) {
+        if (stats[i].address == address) {
+            return &stats[i];
+        }
+    }
+    if (statsCount == I2C_MAX_DEVICES) {
+        return nullptr;
+    }
+    struct I2cDeviceStats* device = &stats[statsCount++];
+    memset(device, 0, sizeof(*device));
+    device->address = address;
+    return device;
+}
+
+/**
+ * @brief End the current transaction and start the next one.
+ *
+ * Called with the interrupts disabled.
+ */
+static void finish(enum I2cStatus result) {
+    struct I2cTransaction* t = current;
+
+    dmaDisable();
+    releaseBus();
+    phase = PHASE_IDLE;
+    current = nullptr;
+
+    t->endUs = micros();
+    uint32_t elapsed = t->endUs - t->startUs;
+    struct I2cDeviceStats* device = getDeviceStats(t->address);
+    if (device != nullptr) {
+        device->transactions++;
+        device->bytes += t->headerLen + t->txLen + t->rxLen;
+        device->busyUs += elapsed;
+        if (elapsed > device->maxUs) device->maxUs = elapsed;
+        if (result != I2C_OK) device->errors++;
+    }
+
+    t->result = result;
+    push(&doneHead, &doneTail, t);
+
+    startNext();
+}
+
+static void startNext() {
+    for (uint8_t priority = 0; priority < I2C_PRIORITY_COUNT; priority++) {
+        struct I2cTransaction* t = pop(&queueHead[priority]);
+        if (t != nullptr) {
+            current = t;
+            t->startUs = micros();
+            if (t->headerLen + t->txLen > 0) {
+                startWrite(t);
+            } else {
+                startRead(t);
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Move the current transaction forward if possible.
+ *
+ * Called with the interrupts disabled.
+ */
+static void advance() {
+    if (current == nullptr) return;
+
+    uint16_t status = I2C_SERCOM->I2CM.STATUS.reg;
+    uint8_t flags = I2C_SERCOM->I2CM.INTFLAG.reg;
+
+    if (status & (SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST)) {
+        finish(I2C_ERR_BUS);
+        return;
+    }
+    // NACK before the length is reached. A NACK of the last written byte is legal.
+    if ((status & SERCOM_I2CM_STATUS_LENERR)
+        || ((flags & SERCOM_I2CM_INTFLAG_MB) && (status & SERCOM_I2CM_STATUS_RXNACK) && !(phase == PHASE_WRITE && dmaDone))) {
+        finish(I2C_ERR_NACK);
+        return;
+    }
+
+    if (dmaDone == false) return;
+
+    if (phase == PHASE_WRITE) {
+        // The DMA is done when the last byte is loaded in DATA, not when it is sent
+        if (!(flags & SERCOM_I2CM_INTFLAG_MB)) return;
+
+        if (current->rxLen > 0) {
+            startRead(current);
+        } else {
+            finish(I2C_OK);
+        }
+    } else {
+        finish(I2C_OK);
+    }
+}
+
+void DMAC_Handler() {
+    DMAC->CHID.reg = DMAC_CHID_ID(I2C_DMA_CHANNEL);
+    uint8_t flags = DMAC->CHINTFLAG.reg;
+    DMAC->CHINTFLAG.reg = flags;
+
+    if (current == nullptr) return;
+
+    if (flags & DMAC_CHINTFLAG_TERR) {
+        finish(I2C_ERR_BUS);
+        return;
+    }
+    if (!(flags & DMAC_CHINTFLAG_TCMPL)) return;
+    dmaDone = true;
+
+    // One byte time at most, otherwise i2cbus_task() will complete it
+    if (phase == PHASE_WRITE) {
+        uint32_t start = micros();
+        while (!(I2C_SERCOM->I2CM.INTFLAG.reg & (SERCOM_I2CM_INTFLAG_MB | SERCOM_I2CM_INTFLAG_ERROR))
+            && micros() - start < I2C_LAST_BYTE_US);
+    }
+    advance();
+}
+
+
+void i2cbus_init(uint32_t clock) {
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+    DMAC->CTRL.reg = 0;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+    DMAC->BASEADDR.reg = (uint32_t)dmaDescriptors;
+    DMAC->WRBADDR.reg = (uint32_t)dmaWriteback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+
+    NVIC_EnableIRQ(DMAC_IRQn);
+
+    i2cbus_set_clock(clock);
+}
+
+void i2cbus_set_clock(uint32_t clock) {
+    i2cbus_wait_idle();
+
+    // Wire computes the baud rate but only knows Standard and Fast mode
+    Wire.setClock(clock);
+
+    I2C_SERCOM->I2CM.CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+    while (I2C_SERCOM->I2CM.SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_ENABLE);
+    uint32_t ctrla = I2C_SERCOM->I2CM.CTRLA.reg & ~SERCOM_I2CM_CTRLA_SPEED_Msk;
+    if (clock > I2C_CLOCK_FM) {
+        ctrla |= SERCOM_I2CM_CTRLA_SPEED(1); // Fast-mode Plus
+    }
+    I2C_SERCOM->I2CM.CTRLA.reg = ctrla;
+    I2C_SERCOM->I2CM.CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
+    while (I2C_SERCOM->I2CM.SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_ENABLE);
+
+    I2C_SERCOM->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(BUSSTATE_IDLE);
+    syncSysop();
+}
+
+void i2cbus_prepare(struct I2cTransaction* transaction, uint8_t address, enum I2cPriority priority) {
+    i2cbus_wait(transaction);
+
+    transaction->address = address;
+    transaction->priority = priority;
+    transaction->headerLen = 0;
+    transaction->txData = nullptr;
+    transaction->txLen = 0;
+    transaction->rxData = nullptr;
+    transaction->rxLen = 0;
+    transaction->callback = nullptr;
+    transaction->context = nullptr;
+}
+
+bool i2cbus_submit(struct I2cTransaction* transaction) {
+    uint16_t txTotal = transaction->headerLen + transaction->txLen;
+
+    if (transaction->status == I2C_PENDING
+        || transaction->headerLen > I2C_HEADER_LEN
+        || txTotal > I2C_MAX_LEN
+        || transaction->rxLen > I2C_MAX_LEN
+        || (txTotal == 0 && transaction->rxLen == 0)
+        || transaction->priority >= I2C_PRIORITY_COUNT) {
+        return false;
+    }
+
+    transaction->status = I2C_PENDING;
+
+    noInterrupts();
+    push(&queueHead[transaction->priority], &queueTail[transaction->priority], transaction);
+    if (current == nullptr) {
+        startNext();
+    }
+    interrupts();
+
+    return true;
+}
+
+void i2cbus_task() {
+    noInterrupts();
+    if (current != nullptr && micros() - current->startUs > I2C_TIMEOUT_US) {
+        finish(I2C_ERR_TIMEOUT);
+    } else {
+        advance();
+    }
+    interrupts();
+
+    // Callbacks, outside of the critical section
+    for (;;) {
+        noInterrupts();
+        struct I2cTransaction* t = pop(&doneHead);
+        interrupts();
+        if (t == nullptr) break;
+
+        t->status = t->result;
+        if (t->callback != nullptr) {
+            t->callback(t);
+        }
+    }
+}
+
+enum I2cStatus i2cbus_wait(struct I2cTransaction* transaction) {
+    while (transaction->status == I2C_PENDING) {
+        i2cbus_task();
+    }
+    return transaction->status;
+}
+
+bool i2cbus_busy() {
+    noInterrupts();
+    bool busy = current != nullptr || doneHead != nullptr;
+    for (uint8_t priority = 0; priority < I2C_PRIORITY_COUNT; priority++) {
+        busy = busy || queueHead[priority] != nullptr;
+    }
+    interrupts();
+    return busy;
+}
+
+void i2cbus_wait_idle() {
+    while (i2cbus_busy()) {
+        i2cbus_task();
+    }
+}
+
+const struct I2cDeviceStats* i2cbus_get_stats(uint8_t* count) {
+    *count = statsCount;
+    return stats;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file i2cBus.h
+ * @brief Asynchronous transaction engine for the shared I2C bus.
+ *
+ * The OLED display, the DAC7578, the SHT41, the LTC2471 and the PCF8523 all
+ * share the Wire bus (SERCOM3). Instead of blocking in Wire, the drivers
+ * submit transactions to this engine, which moves the bytes with the DMA
+ * controller and the SERCOM automatic length mode. Only the beginning and the
+ * end of each transaction need the CPU, in the DMAC interrupt.
+ *
+ * Pending transactions are queued by priority: a higher priority transaction
+ * is started as soon as the current one ends, so a DAC update does not wait
+ * for a whole screen refresh. Transactions are never preempted.
+ *
+ * Completion callbacks run in loop context, from i2cbus_task().
+ *
+ * The transaction structs are owned by the caller and must stay untouched
+ * while their status is I2C_PENDING.
+ *
+ * Code still using Wire directly must call i2cbus_wait_idle() before, the
+ * engine and Wire share the same SERCOM.
+ */
+
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define I2C_HEADER_LEN 8        // Max bytes sent before the data buffer
+#define I2C_MAX_LEN 255         // Max bytes per direction, limited by ADDR.LEN
+#define I2C_MAX_DEVICES 8       // Devices tracked in the statistics
+#define I2C_TIMEOUT_US 50000    // Longest transaction before it is aborted
+#define I2C_DMA_CHANNEL 0
+
+#define I2C_CLOCK_SM 100000     // Standard mode
+#define I2C_CLOCK_FM 400000     // Fast mode
+#define I2C_CLOCK_FMPLUS 1000000 // Fast mode plus
+
+/**
+ * @brief Priority of a transaction, lower value first.
+ */
+enum I2cPriority {
+    I2C_PRIORITY_HIGH,   //!< Analog settings (DAC)
+    I2C_PRIORITY_NORMAL, //!< Sensors
+    I2C_PRIORITY_LOW,    //!< Display
+    I2C_PRIORITY_COUNT
+};
+
+/**
+ * @brief Status of a transaction.
+ */
+enum I2cStatus {
+    I2C_IDLE,        //!< Never submitted
+    I2C_PENDING,     //!< Queued or on the bus, owned by the engine
+    I2C_OK,          //!< Completed
+    I2C_ERR_NACK,    //!< Address or data not acknowledged
+    I2C_ERR_BUS,     //!< Bus error or arbitration lost
+    I2C_ERR_TIMEOUT  //!< Aborted after I2C_TIMEOUT_US
+};
+
+struct I2cTransaction;
+typedef void (*I2cCallback)(struct I2cTransaction* transaction);
+
+/**
+ * @brief One I2C transaction: a write, a read, or a write followed by a read
+ * with a repeated start.
+ *
+ * The bytes written are the header followed by the data buffer, so that a
+ * command can be prepended to a buffer owned by someone else (e.g. the
+ * display framebuffer) without copying it.
+ */
+struct I2cTransaction {
+    uint8_t address;                 //!< 7-bit address
+    enum I2cPriority priority;
+    uint8_t header[I2C_HEADER_LEN];  //!< First bytes to write
+    uint8_t headerLen;
+    const uint8_t* txData;           //!< Bytes to write after the header, may be nullptr
+    uint16_t txLen;                  //!< headerLen + txLen must not exceed I2C_MAX_LEN
+    uint8_t* rxData;                 //!< Buffer for the bytes read, may be nullptr
+    uint16_t rxLen;                  //!< Bytes to read, at most I2C_MAX_LEN
+    I2cCallback callback;            //!< Called on completion, may be nullptr
+    void* context;                   //!< Free for the callback
+    volatile enum I2cStatus status;
+    uint32_t startUs;                //!< micros() at the start of the transaction on the bus, set by the engine
+    uint32_t endUs;                  //!< micros() at the end of the transaction, set by the engine
+
+    // Private, used by the engine
+    volatile enum I2cStatus result;
+    struct I2cTransaction* next;
+};
+
+/**
+ * @brief Bus usage of one device.
+ */
+struct I2cDeviceStats {
+    uint8_t address;
+    uint32_t transactions; //!< Completed transactions, errors included
+    uint32_t errors;       //!< Failed transactions
+    uint32_t bytes;        //!< Data bytes moved, address bytes excluded
+    uint32_t busyUs;       //!< Total time on the bus [us]
+    uint32_t maxUs;        //!< Longest transaction [us]
+};
+
+/**
+ * @brief Take over the Wire SERCOM. Wire.begin() must have been called.
+ * @param clock SCL frequency [Hz]
+ */
+void i2cbus_init(uint32_t clock);
+
+/**
+ * @brief Set the SCL frequency, waiting for the pending transactions first.
+ * @param clock SCL frequency [Hz], up to I2C_CLOCK_FMPLUS.
+ *
+ * Above I2C_CLOCK_FM the SERCOM is switched to Fast-mode Plus.
+ */
+void i2cbus_set_clock(uint32_t clock);
+
+/**
+ * @brief Reset a transaction to an empty one, ready to be filled.
+ * @param transaction The transaction. If still pending from a previous
+ * submission, it is waited for first.
+ * @param address 7-bit address.
+ * @param priority Queue priority.
+ */
+void i2cbus_prepare(struct I2cTransaction* transaction, uint8_t address, enum I2cPriority priority);
+
+/**
+ * @brief Queue a transaction.
+ * @param transaction Filled by the caller, must stay valid until completion.
+ * @return False if it is still pending from a previous submission or its
+ * lengths are invalid.
+ */
+bool i2cbus_submit(struct I2cTransaction* transaction);
+
+/**
+ * @brief Check for errors and timeouts and run the completion callbacks.
+ *
+ * To be called from loop().
+ */
+void i2cbus_task();
+
+/**
+ * @brief Wait for a transaction to complete.
+ * @return Its final status.
+ */
+enum I2cStatus i2cbus_wait(struct I2cTransaction* transaction);
+
+/**
+ * @brief Wait until nothing is queued or on the bus.
+ */
+void i2cbus_wait_idle();
+
+/**
+ * @brief True if a transaction is queued or on the bus.
+ */
+bool i2cbus_busy();
+
+/**
+ * @brief Get the bus usage statistics.
+ * @param count Filled with the number of devices seen.
+ * @return Pointer to the array of statistics, one per device.
+ */
+const struct I2cDeviceStats* i2cbus_get_stats(uint8_t* count);
+
+#endif // I2CBUS_H
@@ -0,0 +1,84 @@
+/**
+ * @file integrator.cpp
+ * @brief Source file for the charge integrator.
+ */
+
+#include "integrator.h"
+#include "estimator.h"
+#include "calibration.h"
+
+static int64_t charge = 0;
+static int64_t calibrated = 0; // [aC]
+static int64_t remainderZc = 0; // Of calibrated, below 1 aC
+static uint32_t frames = 0;
+static bool running = false;
+static bool overflow = false;
+
+
+void integrator_push(const struct rawDataFPGA& frame) {
+    if (!running || !frame.valid) {
+        return;
+    }
+
+    int64_t sample = fpga_signed_charge(frame.charge);
+    int64_t sum;
+    if (__builtin_add_overflow(charge, sample, &sum)) {
+        overflow = true;
+        sum = sample > 0 ? INT64_MAX : INT64_MIN;
+    }
+    charge = sum;
+
+    // Calibrated current [aA] * period [ms] = charge [zC]
+    int64_t current = calibration_current(estimator_window_current(frame), frame);
+    int64_t zc;
+    if (__builtin_mul_overflow(current, (int64_t)frame.periodMs, &zc)
+        || __builtin_add_overflow(zc, remainderZc, &zc)
+        || __builtin_add_overflow(calibrated, zc / 1000, &sum)) {
+        overflow = true;
+        sum = current > 0 ? INT64_MAX : INT64_MIN;
+        zc = 0;
+    }
+    calibrated = sum;
+    remainderZc = zc % 1000;
+    frames++;
+}
+
+void integrator_start() {
+    running = true;
+}
+
+void integrator_stop() {
+    running = false;
+}
+
+void integrator_reset() {
+    charge = 0;
+    calibrated = 0;
+    remainderZc = 0;
+    frames = 0;
+    overflow = false;
+}
+
+bool integrator_running() {
+    return running;
+}
+
+bool integrator_overflow() {
+    return overflow;
+}
+
+int64_t integrator_charge() {
+    return charge;
+}
+
+uint32_t integrator_frames() {
+    return frames;
+}
+
+int64_t integrator_calibrated_charge() {
+    return calibrated;
+}
+
+double integrator_charge_fc() {
+    return calibrated / 1000.0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file integrator.h
+ * @brief Exact integration of the charge, in LSB, and of the calibrated
+ * charge.
+ *
+ * The signed 48-bit charge of every frame is added to a 64-bit integer, so
+ * no sample is rounded and a full scale charge every frame, 2^47 LSB, would
+ * take 2^63 / 2^47 = 2^16 frames to overflow, about 1.8 hours at 100 ms. An
+ * overflow is detected, the integral then saturates and the overflow flag
+ * stays set until the next reset.
+ *
+ * The calibration does not apply to a charge in LSB: its range gain, offset
+ * and temperature correction are defined on the current. A second integral
+ * adds, in aC, the calibrated window current of each frame times its period,
+ * carrying the part below 1 aC over to the next frame. It is the one shown in
+ * fC, exact up to the aA rounding of each current.
+ *
+ * The integration is started, stopped and reset over SCPI and with button 2.
+ */
+
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define INTEGRATOR_RESET_HOLD_MS 2000 // Button 2 held this long resets
+
+/**
+ * @brief Add the charge of a decoded frame, if running.
+ */
+void integrator_push(const struct rawDataFPGA& frame);
+
+void integrator_start();
+void integrator_stop();
+
+/**
+ * @brief Clear the integral, the frame count and the overflow flag.
+ */
+void integrator_reset();
+
+bool integrator_running();
+
+/**
+ * @brief True if the integral overflowed and saturated since the last reset.
+ */
+bool integrator_overflow();
+
+/**
+ * @brief Integrated charge, uncalibrated [LSB]
+ */
+int64_t integrator_charge();
+
+/**
+ * @brief Integrated calibrated charge [aC]
+ */
+int64_t integrator_calibrated_charge();
+
+/**
+ * @brief Frames integrated since the last reset.
+ */
+uint32_t integrator_frames();
+
+/**
+ * @brief Integrated calibrated charge [fC]
+ */
+double integrator_charge_fc();
+
+#endif // INTEGRATOR_H
@@ -0,0 +1,122 @@
+/**
+ * @file io.cpp
+ * @brief Source file for the buttons and LEDs of the front panel.
+ *
+ * The buttons are active low, with the internal pull-up. The LEDs are on when
+ * their pin is low.
+ */
+
+#include "io.h"
+#include "SPSCbuf.h"
+#include <Arduino.h>
+
+static const uint8_t buttonPins[IO_BUTTON_COUNT] = {PIN_BUTTON, PIN_BUTTON2, PIN_BUTTON3};
+static const uint8_t ledPins[IO_LED_COUNT] = {PIN_LED, PIN_LED2, PIN_LED3};
+
+static volatile uint8_t status = 0;
+static volatile uint32_t lastEdgeMs[IO_BUTTON_COUNT] = {0};
+
+// Filled by the interrupts, and by io_task() with the interrupts disabled
+static SPSCbuf<struct IoEvent, IO_EVENT_QUEUE_SIZE> events;
+
+
+/**
+ * @brief Accept an edge of a button if it was stable, and queue it.
+ *
+ * Called from the EIC interrupt, or from io_task() with interrupts disabled.
+ */
+static void buttonEdge(uint8_t index, bool force) {
+    uint8_t bit = IO_BTN1 << index;
+    uint32_t now = millis();
+    bool pressed = digitalRead(buttonPins[index]) == LOW;
+
+    // Bounce of the edge just accepted
+    if (!force && now - lastEdgeMs[index] < IO_DEBOUNCE_MS) {
+        return;
+    }
+    lastEdgeMs[index] = now;
+    if (pressed == ((status & bit) != 0)) {
+        return;
+    }
+
+    status = pressed ? (status | bit) : (status & ~bit);
+
+    struct IoEvent event;
+    event.button = bit;
+    event.pressed = pressed;
+    event.timeMs = now;
+    events.push(event); // Dropped if the main loop does not keep up
+}
+
+static void button1Isr() {
+    buttonEdge(0, false);
+}
+
+static void button2Isr() {
+    buttonEdge(1, false);
+}
+
+static void button3Isr() {
+    buttonEdge(2, false);
+}
+
+
+void io_init() {
+    for (uint8_t i = 0; i < IO_LED_COUNT; i++) {
+        pinMode(ledPins[i], OUTPUT);
+        digitalWrite(ledPins[i], HIGH);
+    }
+
+    for (uint8_t i = 0; i < IO_BUTTON_COUNT; i++) {
+        pinMode(buttonPins[i], INPUT_PULLUP);
+        if (digitalRead(buttonPins[i]) == LOW) {
+            status |= IO_BTN1 << i;
+        }
+    }
+
+    attachInterrupt(digitalPinToInterrupt(PIN_BUTTON), button1Isr, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(PIN_BUTTON2), button2Isr, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(PIN_BUTTON3), button3Isr, CHANGE);
+}
+
+void io_task() {
+    for (uint8_t i = 0; i < IO_BUTTON_COUNT; i++) {
+        bool pressed = digitalRead(buttonPins[i]) == LOW;
+        if (pressed == ((status & (IO_BTN1 << i)) != 0)) {
+            continue;
+        }
+
+        // The interrupts are the other producer of the event queue
+        noInterrupts();
+        if (millis() - lastEdgeMs[i] >= IO_DEBOUNCE_MS) {
+            buttonEdge(i, true);
+        }
+        interrupts();
+    }
+}
+
+bool io_get_event(struct IoEvent* event) {
+    return events.pop(*event);
+}
+
+uint8_t io_status() {
+    return status;
+}
+
+void io_format_status(uint8_t ioStatus, char* buffer) {
+    for (uint8_t i = 0; i < IO_BUTTON_COUNT + IO_LED_COUNT; i++) {
+        buffer[i] = (ioStatus & (1 << i)) ? '1' : '0';
+    }
+    buffer[IO_BUTTON_COUNT + IO_LED_COUNT] = '\0';
+}
+
+void io_set_led(uint8_t led, bool on) {
+    for (uint8_t i = 0; i < IO_LED_COUNT; i++) {
+        if (led == (IO_LED1 << i)) {
+            digitalWrite(ledPins[i], on ? LOW : HIGH);
+            noInterrupts();
+            status = on ? (status | led) : (status & ~led);
+            interrupts();
+        }
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * @file io.h
+ * @brief Buttons and LEDs of the front panel.
+ *
+ * The buttons are captured by EIC interrupts on both edges, so a press is
+ * seen whatever the frame or refresh rate. An edge is accepted when the
+ * button has been stable for IO_DEBOUNCE_MS, the bounces following it are
+ * ignored. Each accepted edge is queued as an event for the main loop.
+ *
+ * The state of the buttons and LEDs is cached in a bit-packed byte, updated
+ * on change only, so reading it costs no GPIO access.
+ */
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IO_DEBOUNCE_MS 20
+#define IO_EVENT_QUEUE_SIZE 8 // Power of two
+
+/**
+ * @defgroup io_status Bits of the IO status, set when pressed or on
+ * @{
+ */
+#define IO_BTN1 (1 << 0)
+#define IO_BTN2 (1 << 1)
+#define IO_BTN3 (1 << 2)
+#define IO_LED1 (1 << 3)
+#define IO_LED2 (1 << 4)
+#define IO_LED3 (1 << 5)
+/** @} */
+
+#define IO_BUTTON_COUNT 3
+#define IO_LED_COUNT 3
+
+/**
+ * @brief A debounced button edge.
+ */
+struct IoEvent {
+    uint8_t button;  //!< IO_BTN1, IO_BTN2 or IO_BTN3
+    bool pressed;    //!< True on press, false on release
+    uint32_t timeMs; //!< millis() of the edge
+};
+
+/**
+ * @brief Configure the pins, turn the LEDs off and attach the interrupts.
+ */
+void io_init();
+
+/**
+ * @brief Catch up on the edges lost in the debounce window.
+ *
+ * A glitch shorter than IO_DEBOUNCE_MS can leave the cached state different
+ * from the pin. To be called periodically from the main loop.
+ */
+void io_task();
+
+/**
+ * @brief Take the oldest button event.
+ * @return False if there is none.
+ */
+bool io_get_event(struct IoEvent* event);
+
+/**
+ * @brief Cached state of the buttons and LEDs, see io_status.
+ */
+uint8_t io_status();
+
+/**
+ * @brief Format the IO status, only when it is output.
+ * @param buffer At least 7 characters.
+ *
+ * The first three characters are the buttons, BUTTON1 to BUTTON3, 1 when
+ * pressed. The last three are the LEDs, LED1 to LED3, 1 when on.
+ */
+void io_format_status(uint8_t ioStatus, char* buffer);
+
+/**
+ * @brief Turn a LED on or off.
+ * @param led IO_LED1, IO_LED2 or IO_LED3.
+ */
+void io_set_led(uint8_t led, bool on);
+
+#endif // IO_H
@@ -6,68 +6,113 @@
  */
 
 #include "ltc2471.h"
+#include "i2cBus.h"
 #include <Arduino.h>
 
-uint16_t ltc2471_read() {
-    uint16_t adcValue = 0;
+static struct I2cTransaction transaction;
+static uint8_t buffer[LTC2471_RD_LEN];
 
-    Wire.beginTransmission(LTC2471_ADDRESS);
-    Wire.write(LTC2471_CONFIG); // Write configuration byte to set SPD=1
-    if (Wire.endTransmission() != 0) {
-        return adcValue;
+static uint32_t lastReadUs = 0;
+static LTC2471_Status readStatus = LTC2471_OK;
+
+// Ring of the last conversions, sampleCount is the absolute index of the next one
+static struct Ltc2471Sample samples[LTC2471_RING_LEN];
+static uint32_t sampleCount = 0;
+
+
+void ltc2471_enable(bool enable) {
+    if (enable && !conf.adc.enable) {
+        // Old samples would bend the fit
+        sampleCount = 0;
+        readStatus = LTC2471_OK;
+        lastReadUs = micros();
     }
+    conf.adc.enable = enable;
+}
 
-    while (Wire.requestFrom(LTC2471_ADDRESS, LTC2471_RD_LEN) < LTC2471_RD_LEN) {
+void ltc2471_task() {
+    if (transaction.status == I2C_PENDING) {
+        return;
     }
 
-    adcValue = (Wire.read() << 8);  // Read MSB
-    adcValue |= Wire.read();        // Read LSB
+    // Collect the result of the last read
+    if (transaction.status != I2C_IDLE) {
+        if (transaction.status == I2C_OK) {
+            struct Ltc2471Sample* sample = &samples[sampleCount % LTC2471_RING_LEN];
+            sample->timeUs = transaction.endUs;
+            sample->value = (buffer[0] << 8) | buffer[1];
+            sampleCount++;
+            readStatus = LTC2471_OK;
+            // A new conversion starts at the end of the read
+            lastReadUs = transaction.endUs;
+        } else if (transaction.status != I2C_ERR_NACK) {
+            // NACK: conversion still in progress, try again later
+            readStatus = LTC2471_ERR_I2C;
+        }
+        transaction.status = I2C_IDLE;
+    }
 
-    return adcValue;
-}
+    if (!conf.adc.enable || micros() - lastReadUs < LTC2471_CONV_US) {
+        return;
+    }
 
+    // Write the configuration for the next conversion and read the last one.
+    // Both are NACKed while the conversion is in progress.
+    i2cbus_prepare(&transaction, LTC2471_ADDRESS, I2C_PRIORITY_NORMAL);
+    transaction.header[0] = LTC2471_CONFIG; // SPD=1
+    transaction.headerLen = 1;
+    transaction.rxData = buffer;
+    transaction.rxLen = LTC2471_RD_LEN;
+    if (i2cbus_submit(&transaction) == false) {
+        readStatus = LTC2471_ERR_I2C;
+    }
+    lastReadUs = micros();
+}
 
-float ltc2471_read_voltage() {
-    uint16_t adcValue = ltc2471_read();
-    float voltage = ((float)adcValue);
-    return voltage;
+bool ltc2471_read(uint16_t* value) {
+    if (sampleCount == 0) {
+        return false;
+    }
+    *value = samples[(sampleCount - 1) % LTC2471_RING_LEN].value;
+    return true;
 }
 
-float ltc2471_read_current() {
-    const uint16_t MAX_ADC_VALUE = 65535; // Maximum value for a 16-bit ADC
-    uint16_t adcValue1, adcValue2;
-    float voltage1, voltage2;
-    unsigned long startTime, endTime;
-    float deltaT, deltaV, current;
-
-    do {
-        // First measurement
-        Wire.beginTransmission(LTC2471_ADDRESS);
-        Wire.write(LTC2471_CONFIG);
-        Wire.endTransmission();
-        while (Wire.requestFrom(LTC2471_ADDRESS, LTC2471_RD_LEN) < LTC2471_RD_LEN) {
-        }
-        startTime = micros();
-        adcValue1 = (Wire.read() << 8) | Wire.read();
-        voltage1 = (adcValue1 * LTC2471_VREF) / MAX_ADC_VALUE;
+bool ltc2471_read_voltage(float* voltage) {
+    uint16_t adcValue;
+    if (ltc2471_read(&adcValue) == false) {
+        return false;
+    }
+    *voltage = (adcValue * LTC2471_VREF) / LTC2471_RESOLUTION;
+    return true;
+}
 
-        delay(CURRENT_MEASUREMENT_DELAY);
+LTC2471_Status ltc2471_read_current(float* current) {
+    if (readStatus != LTC2471_OK) {
+        return readStatus;
+    }
+    if (sampleCount < LTC2471_FIT_LEN) {
+        return LTC2471_NOT_ENOUGH;
+    }
 
-        // Second measurement
-        Wire.beginTransmission(LTC2471_ADDRESS);
-        Wire.write(LTC2471_CONFIG);
-        Wire.endTransmission();
-        while (Wire.requestFrom(LTC2471_ADDRESS, LTC2471_RD_LEN) < LTC2471_RD_LEN) {
+    // Least squares fit of v = a + b*t, times relative to the newest conversion
+    uint32_t newest = samples[(sampleCount - 1) % LTC2471_RING_LEN].timeUs;
+    float sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+    for (uint32_t i = sampleCount - LTC2471_FIT_LEN; i < sampleCount; i++) {
+        const struct Ltc2471Sample* sample = &samples[i % LTC2471_RING_LEN];
+        if (sample->value == 0 || sample->value == LTC2471_RESOLUTION) {
+            return LTC2471_SATURATED;
         }
-        endTime = micros();
-        adcValue2 = (Wire.read() << 8) | Wire.read();
-        voltage2 = (adcValue2 * LTC2471_VREF) / MAX_ADC_VALUE;
+        float t = -(float)(newest - sample->timeUs) / 1000000.0;
+        float v = (sample->value * LTC2471_VREF) / LTC2471_RESOLUTION;
+        sumT += t;
+        sumV += v;
+        sumTT += t * t;
+        sumTV += t * v;
+    }
 
-        // Check for saturation
-    } while (adcValue1 == MAX_ADC_VALUE || adcValue2 == MAX_ADC_VALUE || adcValue1 == 0 || adcValue2 == 0);
+    const float n = LTC2471_FIT_LEN;
+    float slope = (n * sumTV - sumT * sumV) / (n * sumTT - sumT * sumT);
 
-    deltaT = (endTime - startTime) / 1000000.0;
-    deltaV = voltage2 - voltage1;
-    current = (Cf * deltaV) / deltaT;
-    return current;
+    *current = Cf * slope;
+    return LTC2471_OK;
 }
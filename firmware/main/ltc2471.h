@@ -3,6 +3,12 @@
  *
  * Created: 05/06/2024 14:55
  *  Author: hliverud
+ *
+ * The ADC is sampled in the background at its maximum rate by ltc2471_task():
+ * each conversion is read through the i2c engine as soon as it is ready,
+ * timestamped with the end of the read, and stored in a ring. The current is
+ * the slope of the voltage, fitted by least squares over the last
+ * LTC2471_FIT_LEN conversions, times the feedback capacitance.
  */
 
 
@@ -10,7 +16,6 @@
 #define LTC2471_H
 
 #include <Arduino.h>
-#include <Wire.h>
 #include "config.h"
 
  // I2C address for LTC2471 with A0 tied to GND
@@ -21,8 +26,35 @@
 #define LTC2471_RESOLUTION 65535  // 16-bit ADC resolution
 #define LTC2471_RD_LEN 2
 
-uint16_t ltc2471_read();
-float ltc2471_read_voltage();
-float ltc2471_read_current();
+#define LTC2471_CONV_US 1200 // Conversion time at 833 sps (SPD=1)
+#define LTC2471_RING_LEN 64  // Conversions kept, must be a power of two
+#define LTC2471_FIT_LEN 32   // Conversions in the slope fit, at most LTC2471_RING_LEN
+
+typedef enum {
+    LTC2471_OK = 0,
+    LTC2471_NOT_ENOUGH = 1,  // Fewer than LTC2471_FIT_LEN conversions since the start
+    LTC2471_SATURATED = 2,   // A conversion in the fit is at the full scale
+    LTC2471_ERR_I2C = 3      // The last read failed for another reason than a conversion in progress
+} LTC2471_Status;
+
+struct Ltc2471Sample {
+    uint32_t timeUs;    // End of the read [us]
+    uint16_t value;     // Raw conversion
+};
+
+// Start or stop the background sampling
+void ltc2471_enable(bool enable);
+
+// Read the conversions when ready, to be called from loop()
+void ltc2471_task();
+
+// Latest raw conversion, false if none yet
+bool ltc2471_read(uint16_t* value);
+
+// Latest conversion in volts, false if none yet
+bool ltc2471_read_voltage(float* voltage);
+
+// Current from the slope fit, in the same unit as before (Cf * dV/dt)
+LTC2471_Status ltc2471_read_current(float* current);
 
 #endif
@@ -16,36 +16,39 @@
 #include "sht41.h"
 #include "dac7578.h"
 #include "ssd1306.h"
+#include "screen.h"
+#include "i2cBus.h"
+#include "scheduler.h"
+#include "perf.h"
+#include "io.h"
 #include "fpga.h"
 #include "config.h"
 #include "ltc2471.h"
+#include "trigger.h"
+#include "stats.h"
+#include "history.h"
+#include "integrator.h"
+#include "estimator.h"
+#include "calibration.h"
+#include "sweep.h"
+#include "quanta.h"
+#include "timeSync.h"
 #include "RTClib.h"
 
-/*
-The library is fully implemented in the header file, so in order to avoid multiple
-definition during linking, the NO_IMPL flag is defined in all outside one include
-statements.
-*/
-#define VREKRER_SCPI_PARSER_NO_IMPL
 #include "scpiInterface.h"
 
-enum ScreenMode screenMode = CURRENT_DISPLAY;
-bool oldBtn1Status = 1;
-bool newModeFlag = false;
-int chargeIntegration = 0;
-
 // Global configuration struct definition + initialization
 struct confParam conf = defaultConf;
 
-// SCPI parser object definition
-SCPI_Parser my_instrument;
-
 // RTL PCF8523 object definition
 RTC_PCF8523 rtc;
 
 // SD card object definition
 File logFile;
 
+// Output task, signalled on each new frame
+static int8_t outputTaskId = -1;
+
 void setup() {
     // Init USB-C serial
     Serial.begin(9600);
@@ -58,27 +61,18 @@ void setup() {
     // Init I2C
     Wire.begin();
 
+    // Start the counter of the timing probes
+    perf_init();
+
     // Init LEDs and buttons and set LEDs to off
-    pinMode(PIN_BUTTON, INPUT_PULLUP);
-    pinMode(PIN_BUTTON2, INPUT_PULLUP);
-    pinMode(PIN_BUTTON3, INPUT_PULLUP);
-    pinMode(PIN_LED, OUTPUT);
-    pinMode(PIN_LED2, OUTPUT);
-    pinMode(PIN_LED3, OUTPUT);
+    io_init();
     pinMode(LED_ALIVE, OUTPUT);
     digitalWrite(LED_ALIVE, HIGH);
-    // Turn off LEDs
-    digitalWrite(PIN_LED, HIGH);
-    digitalWrite(PIN_LED2, HIGH);
-    digitalWrite(PIN_LED3, HIGH);
 
     // Init screen and DAC
     ssd1306_init();
     dac7578_init();
 
-    // Init SCPI parser
-    init_scpiInterface();
-
     // Get samd21 UUID
     conf.UUID = getChipUUID();
 
@@ -93,6 +87,10 @@ void setup() {
     }
     rtc.start();
 
+    // Hand the I2C bus to the transaction engine. Only after the screen and
+    // RTC init, as their libraries reset the Wire clock.
+    i2cbus_init(conf.i2c.clock);
+
     // Init SD card
     const int chipSelect = 10;
     pinMode(SD_CHIP_SELECT_PIN, OUTPUT);
@@ -103,88 +101,153 @@ void setup() {
         logFile = SD.open(filename, FILE_WRITE);
     }
 
+    // Calibration stored in flash, nominal if none
+    calibration_init();
+
     // Init FPGA with default configuration parameters
     fpgaUpdateAllParam();
+
+    // Main loop tasks. The frame ingestion is polled before any other task,
+    // the output of a frame is the most urgent of the others.
+    // Periods and deadlines in us.
+    sched_init(schedClock);
+    sched_add("frame", taskFrameIngest, SCHED_POLL, 0, 0, 0);
+    outputTaskId = sched_add("output", taskFrameOutput, SCHED_EVENT, 0, 0, 20000);
+    sched_add("i2c", i2cbus_task, SCHED_PERIODIC, 1, 500, 5000);
+    sched_add("scpi", taskScpi, SCHED_PERIODIC, 2, 5000, 50000);
+    sched_add("buttons", taskButtons, SCHED_PERIODIC, 2, 5000, 20000);
+    sched_add("sweep", sweep_task, SCHED_PERIODIC, 2, 5000, 50000);
+    sched_add("quanta", quanta_task, SCHED_PERIODIC, 2, 5000, 50000);
+    sched_add("adc", ltc2471_task, SCHED_PERIODIC, 3, 250, 2000);
+    sched_add("sht41", sht41_task, SCHED_PERIODIC, 3, 1000, 10000);
+    sched_add("timesync", timesync_task, SCHED_PERIODIC, 3, 10000, 20000);
+    sched_add("screen", screen_task, SCHED_PERIODIC, 4, 10000, 100000);
 }
 
 void loop() {
-    // Read data from FPGA
-    struct rawDataFPGA rawData;
-    rawData = fpgaReadData();
+    sched_run();
+}
+
+
+/**
+ * @brief Time source of the scheduler.
+ */
+uint32_t schedClock() {
+    return micros();
+}
 
-    // Read from PC -> SCPI parser
-    my_instrument.ProcessInput(Serial, "\n");
+/**
+ * @brief Assemble the frames coming from the FPGA, without blocking.
+ */
+void taskFrameIngest() {
+    if (fpgaPollFrame()) {
+        sched_signal(outputTaskId);
+    }
+}
+
+/**
+ * @brief Hand the new frames to the screen, the trigger engine, the
+ * statistics, the history, the integrator, the serial port and the SD card.
+ *
+ * Each output drains its own cursor of the frame queue, also when disabled.
+ */
+void taskFrameOutput() {
+    struct rawDataFPGA frame;
 
-    // Only update display and send out data over serial
-    // if there is data available.
-    if (rawData.valid) {
-        rawData.valid = false;
+    // Hand the samples to the screen, redrawn at its own pace
+    while (fpgaFrameQueue.pop(FPGA_READER_DISPLAY, frame)) {
+        screen_push_sample(frame);
+    }
+
+    // Look for trigger events
+    while (fpgaFrameQueue.pop(FPGA_READER_TRIGGER, frame)) {
+        trigger_push(frame);
+    }
+
+    // Update the running statistics
+    while (fpgaFrameQueue.pop(FPGA_READER_STATS, frame)) {
+        stats_push(frame);
+    }
+
+    // Aggregate the history
+    while (fpgaFrameQueue.pop(FPGA_READER_HISTORY, frame)) {
+        history_push(frame);
+    }
 
-        // Update the ssd1306 screen
-        updateScreen(rawData);
+    // Integrate the charge, before the output that may append it
+    while (fpgaFrameQueue.pop(FPGA_READER_INTEGRATOR, frame)) {
+        integrator_push(frame);
+    }
 
-        // Get output string
-        String message = getOutputString(rawData);
-        // Print over serial
+    // Print over serial
+    while (fpgaFrameQueue.pop(FPGA_READER_STREAM, frame)) {
         if (conf.serial.stream) {
+            uint32_t start = perf_now();
+            String message = getOutputString(frame, conf.filter.stream);
+            perf_record(PERF_FORMAT, start);
+
+            start = perf_now();
             Serial.println(message);
+            perf_record(PERF_SERIAL, start);
         }
-        // Log to SD card
+    }
+
+    // Log to SD card
+    while (fpgaFrameQueue.pop(FPGA_READER_LOG, frame)) {
         if (conf.serial.log) {
+            uint32_t start = perf_now();
+            String message = getOutputString(frame, conf.filter.log);
+            perf_record(PERF_FORMAT, start);
+
+            start = perf_now();
             logFile.println(message);
+            perf_record(PERF_SD, start);
         }
     }
 }
 
-
 /**
- * @brief Update the screen mode
- * @param rawData The raw data coming from the FPGA
- * @return void
+ * @brief Act on the button presses.
  *
- * Calculate the cahrge value based on the current screen mode and print it
- * to display. Check if button 1 got pressed, if so cycle to the next screen
- * mode.
+ * Button 1 cycles the screen mode. Button 2 starts or stops the charge
+ * integration, or resets it when held for INTEGRATOR_RESET_HOLD_MS.
  */
-void updateScreen(struct rawDataFPGA rawData) {
-    IOstatus status = getPinStatus();
-    screenMode = parseButtons(status, screenMode);
-
-    // Calculate the current and format it
-    float readCurrent = fpga_calc_current(rawData.charge, DEFAULT_LSB, DEFAULT_PERIOD);
-    CurrentMeasurement current_measurement = fpga_format_current(readCurrent);
-
-    // Calculate temperature and humidity from raw data
-    TempHumMeasurement measuredTempHum;
-    sht41_calculate(rawData.tempSht41, rawData.humidSht41, &measuredTempHum);
-    String temp = String(measuredTempHum.temperature, 2);
-    String humidity = String(measuredTempHum.humidity, 2);
-
-    // Screen update
-    float chargefA = (rawData.charge * DEFAULT_LSB) / 1000;
-    switch (screenMode) {
-    case CHARGE_DETECTION:
-        ssd1306_print_charge(chargefA, temp, humidity, "Single sample");
-        break;
-    case CHARGE_INTEGRATION:
-        if (newModeFlag == true) {
-            newModeFlag = false;
-            chargeIntegration = 0;
+void taskButtons() {
+    static uint32_t button2PressMs = 0;
+
+    io_task();
+
+    struct IoEvent event;
+    while (io_get_event(&event)) {
+        if (event.button == IO_BTN1 && event.pressed) {
+            screen_next_mode();
+        } else if (event.button == IO_BTN2 && event.pressed) {
+            button2PressMs = event.timeMs;
+        } else if (event.button == IO_BTN2) {
+            if (event.timeMs - button2PressMs >= INTEGRATOR_RESET_HOLD_MS) {
+                integrator_reset();
+            } else if (integrator_running()) {
+                integrator_stop();
+            } else {
+                integrator_start();
+            }
         }
-        chargeIntegration += chargefA;
-        ssd1306_print_charge(chargeIntegration, temp, humidity, "Integration");
-        break;
-    case VAR_SEMPLING_TIME:
-        // ssd1306_print_transition(screenMode);
-        ssd1306_print_charge(rawData.charge , temp, humidity, "Multi sample");
-        break;
-    case CURRENT_DISPLAY:
-        ssd1306_print_current_temp_humidity(current_measurement.convertedCurrent, current_measurement.range, temp, humidity);
-    default:
-        break;
     }
 }
 
+/**
+ * @brief Read from PC -> SCPI parser
+ */
+void taskScpi() {
+    // Only time the passes with a command to process
+    if (Serial.available() == 0) {
+        return;
+    }
+    uint32_t start = perf_now();
+    process_scpiInterface(Serial);
+    perf_record(PERF_SCPI, start);
+}
+
 
 /**
  * @brief Retrieve the 128-bit UUID of the SAMD21 chip
@@ -205,59 +268,19 @@ uint32_t * getChipUUID() {
 }
 
 
-/**
- * @brief Parse the button status and update the screen mode
- * @param status The status of the buttons and LEDs
- * @param screenMode The current screen mode
- * @return The new screen mode
- *
- * Check if button1 is pressed. If so, cycle to the next screen mode.
- */
-enum ScreenMode parseButtons(struct IOstatus status, enum ScreenMode screenMode) {
-    enum ScreenMode newState = screenMode;
-
-    // Button is idle high
-    if (status.btn1 == 1 && oldBtn1Status == 0) {
-        // Set flag to signify that we're entering a new screen mode
-        newModeFlag = true;
-
-        switch (screenMode) {
-        case CHARGE_DETECTION:
-            newState = CHARGE_INTEGRATION;
-            break;
-        case CHARGE_INTEGRATION:
-            newState = VAR_SEMPLING_TIME;
-            break;
-        case VAR_SEMPLING_TIME:
-            newState = CURRENT_DISPLAY;
-            break;
-        case CURRENT_DISPLAY:
-            newState = CHARGE_DETECTION;
-            break;
-        default:
-            break;
-        }
-    }
-    oldBtn1Status = status.btn1;
-
-    return newState;
-}
-
-
 /**
  * @brief Get the output string to print
  * @param rawData The raw data from the FPGA
+ * @param filtered If true the current is the filtered one, else the raw one
  * @return The output string
  *
  * @note It uses the global flag RAW_OUTPUT, defined in the file config.h,
  * to decide if the output should be raw or formatted.
  */
-String getOutputString(struct rawDataFPGA rawData) {
+String getOutputString(struct rawDataFPGA rawData, bool filtered) {
     String message;
-    struct IOstatus btnLedStatus = getPinStatus();
-    
-    // Create timestamp string
-    String timestamp = rtc.now().timestamp();
+    char ioStatus[IO_BUTTON_COUNT + IO_LED_COUNT + 1];
+    io_format_status(io_status(), ioStatus);
 
     if (conf.serial.rawOutput) {
         message = uint64ToString(rawData.charge) + "," +
@@ -268,7 +291,12 @@ String getOutputString(struct rawDataFPGA rawData) {
                 String(rawData.cp1EndInterval) + "," +
                 String(rawData.tempSht41) + "," +
                 String(rawData.humidSht41) + "," +
-                btnLedStatus.status;
+                ioStatus + "," +
+                uint64ToString(rawData.timestamp) + "," +
+                String(rawData.periodMs);
+        if (conf.serial.integral) {
+            message += "," + int64ToString(integrator_charge());
+        }
     } else {
         // Calculate the time intervals
         float startIntervalTime = (rawData.cp1StartInterval + 1) * 1/ACCURATE_CLK;
@@ -281,7 +309,7 @@ String getOutputString(struct rawDataFPGA rawData) {
         String humidity = String(measuredTempHum.humidity, 2);
 
         // Calculate the current and format it
-        float readCurrent = fpga_calc_current(rawData.charge, DEFAULT_LSB, DEFAULT_PERIOD);
+        float readCurrent = filtered ? rawData.filtered / 1000.0f : estimator_current(rawData);
         CurrentMeasurement current_measurement = fpga_format_current(readCurrent);
 
         message = String(current_measurement.currentInFemtoAmpere) + "," +
@@ -292,7 +320,11 @@ String getOutputString(struct rawDataFPGA rawData) {
                 String(endIntervalTime) + "," +
                 String(temp) + "," +
                 String(humidity) + "," +
-                btnLedStatus.status;
+                ioStatus + "," +
+                uint64ToString(rawData.timestamp);
+        if (conf.serial.integral) {
+            message += "," + String(integrator_charge_fc(), 3);
+        }
     }
     return message;
 }
@@ -316,3 +348,15 @@ String uint64ToString(uint64_t val) {
 
     return ndx;
 }
+
+/**
+ * @brief Convert an int64_t to a string
+ * @param input The input value
+ * @return The string representation of the input value
+ */
+String int64ToString(int64_t val) {
+    if (val < 0) {
+        return "-" + uint64ToString(-(uint64_t)val);
+    }
+    return uint64ToString(val);
+}
@@ -0,0 +1,104 @@
+/**
+ * @file nvm.cpp
+ * @brief Source file for the flash record.
+ *
+ * The page buffer is written with 32-bit accesses in manual write mode, then
+ * committed with a write page command. The CPU stalls while the flash is
+ * busy, interrupts included, so nothing runs from flash meanwhile.
+ */
+
+#include "nvm.h"
+#include <Arduino.h>
+#include <string.h>
+
+// The reserved row, zeroed in the image: not a valid record
+__attribute__((aligned(NVM_ROW_SIZE), used))
+static const uint8_t row[NVM_ROW_SIZE] = {0};
+
+struct NvmHeader {
+    uint16_t size;
+    uint16_t crc;
+};
+
+static_assert(sizeof(struct NvmHeader) == NVM_HEADER_SIZE, "NVM header size mismatch");
+
+
+/**
+ * @brief CRC-16/CCITT-FALSE of a buffer.
+ */
+static uint16_t crc16(const uint8_t* data, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Address of the row, hidden from the optimiser so that it does not
+ * fold the reads into the constant initial content.
+ */
+static const uint8_t* rowData() {
+    const uint8_t* data = row;
+    __asm__ volatile("" : "+r"(data));
+    return data;
+}
+
+static void nvmCommand(uint16_t command, uint32_t address) {
+    NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+    // ADDR counts 16-bit words
+    NVMCTRL->ADDR.reg = address / 2;
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | command;
+    while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+
+bool nvm_read(void* data, uint16_t size) {
+    const uint8_t* stored = rowData();
+    struct NvmHeader header;
+    memcpy(&header, stored, sizeof(header));
+
+    if (header.size != size || size > NVM_MAX_SIZE) {
+        return false;
+    }
+    if (crc16(stored + NVM_HEADER_SIZE, size) != header.crc) {
+        return false;
+    }
+
+    memcpy(data, stored + NVM_HEADER_SIZE, size);
+    return true;
+}
+
+bool nvm_write(const void* data, uint16_t size) {
+    if (size > NVM_MAX_SIZE) {
+        return false;
+    }
+
+    // Whole words, padded with the erased value
+    uint32_t buffer[NVM_ROW_SIZE / 4];
+    memset(buffer, 0xFF, sizeof(buffer));
+    struct NvmHeader header = {size, crc16((const uint8_t*)data, size)};
+    memcpy(buffer, &header, sizeof(header));
+    memcpy((uint8_t*)buffer + NVM_HEADER_SIZE, data, size);
+
+    uint32_t address = (uint32_t)rowData();
+    NVMCTRL->CTRLB.bit.MANW = 1;
+    nvmCommand(NVMCTRL_CTRLA_CMD_ER, address);
+
+    for (uint16_t page = 0; page < NVM_ROW_SIZE; page += NVM_PAGE_SIZE) {
+        nvmCommand(NVMCTRL_CTRLA_CMD_PBC, address + page);
+
+        volatile uint32_t* destination = (volatile uint32_t*)(address + page);
+        for (uint8_t word = 0; word < NVM_PAGE_SIZE / 4; word++) {
+            destination[word] = buffer[(page / 4) + word];
+        }
+        nvmCommand(NVMCTRL_CTRLA_CMD_WP, address + page);
+    }
+    // Drop the stale cache lines of the row
+    nvmCommand(NVMCTRL_CTRLA_CMD_INVALL, address);
+
+    return memcmp(rowData(), buffer, NVM_HEADER_SIZE + size) == 0;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file nvm.h
+ * @brief Record kept in a row of the internal flash.
+ *
+ * The SAMD21 has no EEPROM: a 256-byte row of the program flash, reserved
+ * by an aligned constant, holds one record written through NVMCTRL. The
+ * record is stored with its size and a CRC-16, so an erased or stale row is
+ * not taken for a valid one. A row endures 25k erase cycles, it is written
+ * only on request. Uploading a new sketch erases it.
+ */
+
+#ifndef NVM_H
+#define NVM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NVM_ROW_SIZE 256 // Erase unit
+#define NVM_PAGE_SIZE 64 // Write unit
+#define NVM_HEADER_SIZE 4 // Size and CRC before the record
+#define NVM_MAX_SIZE (NVM_ROW_SIZE - NVM_HEADER_SIZE)
+
+/**
+ * @brief Read the record.
+ * @return False if the row holds no valid record of this size.
+ */
+bool nvm_read(void* data, uint16_t size);
+
+/**
+ * @brief Erase the row and write the record, blocking for about 10 ms.
+ * @return False if the record is too large or does not read back.
+ */
+bool nvm_write(const void* data, uint16_t size);
+
+#endif // NVM_H
@@ -0,0 +1,87 @@
+/**
+ * @file perf.cpp
+ * @brief Source file for the timing probes.
+ *
+ * The counter is read with continuous read synchronisation (READREQ.RCONT),
+ * so a read does not wait for the TC clock domain. The value lags by a
+ * constant synchronisation delay, which cancels out in a difference.
+ */
+
+#include "perf.h"
+#include <Arduino.h>
+#include <string.h>
+
+static struct PerfStats stats[PERF_PROBE_COUNT];
+static uint32_t overheadCycles = 0; // Cycles of an empty measurement
+
+static const char* const probeNames[PERF_PROBE_COUNT] = {
+    "decode",
+    "scpi",
+    "display",
+    "format",
+    "serial",
+    "sd",
+    "filter"
+};
+
+
+static void syncTc() {
+    while (TC4->COUNT32.STATUS.reg & TC_STATUS_SYNCBUSY);
+}
+
+void perf_init() {
+    PM->APBCMASK.reg |= PM_APBCMASK_TC4 | PM_APBCMASK_TC5;
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_TC4_TC5 | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_CLKEN;
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY);
+
+    TC4->COUNT32.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC4->COUNT32.CTRLA.reg & TC_CTRLA_SWRST);
+
+    // Free running, TC5 is the upper half of the counter
+    TC4->COUNT32.CTRLA.reg = TC_CTRLA_MODE_COUNT32 | TC_CTRLA_PRESCALER_DIV1;
+    syncTc();
+    TC4->COUNT32.READREQ.reg = TC_READREQ_RCONT | TC_READREQ_ADDR(TC_COUNT32_COUNT_OFFSET);
+    syncTc();
+    TC4->COUNT32.CTRLA.reg |= TC_CTRLA_ENABLE;
+    syncTc();
+
+    // Cost of the probe itself, removed from every measurement
+    overheadCycles = 0;
+    uint32_t start = perf_now();
+    overheadCycles = perf_now() - start;
+
+    perf_reset();
+}
+
+uint32_t perf_now() {
+    return TC4->COUNT32.COUNT.reg;
+}
+
+void perf_record(enum PerfProbe probe, uint32_t start) {
+    uint32_t cycles = perf_now() - start;
+    cycles = cycles > overheadCycles ? cycles - overheadCycles : 0;
+
+    struct PerfStats* probeStats = &stats[probe];
+    if (probeStats->count == 0 || cycles < probeStats->minCycles) probeStats->minCycles = cycles;
+    if (cycles > probeStats->maxCycles) probeStats->maxCycles = cycles;
+    probeStats->count++;
+    probeStats->totalCycles += cycles;
+
+    uint8_t bin = cycles == 0 ? 0 : 32 - __builtin_clz(cycles);
+    if (bin >= PERF_HIST_BINS) {
+        bin = PERF_HIST_BINS - 1;
+    }
+    probeStats->histogram[bin]++;
+}
+
+const struct PerfStats* perf_get(enum PerfProbe probe) {
+    return &stats[probe];
+}
+
+const char* perf_name(enum PerfProbe probe) {
+    return probeNames[probe];
+}
+
+void perf_reset() {
+    memset(stats, 0, sizeof(stats));
+}
@@ -0,0 +1,80 @@
+/**
+ * @file perf.h
+ * @brief Timing probes for the main loop work.
+ *
+ * TC4 and TC5, chained as a 32-bit counter, count the 48 MHz CPU clock
+ * without interrupts. A probe measures the cycles from perf_now() to
+ * perf_record() and keeps their min/mean/max and a log2 histogram: bin 0
+ * holds the zero durations, bin n the durations from 2^(n-1) to 2^n - 1
+ * cycles, the last bin everything longer.
+ *
+ * The counter wraps every 89 s, a probe must not span more than that.
+ * TC4 and TC5 are no longer available to tone() and Servo.
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+#define PERF_CLOCK_HZ 48000000 // Counter frequency, CPU clock
+#define PERF_HIST_BINS 24      // Last bin from 2^22 cycles, 87 ms
+
+/**
+ * @brief The measured pieces of work.
+ */
+enum PerfProbe {
+    PERF_DECODE,  //!< FPGA frame decoding
+    PERF_SCPI,    //!< SCPI command processing
+    PERF_DISPLAY, //!< Screen drawing
+    PERF_FORMAT,  //!< Output string formatting
+    PERF_SERIAL,  //!< Output string serial write
+    PERF_SD,      //!< Output string SD card write
+    PERF_FILTER,  //!< Current estimation and filter stage
+    PERF_PROBE_COUNT
+};
+
+/**
+ * @brief Timing of one probe, in counter cycles.
+ */
+struct PerfStats {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint32_t histogram[PERF_HIST_BINS];
+};
+
+/**
+ * @brief Start the counter and measure the probe overhead.
+ */
+void perf_init();
+
+/**
+ * @brief Current counter value, the start of a measurement.
+ */
+uint32_t perf_now();
+
+/**
+ * @brief End a measurement.
+ * @param probe The measured piece of work.
+ * @param start perf_now() at the beginning of the work.
+ */
+void perf_record(enum PerfProbe probe, uint32_t start);
+
+/**
+ * @brief Get the timing of a probe.
+ */
+const struct PerfStats* perf_get(enum PerfProbe probe);
+
+/**
+ * @brief Short name of a probe, as reported over SCPI.
+ */
+const char* perf_name(enum PerfProbe probe);
+
+/**
+ * @brief Clear the timing of all the probes.
+ */
+void perf_reset();
+
+#endif // PERF_H
@@ -0,0 +1,277 @@
+/**
+ * @file quanta.cpp
+ * @brief Source file for the measurement of the charge quanta.
+ */
+
+#include "quanta.h"
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "calibration.h"
+
+#define QUANTA_MIN_PIVOT 1e-12 // Of the normal equations, below it a ratio is undetermined
+
+// Each pump alone first, then the combinations
+static const uint8_t phasePumps[QUANTA_PHASE_COUNT] = {0x1, 0x2, 0x4, 0x3, 0x5, 0x6, 0x7};
+
+static struct QuantaPhase phases[QUANTA_PHASE_COUNT];
+static enum QuantaState state = QUANTA_IDLE;
+static uint8_t phase = 0;
+static bool phaseStarted = false; // The pumps of the phase are written
+static uint16_t windows = 0;      // Of the phase, settle windows included
+static uint32_t activations = QUANTA_DEFAULT_ACTIVATIONS;
+static uint8_t writtenPumps = 0; // Enabled in the FPGA
+static double ratios[QUANTA_PUMP_COUNT] = {1, 1, 1};
+
+
+/**
+ * @brief Enable only the pumps of a combination, writing the disable
+ * registers that change.
+ */
+static void writePumps(uint8_t pumps) {
+    const uint8_t addresses[QUANTA_PUMP_COUNT] = {
+        FPGA_ACC_DISABLE_CP1_ADDR, FPGA_ACC_DISABLE_CP2_ADDR, FPGA_ACC_DISABLE_CP3_ADDR
+    };
+
+    for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+        bool enabled = pumps & (1 << i);
+        if (enabled != (bool)(writtenPumps & (1 << i))) {
+            fpgaWriteParam(addresses[i], !enabled);
+        }
+    }
+    writtenPumps = pumps;
+}
+
+/**
+ * @brief Pumps enabled by conf.acc.
+ */
+static uint8_t configuredPumps() {
+    uint8_t pumps = 0;
+    for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+        if (!conf.acc.disableCP[i]) {
+            pumps |= 1 << i;
+        }
+    }
+    return pumps;
+}
+
+/**
+ * @brief Solve a 3x3 system in place, Gaussian elimination with partial
+ * pivoting.
+ * @return False if it is singular.
+ */
+static bool solve3(double m[3][3], double v[3], double x[3]) {
+    for (uint8_t col = 0; col < 3; col++) {
+        uint8_t pivot = col;
+        for (uint8_t row = col + 1; row < 3; row++) {
+            if (fabs(m[row][col]) > fabs(m[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(m[pivot][col]) < QUANTA_MIN_PIVOT) {
+            return false;
+        }
+        for (uint8_t k = 0; k < 3; k++) {
+            double swap = m[col][k];
+            m[col][k] = m[pivot][k];
+            m[pivot][k] = swap;
+        }
+        double swap = v[col];
+        v[col] = v[pivot];
+        v[pivot] = swap;
+
+        for (uint8_t row = col + 1; row < 3; row++) {
+            double factor = m[row][col] / m[col][col];
+            for (uint8_t k = col; k < 3; k++) {
+                m[row][k] -= factor * m[col][k];
+            }
+            v[row] -= factor * v[col];
+        }
+    }
+
+    for (int8_t row = 2; row >= 0; row--) {
+        double sum = v[row];
+        for (uint8_t k = row + 1; k < 3; k++) {
+            sum -= m[row][k] * x[k];
+        }
+        x[row] = sum / m[row][row];
+    }
+    return true;
+}
+
+/**
+ * @brief Least squares ratios of the quanta, from the rates of every phase.
+ *
+ * Unknowns q2/q1, q3/q1 and I/q1, each phase giving
+ * rate_2 * q2/q1 + rate_3 * q3/q1 - I/q1 = -rate_1.
+ */
+static bool solveRatios() {
+    double m[3][3] = {{0}};
+    double v[3] = {0};
+
+    for (uint8_t k = 0; k < QUANTA_PHASE_COUNT; k++) {
+        if (phases[k].timeMs == 0) {
+            return false;
+        }
+        double rate[QUANTA_PUMP_COUNT];
+        for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+            rate[i] = (double)phases[k].counts[i] / phases[k].timeMs;
+        }
+        // A pump alone must have activated
+        if (k < QUANTA_PUMP_COUNT && phases[k].counts[k] == 0) {
+            return false;
+        }
+
+        const double a[3] = {rate[1], rate[2], -1};
+        for (uint8_t row = 0; row < 3; row++) {
+            for (uint8_t col = 0; col < 3; col++) {
+                m[row][col] += a[row] * a[col];
+            }
+            v[row] -= a[row] * rate[0];
+        }
+    }
+
+    double x[3];
+    if (!solve3(m, v, x) || !(x[0] > 0 && x[1] > 0)) {
+        return false;
+    }
+    ratios[0] = 1;
+    ratios[1] = x[0];
+    ratios[2] = x[1];
+    return true;
+}
+
+/**
+ * @brief Set the quanta of CP2 and CP3 from the ratios.
+ * @return False if one does not fit its register.
+ */
+static bool applyRatios() {
+    uint32_t quanta[QUANTA_PUMP_COUNT];
+    for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+        double value = round(conf.acc.chargeQuantaCP[0] * ratios[i]);
+        if (!(value >= 1 && value <= QUANTA_MAX_VALUE)) {
+            return false;
+        }
+        quanta[i] = value;
+    }
+    for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+        conf.acc.chargeQuantaCP[i] = quanta[i];
+    }
+
+    // The pump gains were relative to the previous quanta, CP1 keeps the scale
+    struct CalibrationRecord record = *calibration_get();
+    for (uint8_t i = 1; i < CALIBRATION_PUMP_COUNT; i++) {
+        record.pumpGain[i] = record.pumpGain[0];
+    }
+    calibration_set(record);
+    return true;
+}
+
+static void finish() {
+    bool solved = solveRatios() && applyRatios();
+    state = solved ? QUANTA_DONE : QUANTA_FAILED;
+    // Write back the configured pumps, with the new quanta if solved
+    fpgaUpdateAllParam();
+}
+
+/**
+ * @brief Accumulate a frame, moving to the next phase once enough
+ * activations or windows are measured.
+ */
+static void pushFrame(const struct rawDataFPGA& frame) {
+    windows++;
+    if (windows <= QUANTA_SETTLE_WINDOWS) {
+        return;
+    }
+
+    struct QuantaPhase* current = &phases[phase];
+    if (frame.valid) {
+        current->counts[0] += frame.cp1Count;
+        current->counts[1] += frame.cp2Count;
+        current->counts[2] += frame.cp3Count;
+        current->timeMs += frame.periodMs;
+    }
+
+    uint32_t total = current->counts[0] + current->counts[1] + current->counts[2];
+    if (total >= activations || windows >= QUANTA_SETTLE_WINDOWS + QUANTA_MAX_WINDOWS) {
+        phase++;
+        phaseStarted = false;
+    }
+}
+
+
+bool quanta_set_activations(uint32_t newActivations) {
+    if (newActivations == 0 || newActivations > QUANTA_MAX_ACTIVATIONS) {
+        return false;
+    }
+    activations = newActivations;
+    return true;
+}
+
+uint32_t quanta_get_activations() {
+    return activations;
+}
+
+void quanta_start() {
+    // The pumps of a running measurement are written back first, so that
+    // writtenPumps holds again
+    quanta_abort();
+
+    for (uint8_t k = 0; k < QUANTA_PHASE_COUNT; k++) {
+        phases[k] = {phasePumps[k], {0, 0, 0}, 0};
+    }
+    phase = 0;
+    phaseStarted = false;
+    writtenPumps = configuredPumps();
+    state = QUANTA_RUNNING;
+
+    // A pump is chosen per activation, not several at the same time
+    fpgaWriteParam(FPGA_ACC_SINGLY_CP_ACTIVATION_ADDR, 1);
+}
+
+void quanta_abort() {
+    if (state != QUANTA_RUNNING) {
+        return;
+    }
+    state = QUANTA_ABORTED;
+    fpgaUpdateAllParam();
+}
+
+enum QuantaState quanta_state() {
+    return state;
+}
+
+uint8_t quanta_phase() {
+    return phase;
+}
+
+double quanta_ratio(uint8_t pump) {
+    return ratios[pump];
+}
+
+const struct QuantaPhase* quanta_get_phase(uint8_t index) {
+    return &phases[index];
+}
+
+void quanta_task() {
+    struct rawDataFPGA frame;
+    while (fpgaFrameQueue.pop(FPGA_READER_QUANTA, frame)) {
+        if (state == QUANTA_RUNNING && phaseStarted) {
+            pushFrame(frame);
+        }
+    }
+
+    if (state != QUANTA_RUNNING || phaseStarted) {
+        return;
+    }
+    if (phase == QUANTA_PHASE_COUNT) {
+        finish();
+        return;
+    }
+
+    writePumps(phasePumps[phase]);
+    // The frames queued meanwhile were measured with the previous pumps
+    while (fpgaFrameQueue.pop(FPGA_READER_QUANTA, frame));
+    windows = 0;
+    phaseStarted = true;
+}
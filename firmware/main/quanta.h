@@ -0,0 +1,98 @@
+/**
+ * @file quanta.h
+ * @brief Measurement of the charge quanta of the pumps, relative to CP1.
+ *
+ * With a constant input current, the charge pumped per unit of time is the
+ * same whichever pumps are enabled: for each combination k of pumps,
+ * sum_i rate_ik * q_i = I, rate_ik being the activations of pump i per ms.
+ * The input is run against each pump alone and against each combination
+ * of them, with singlyCPActivation set, by writing the disable registers.
+ * The ratios q2/q1 and q3/q1 and I/q1 are then the least squares solution
+ * of these 7 equations.
+ *
+ * CP1 is the reference: its quantum is kept, those of CP2 and CP3 are set
+ * to it times their ratio in conf.acc and written to the FPGA. The absolute
+ * scale is left to the calibration gains.
+ */
+
+#ifndef QUANTA_H
+#define QUANTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define QUANTA_PUMP_COUNT 3
+#define QUANTA_PHASE_COUNT 7          // Combinations of the pumps
+#define QUANTA_SETTLE_WINDOWS 3       // Skipped after each change of the pumps
+#define QUANTA_MAX_WINDOWS 600        // Measured per combination at most
+#define QUANTA_DEFAULT_ACTIVATIONS 10000 // Measured per combination
+#define QUANTA_MAX_ACTIVATIONS 1000000
+#define QUANTA_MAX_VALUE 131071       // The quanta registers are signed 18-bit
+
+enum QuantaState {
+    QUANTA_IDLE,    //!< Never run
+    QUANTA_RUNNING,
+    QUANTA_DONE,    //!< The quanta were written
+    QUANTA_FAILED,  //!< A pump did not activate or the quanta are out of range
+    QUANTA_ABORTED
+};
+
+/**
+ * @brief Activations measured with a combination of pumps.
+ */
+struct QuantaPhase {
+    uint8_t pumps; //!< Enabled pumps, bit 0 for CP1
+    uint32_t counts[QUANTA_PUMP_COUNT];
+    uint32_t timeMs;
+};
+
+/**
+ * @brief Set the activations to measure per combination.
+ * @return False if out of 1..QUANTA_MAX_ACTIVATIONS.
+ *
+ * The relative resolution of a ratio is about one over it.
+ */
+bool quanta_set_activations(uint32_t activations);
+
+uint32_t quanta_get_activations();
+
+/**
+ * @brief Start the measurement, the input current must be constant until
+ * it is done.
+ *
+ * A running measurement is aborted and started over.
+ */
+void quanta_start();
+
+/**
+ * @brief Stop the measurement and write back the configured parameters.
+ */
+void quanta_abort();
+
+enum QuantaState quanta_state();
+
+/**
+ * @brief Combination being measured, QUANTA_PHASE_COUNT once solved.
+ */
+uint8_t quanta_phase();
+
+/**
+ * @brief Ratio of the quantum of a pump to the one of CP1, as last solved.
+ * @param pump 0 to 2.
+ */
+double quanta_ratio(uint8_t pump);
+
+/**
+ * @brief Activations of a combination, as last measured.
+ */
+const struct QuantaPhase* quanta_get_phase(uint8_t phase);
+
+/**
+ * @brief Measure the new frames and write the pumps of each combination.
+ *
+ * Drains FPGA_READER_QUANTA, also when no measurement is running.
+ */
+void quanta_task();
+
+#endif // QUANTA_H
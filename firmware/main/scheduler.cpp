@@ -0,0 +1,161 @@
+/**
+ * @file scheduler.cpp
+ * @brief Source file for the cooperative task scheduler.
+ */
+
+#include "scheduler.h"
+#include <string.h>
+
+static struct SchedTask tasks[SCHED_MAX_TASKS];
+static uint8_t taskCount = 0;
+static SchedClock clock = nullptr;
+
+
+/**
+ * @brief Run a task and account for its timing.
+ */
+static void runTask(struct SchedTask* task) {
+    uint32_t start = clock();
+    uint32_t release = task->releaseUs;
+    task->ready = false;
+
+    task->function();
+
+    uint32_t end = clock();
+    uint32_t latency = start - release;
+    uint32_t runTime = end - start;
+
+    task->stats.runs++;
+    if (latency > task->stats.maxLatencyUs) task->stats.maxLatencyUs = latency;
+    if (runTime > task->stats.maxRunUs) task->stats.maxRunUs = runTime;
+    if (task->deadlineUs != 0 && end - release > task->deadlineUs) {
+        task->stats.overruns++;
+    }
+}
+
+/**
+ * @brief Release the periodic tasks whose period elapsed.
+ *
+ * The releases keep their phase and a task is released from the time it
+ * should have been, so its latency includes any delay. The releases that
+ * passed meanwhile, or while the task was still ready from a previous one,
+ * are missed and each counts as an overrun: a late task is not run several
+ * times to catch up.
+ */
+static void releasePeriodic(uint32_t now) {
+    for (uint8_t i = 0; i < taskCount; i++) {
+        struct SchedTask* task = &tasks[i];
+        if (task->kind != SCHED_PERIODIC) continue;
+
+        uint32_t late = now - task->nextReleaseUs;
+        if ((int32_t)late < 0) continue;
+
+        // Releases passed after this one, a division only when late
+        uint32_t passed = late < task->periodUs ? 1 : late / task->periodUs + 1;
+        uint32_t missed = passed;
+        if (!task->ready) {
+            task->releaseUs = task->nextReleaseUs;
+            task->ready = true;
+            missed--;
+        }
+        task->stats.overruns += missed;
+        task->nextReleaseUs += passed * task->periodUs;
+    }
+}
+
+void sched_init(SchedClock schedClock) {
+    clock = schedClock;
+    taskCount = 0;
+    memset(tasks, 0, sizeof(tasks));
+}
+
+int8_t sched_add(const char* name, SchedFunction function, enum SchedKind kind,
+                 uint8_t priority, uint32_t periodUs, uint32_t deadlineUs) {
+    if (taskCount == SCHED_MAX_TASKS || function == nullptr || (kind == SCHED_PERIODIC && periodUs == 0)) {
+        return -1;
+    }
+
+    struct SchedTask* task = &tasks[taskCount];
+    memset(task, 0, sizeof(*task));
+    task->name = name;
+    task->function = function;
+    task->kind = kind;
+    task->priority = priority;
+    task->periodUs = periodUs;
+    task->deadlineUs = deadlineUs;
+    // Periodic tasks are released at the first pass
+    task->releaseUs = clock();
+    task->nextReleaseUs = task->releaseUs;
+
+    return taskCount++;
+}
+
+void sched_signal(int8_t id) {
+    if (id < 0 || id >= taskCount) return;
+
+    struct SchedTask* task = &tasks[id];
+    // The release time of a pending event is the first signal
+    if (!task->ready) {
+        task->releaseUs = clock();
+        task->ready = true;
+    }
+}
+
+bool sched_run() {
+    // Polled tasks first, in priority order
+    for (uint8_t priority = 0; ; priority++) {
+        bool higher = false;
+        for (uint8_t i = 0; i < taskCount; i++) {
+            struct SchedTask* task = &tasks[i];
+            if (task->kind != SCHED_POLL) continue;
+            if (task->priority == priority) {
+                task->releaseUs = clock();
+                runTask(task);
+            } else if (task->priority > priority) {
+                higher = true;
+            }
+        }
+        if (!higher) break;
+    }
+
+    uint32_t now = clock();
+    releasePeriodic(now);
+
+    // Most urgent ready task: highest priority, then earliest deadline
+    struct SchedTask* best = nullptr;
+    uint32_t bestSlack = 0;
+    for (uint8_t i = 0; i < taskCount; i++) {
+        struct SchedTask* task = &tasks[i];
+        if (task->kind == SCHED_POLL || !task->ready) continue;
+
+        uint32_t deadline = task->deadlineUs != 0 ? task->deadlineUs : UINT32_MAX / 2;
+        // Time left before the deadline, negative if already late
+        uint32_t slack = task->releaseUs + deadline - now;
+        if (best == nullptr || task->priority < best->priority
+            || (task->priority == best->priority && (int32_t)(slack - bestSlack) < 0)) {
+            best = task;
+            bestSlack = slack;
+        }
+    }
+
+    if (best == nullptr) {
+        return false;
+    }
+    runTask(best);
+    return true;
+}
+
+uint8_t sched_task_count() {
+    return taskCount;
+}
+
+const struct SchedTask* sched_get_task(int8_t id) {
+    if (id < 0 || id >= taskCount) return nullptr;
+    return &tasks[id];
+}
+
+void sched_reset_stats() {
+    for (uint8_t i = 0; i < taskCount; i++) {
+        memset(&tasks[i].stats, 0, sizeof(tasks[i].stats));
+    }
+}
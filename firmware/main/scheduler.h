@@ -0,0 +1,116 @@
+/**
+ * @file scheduler.h
+ * @brief Cooperative task scheduler for the main loop.
+ *
+ * Each pass of sched_run() first runs all the polled tasks, in priority order,
+ * then the single most urgent ready task: the one with the highest priority
+ * and, among equal priorities, the earliest deadline. The polled tasks (frame
+ * ingestion) therefore run between any two other tasks.
+ *
+ * A periodic task is released every period, an event task when signalled
+ * with sched_signal(), also from an interrupt. A task overruns when it
+ * completes later than its deadline after its release, or when a periodic
+ * release passes while the task waits or runs.
+ *
+ * The scheduler does not depend on the Arduino core: the time source is
+ * given to sched_init(), so that it can run against a simulated clock.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHED_MAX_TASKS 12
+
+/**
+ * @brief Time source, in microseconds, wrapping at 2^32.
+ */
+typedef uint32_t (*SchedClock)(void);
+
+typedef void (*SchedFunction)(void);
+
+/**
+ * @brief How a task is released.
+ */
+enum SchedKind {
+    SCHED_POLL,     //!< At every pass, before the other tasks
+    SCHED_PERIODIC, //!< Every periodUs
+    SCHED_EVENT     //!< When signalled
+};
+
+/**
+ * @brief Timing of a task.
+ */
+struct SchedStats {
+    uint32_t runs;         //!< Completed runs
+    uint32_t overruns;     //!< Runs completed after their deadline
+    uint32_t maxLatencyUs; //!< Longest time between release and start
+    uint32_t maxRunUs;     //!< Longest run
+};
+
+/**
+ * @brief A task, as registered with sched_add().
+ */
+struct SchedTask {
+    const char* name;
+    SchedFunction function;
+    enum SchedKind kind;
+    uint8_t priority;      //!< 0 is the highest
+    uint32_t periodUs;     //!< Release period of SCHED_PERIODIC tasks
+    uint32_t deadlineUs;   //!< Max time from release to completion, 0 for none
+    volatile bool ready;   //!< Released and not run yet
+    volatile uint32_t releaseUs;
+    uint32_t nextReleaseUs; //!< Next release of SCHED_PERIODIC tasks
+    struct SchedStats stats;
+};
+
+/**
+ * @brief Set the time source and remove all the tasks.
+ * @param clock Time source, micros() on the board.
+ */
+void sched_init(SchedClock clock);
+
+/**
+ * @brief Register a task.
+ * @param name Name shown in the statistics, must be a static string.
+ * @param function Task body, must return quickly.
+ * @param kind How the task is released.
+ * @param priority 0 is the highest.
+ * @param periodUs Release period, used by SCHED_PERIODIC only.
+ * @param deadlineUs Max time from release to completion, 0 for none.
+ * @return Task id, -1 if the task table is full.
+ */
+int8_t sched_add(const char* name, SchedFunction function, enum SchedKind kind,
+                 uint8_t priority, uint32_t periodUs, uint32_t deadlineUs);
+
+/**
+ * @brief Release an event task. Can be called from an interrupt.
+ * @param id Task id returned by sched_add().
+ */
+void sched_signal(int8_t id);
+
+/**
+ * @brief Run one pass: the polled tasks, then the most urgent ready task.
+ * @return True if a non polled task was run.
+ */
+bool sched_run();
+
+/**
+ * @brief Number of registered tasks.
+ */
+uint8_t sched_task_count();
+
+/**
+ * @brief Get a task, to read its statistics.
+ * @param id Task id, from 0 to sched_task_count() - 1.
+ */
+const struct SchedTask* sched_get_task(int8_t id);
+
+/**
+ * @brief Clear the statistics of all the tasks.
+ */
+void sched_reset_stats();
+
+#endif // SCHEDULER_H
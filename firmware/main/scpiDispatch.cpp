@@ -0,0 +1,151 @@
+/**
+ * @file scpiDispatch.cpp
+ * @brief Source file for the matching and splitting of the SCPI messages.
+ */
+
+#include "scpiDispatch.h"
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief Compare a header mnemonic with the first length characters of a
+ * pattern mnemonic, ignoring case.
+ * @param suffix True if digits may follow.
+ */
+static bool matchMnemonic(const char* mnemonic, uint8_t length, const char* token, uint8_t tokenLength, bool suffix) {
+    if (tokenLength < length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        if (scpiUpper(token[i]) != scpiUpper(mnemonic[i])) {
+            return false;
+        }
+    }
+    for (uint8_t i = length; i < tokenLength; i++) {
+        if (!suffix || token[i] < '0' || token[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool scpi_match(const char* pattern, const char* header) {
+    if (*header == ':') {
+        header++;
+    }
+
+    while (true) {
+        // Pattern mnemonic, its short form is the part not in lowercase
+        const char* mnemonic = pattern;
+        uint8_t longLength = 0;
+        while (pattern[longLength] != '\0' && pattern[longLength] != ':'
+               && pattern[longLength] != '?' && pattern[longLength] != '#') {
+            longLength++;
+        }
+        uint8_t shortLength = 0;
+        while (shortLength < longLength && !(mnemonic[shortLength] >= 'a' && mnemonic[shortLength] <= 'z')) {
+            shortLength++;
+        }
+        pattern += longLength;
+
+        bool query = false;
+        bool suffix = false;
+        while (*pattern == '?' || *pattern == '#') {
+            query |= *pattern == '?';
+            suffix |= *pattern == '#';
+            pattern++;
+        }
+
+        // Header mnemonic
+        const char* token = header;
+        uint8_t tokenLength = 0;
+        while (header[tokenLength] != '\0' && header[tokenLength] != ':') {
+            tokenLength++;
+        }
+        header += tokenLength;
+        bool tokenQuery = tokenLength > 0 && token[tokenLength - 1] == '?';
+        if (tokenQuery) {
+            tokenLength--;
+        }
+
+        if (tokenQuery != query) {
+            return false;
+        }
+        if (!matchMnemonic(mnemonic, longLength, token, tokenLength, suffix)
+            && !matchMnemonic(mnemonic, shortLength, token, tokenLength, suffix)) {
+            return false;
+        }
+
+        // Both at their end, or both followed by another mnemonic
+        if (*pattern == '\0' || *header == '\0') {
+            return *pattern == '\0' && *header == '\0';
+        }
+        pattern++;
+        header++;
+    }
+}
+
+char* scpi_split(char* message, SCPI_P& parameters) {
+    while (isBlank(*message)) {
+        message++;
+    }
+    char* header = message;
+    while (*message != '\0' && !isBlank(*message)) {
+        message++;
+    }
+    if (*message == '\0') {
+        return header;
+    }
+    *message++ = '\0';
+
+    while (true) {
+        while (isBlank(*message)) {
+            message++;
+        }
+        if (*message == '\0') {
+            break;
+        }
+
+        char* start = message;
+        while (*message != '\0' && *message != ',') {
+            message++;
+        }
+        char* end = message;
+        bool more = *message == ',';
+        if (more) {
+            *message++ = '\0';
+        }
+        while (end > start && isBlank(end[-1])) {
+            *--end = '\0';
+        }
+
+        parameters.Append(start);
+        if (!more) {
+            break;
+        }
+    }
+    return header;
+}
+
+void scpi_split_header(char* header, SCPI_C& commands) {
+    if (*header == ':') {
+        header++;
+    }
+    commands.Append(header);
+    for (; *header != '\0'; header++) {
+        if (*header == ':') {
+            *header = '\0';
+            commands.Append(header + 1);
+        }
+    }
+}
+
+void scpi_write_block_header(Stream& interface, uint32_t length) {
+    String digits = String(length);
+    interface.print("#");
+    interface.print(digits.length());
+    interface.print(digits);
+}
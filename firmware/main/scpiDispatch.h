@@ -0,0 +1,340 @@
+/**
+ * @file scpiDispatch.h
+ * @brief Compile-time perfect hash dispatch of the SCPI commands.
+ *
+ * The commands are a constexpr table of patterns, e.g. "SYSTem:ERRor:NEXT?",
+ * and handlers. The compiler turns it into a two-level perfect hash table,
+ * stored in flash with the patterns: nothing is registered at runtime and a
+ * lookup costs one hash of the header and one pattern comparison, whatever
+ * the number of commands.
+ *
+ * The key of a header is made of the first 3 characters of each mnemonic
+ * (4 for the common commands, "*IDN"), uppercased, the separators and the
+ * query mark. Both the short and the long form of a mnemonic give the same
+ * key, so the input does not need to be normalised. Two commands with the
+ * same key do not compile.
+ *
+ * In a pattern, the uppercase part of a mnemonic is its short form, and a
+ * '#' allows a numeric suffix on the input (e.g. "VOLTage2").
+ *
+ * The table is built as in the FKS scheme: the keys are spread over as many
+ * buckets as commands, then the k keys of each bucket are placed without
+ * collision in a sub-table of k^2 slots, using the first seed that works.
+ * Expected total size is below twice the number of commands.
+ */
+
+#ifndef SCPIDISPATCH_H
+#define SCPIDISPATCH_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#define SCPI_ARRAY_SIZE 4     // Max header tokens and max parameters
+#define SCPI_BUFFER_LENGTH 128 // Max message length, terminator excluded
+#define SCPI_TIMEOUT_MS 10    // Max gap between the characters of a message
+#define SCPI_MAX_SEED 200     // Seeds tried per bucket before giving up
+#define SCPI_NO_COMMAND 0xFF  // Empty slot
+
+/**
+ * @brief Tokens of a message, header mnemonics or parameters.
+ */
+class SCPI_String_Array {
+    private:
+        char* _values[SCPI_ARRAY_SIZE];
+        uint8_t _size;
+        bool _overflow; // A token did not fit
+
+    public:
+        SCPI_String_Array() : _size(0), _overflow(false) {}
+
+        // Add a token, false and flagged if the array is full
+        bool Append(char* value) {
+            if (_size == SCPI_ARRAY_SIZE) {
+                _overflow = true;
+                return false;
+            }
+            _values[_size++] = value;
+            return true;
+        }
+
+        // True if a token was dropped, the array is then incomplete
+        bool Overflow() {
+            return _overflow;
+        }
+
+        char* operator[](uint8_t index) {
+            return index < _size ? _values[index] : nullptr;
+        }
+
+        char* First() {
+            return operator[](0);
+        }
+
+        char* Last() {
+            return _size > 0 ? _values[_size - 1] : nullptr;
+        }
+
+        uint8_t Size() {
+            return _size;
+        }
+};
+
+typedef SCPI_String_Array SCPI_Commands;
+typedef SCPI_String_Array SCPI_Parameters;
+typedef SCPI_Commands SCPI_C;
+typedef SCPI_Parameters SCPI_P;
+typedef void (*SCPI_caller_t)(SCPI_C, SCPI_P, Stream&);
+
+/**
+ * @brief A command of the table.
+ */
+struct ScpiCommand {
+    const char* pattern;
+    SCPI_caller_t handler;
+};
+
+// ------------------------------------------------------------
+// -------------------- KEY AND HASHING -----------------------
+// ------------------------------------------------------------
+
+#define SCPI_FNV_BASIS 2166136261u
+#define SCPI_FNV_PRIME 16777619u
+
+constexpr char scpiUpper(char c) {
+    return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+constexpr uint32_t scpiHashStep(uint32_t hash, char c) {
+    return (hash ^ (uint8_t)c) * SCPI_FNV_PRIME;
+}
+
+constexpr uint8_t scpiKeyLimit(const char* token) {
+    return *token == '*' ? 4 : 3;
+}
+
+/**
+ * @brief Hash the key of a header or pattern, from its current character.
+ * @param taken Characters of the current mnemonic already hashed.
+ * @param limit Characters of a mnemonic part of the key.
+ */
+constexpr uint32_t scpiKeyFrom(const char* p, uint32_t hash, uint8_t taken, uint8_t limit) {
+    return *p == '\0' ? hash
+        : *p == ':' ? scpiKeyFrom(p + 1, scpiHashStep(hash, ':'), 0, scpiKeyLimit(p + 1))
+        : *p == '?' ? scpiKeyFrom(p + 1, scpiHashStep(hash, '?'), taken, limit)
+        : *p == '#' ? scpiKeyFrom(p + 1, hash, taken, limit)
+        : taken < limit ? scpiKeyFrom(p + 1, scpiHashStep(hash, scpiUpper(*p)), taken + 1, limit)
+        : scpiKeyFrom(p + 1, hash, taken, limit);
+}
+
+/**
+ * @brief Key hash of a header or pattern, the leading colon being optional.
+ */
+constexpr uint32_t scpiKey(const char* header) {
+    return *header == ':' ? scpiKey(header + 1) : scpiKeyFrom(header, SCPI_FNV_BASIS, 0, scpiKeyLimit(header));
+}
+
+constexpr uint32_t scpiXorShift(uint32_t hash, uint8_t shift) {
+    return hash ^ (hash >> shift);
+}
+
+/**
+ * @brief Mix a key with a seed, MurmurHash3 finaliser.
+ */
+constexpr uint32_t scpiMix(uint32_t key, uint32_t seed) {
+    return scpiXorShift(scpiXorShift(scpiXorShift(key ^ (seed * 0x9E3779B9u), 16) * 0x85EBCA6Bu, 13) * 0xC2B2AE35u, 16);
+}
+
+
+// ------------------------------------------------------------
+// ------------------ TABLE CONSTRUCTION ----------------------
+// ------------------------------------------------------------
+
+template <typename T, uint16_t N>
+struct ScpiArray {
+    T v[N];
+};
+
+template <uint16_t... I>
+struct ScpiIndices {};
+
+template <uint16_t N, uint16_t... I>
+struct ScpiMakeIndices : ScpiMakeIndices<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct ScpiMakeIndices<0, I...> {
+    typedef ScpiIndices<I...> type;
+};
+
+template <uint8_t N, uint16_t... I>
+constexpr ScpiArray<uint32_t, N> scpiBuildKeys(const ScpiCommand* c, ScpiIndices<I...>) {
+    return ScpiArray<uint32_t, N>{{scpiKey(c[I].pattern)...}};
+}
+
+template <uint8_t N, uint16_t... I>
+constexpr ScpiArray<uint8_t, N> scpiBuildBuckets(const uint32_t* key, ScpiIndices<I...>) {
+    return ScpiArray<uint8_t, N>{{(uint8_t)(scpiMix(key[I], 0) % N)...}};
+}
+
+constexpr uint8_t scpiCount(const uint8_t* bucket, uint8_t n, uint8_t b) {
+    return n == 0 ? 0 : (bucket[n - 1] == b) + scpiCount(bucket, n - 1, b);
+}
+
+template <uint8_t N, uint16_t... I>
+constexpr ScpiArray<uint8_t, N> scpiBuildCounts(const uint8_t* bucket, ScpiIndices<I...>) {
+    return ScpiArray<uint8_t, N>{{scpiCount(bucket, N, I)...}};
+}
+
+/**
+ * @brief First slot of a bucket, each bucket of k keys having k^2 slots.
+ */
+constexpr uint16_t scpiOffset(const uint8_t* count, uint8_t b) {
+    return b == 0 ? 0 : scpiOffset(count, b - 1) + count[b - 1] * count[b - 1];
+}
+
+template <uint8_t N, uint16_t... I>
+constexpr ScpiArray<uint16_t, N + 1> scpiBuildOffsets(const uint8_t* count, ScpiIndices<I...>) {
+    return ScpiArray<uint16_t, N + 1>{{scpiOffset(count, I)...}};
+}
+
+/**
+ * @brief Position of a key in the slots of its bucket.
+ */
+constexpr uint16_t scpiPosition(uint32_t key, uint8_t seed, uint8_t count) {
+    return scpiMix(key, seed + 1) % (count * count);
+}
+
+constexpr bool scpiCollidesWith(const uint32_t* key, const uint8_t* bucket, uint8_t n, uint8_t b, uint8_t count,
+                                uint8_t seed, uint8_t i, uint8_t j) {
+    return j >= n ? false
+        : (bucket[j] == b && scpiPosition(key[j], seed, count) == scpiPosition(key[i], seed, count))
+            || scpiCollidesWith(key, bucket, n, b, count, seed, i, j + 1);
+}
+
+constexpr bool scpiSeedCollides(const uint32_t* key, const uint8_t* bucket, uint8_t n, uint8_t b, uint8_t count,
+                                uint8_t seed, uint8_t i = 0) {
+    return i >= n ? false
+        : (bucket[i] == b && scpiCollidesWith(key, bucket, n, b, count, seed, i, i + 1))
+            || scpiSeedCollides(key, bucket, n, b, count, seed, i + 1);
+}
+
+/**
+ * @brief First seed placing the keys of a bucket without collision.
+ * @return SCPI_MAX_SEED if none, i.e. two commands have the same key.
+ */
+constexpr uint8_t scpiSeed(const uint32_t* key, const uint8_t* bucket, uint8_t n, uint8_t b, uint8_t count,
+                           uint8_t seed = 0) {
+    return count <= 1 ? 0
+        : seed == SCPI_MAX_SEED ? SCPI_MAX_SEED
+        : !scpiSeedCollides(key, bucket, n, b, count, seed) ? seed
+        : scpiSeed(key, bucket, n, b, count, seed + 1);
+}
+
+template <uint8_t N, uint16_t... I>
+constexpr ScpiArray<uint8_t, N> scpiBuildSeeds(const uint32_t* key, const uint8_t* bucket, const uint8_t* count,
+                                               ScpiIndices<I...>) {
+    return ScpiArray<uint8_t, N>{{scpiSeed(key, bucket, N, I, count[I])...}};
+}
+
+constexpr bool scpiSeedsFound(const uint8_t* seed, uint8_t n) {
+    return n == 0 ? true : seed[n - 1] != SCPI_MAX_SEED && scpiSeedsFound(seed, n - 1);
+}
+
+constexpr uint8_t scpiSlotCommand(const uint32_t* key, const uint8_t* bucket, const uint8_t* count,
+                                  const uint16_t* offset, const uint8_t* seed, uint8_t n, uint16_t s, uint8_t i = 0) {
+    return i == n ? SCPI_NO_COMMAND
+        : offset[bucket[i]] + scpiPosition(key[i], seed[bucket[i]], count[bucket[i]]) == s ? i
+        : scpiSlotCommand(key, bucket, count, offset, seed, n, s, i + 1);
+}
+
+template <uint16_t M, uint16_t... I>
+constexpr ScpiArray<uint8_t, M> scpiBuildSlots(const uint32_t* key, const uint8_t* bucket, const uint8_t* count,
+                                               const uint16_t* offset, const uint8_t* seed, uint8_t n,
+                                               ScpiIndices<I...>) {
+    return ScpiArray<uint8_t, M>{{scpiSlotCommand(key, bucket, count, offset, seed, n, I)...}};
+}
+
+
+// ------------------------------------------------------------
+// ------------------------ LOOKUP ----------------------------
+// ------------------------------------------------------------
+
+/**
+ * @brief Check a header against a pattern, short and long forms, suffixes.
+ */
+bool scpi_match(const char* pattern, const char* header);
+
+/**
+ * @brief Perfect hash of the table of N commands C.
+ *
+ * Each stage is computed once by the compiler, only seed, offset and slot
+ * are used at runtime.
+ */
+template <const ScpiCommand* C, uint8_t N>
+struct ScpiPerfectHash {
+    static_assert(N < SCPI_NO_COMMAND, "Too many SCPI commands");
+
+    typedef typename ScpiMakeIndices<N>::type Buckets;
+    static constexpr ScpiArray<uint32_t, N> key = scpiBuildKeys<N>(C, Buckets());
+    static constexpr ScpiArray<uint8_t, N> bucket = scpiBuildBuckets<N>(key.v, Buckets());
+    static constexpr ScpiArray<uint8_t, N> count = scpiBuildCounts<N>(bucket.v, Buckets());
+    static constexpr ScpiArray<uint16_t, N + 1> offset =
+        scpiBuildOffsets<N>(count.v, typename ScpiMakeIndices<N + 1>::type());
+    static constexpr uint16_t slotCount = offset.v[N];
+    static constexpr ScpiArray<uint8_t, N> seed = scpiBuildSeeds<N>(key.v, bucket.v, count.v, Buckets());
+    static constexpr ScpiArray<uint8_t, slotCount> slot =
+        scpiBuildSlots<slotCount>(key.v, bucket.v, count.v, offset.v, seed.v, N,
+                                  typename ScpiMakeIndices<slotCount>::type());
+
+    // False if two commands have the same key
+    static constexpr bool valid = scpiSeedsFound(seed.v, N);
+
+    /**
+     * @brief Find the command of a header.
+     * @return Its index, -1 if unknown.
+     */
+    static int16_t find(const char* header) {
+        uint32_t headerKey = scpiKey(header);
+        uint8_t headerBucket = scpiMix(headerKey, 0) % N;
+        uint16_t size = offset.v[headerBucket + 1] - offset.v[headerBucket];
+        if (size == 0) {
+            return -1;
+        }
+
+        uint8_t index = slot.v[offset.v[headerBucket] + scpiMix(headerKey, seed.v[headerBucket] + 1) % size];
+        if (index == SCPI_NO_COMMAND || !scpi_match(C[index].pattern, header)) {
+            return -1;
+        }
+        return index;
+    }
+};
+
+template <const ScpiCommand* C, uint8_t N>
+constexpr ScpiArray<uint32_t, N> ScpiPerfectHash<C, N>::key;
+template <const ScpiCommand* C, uint8_t N>
+constexpr ScpiArray<uint8_t, N> ScpiPerfectHash<C, N>::seed;
+template <const ScpiCommand* C, uint8_t N>
+constexpr ScpiArray<uint16_t, N + 1> ScpiPerfectHash<C, N>::offset;
+template <const ScpiCommand* C, uint8_t N>
+constexpr ScpiArray<uint8_t, ScpiPerfectHash<C, N>::slotCount> ScpiPerfectHash<C, N>::slot;
+
+/**
+ * @brief Split a message in header and parameters, in place.
+ * @param message The message, without terminator.
+ * @param parameters Filled with the comma separated parameters, trimmed.
+ * Beyond SCPI_ARRAY_SIZE they are dropped and parameters.Overflow() is set.
+ * @return The header.
+ */
+char* scpi_split(char* message, SCPI_P& parameters);
+
+/**
+ * @brief Split a matched header in its mnemonics, in place.
+ */
+void scpi_split_header(char* header, SCPI_C& commands);
+
+/**
+ * @brief Start an IEEE 488.2 definite length block, "#<digits><length>".
+ * @param length Number of data bytes that will follow.
+ */
+void scpi_write_block_header(Stream& interface, uint32_t length);
+
+#endif // SCPIDISPATCH_H
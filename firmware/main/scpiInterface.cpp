@@ -2,187 +2,1572 @@
 #include "scpiInterfaceCommandTree.h"
 #include "config.h"
 
-// For the error buffer
-#include "LIFObuf.h"
+// For the error queue
+#include "SPSCbuf.h"
 
 // For the update of the FPGA parameters
 #include "fpga.h"
 
+// For the host-to-device clock synchronisation
+#include "timeSync.h"
+#include "RTClib.h"
+
+// For the display statistics and control
+#include "ssd1306.h"
+#include "screen.h"
+
+// For the I2C bus statistics and clock
+#include "i2cBus.h"
+
+// For the independent current measurement
+#include "ltc2471.h"
+
+// For the board temperature and humidity
+#include "sht41.h"
+
+// For the main loop task statistics
+#include "scheduler.h"
+
+// For the timing probes
+#include "perf.h"
+
+// For the frame capture
+#include "trace.h"
+
+// For the trigger engine
+#include "trigger.h"
+
+// For the running statistics
+#include "stats.h"
+
+// For the current estimator
+#include "estimator.h"
+
+// For the filter stage
+#include "filter.h"
+
+// For the calibration
+#include "calibration.h"
+
+// For the DAC sweep
+#include "sweep.h"
+
+// For the charge quanta measurement
+#include "quanta.h"
+
+// For the history of the current
+#include "history.h"
+
+// For the charge integrator
+#include "integrator.h"
+
 static void Identify(SCPI_C commands, SCPI_P parameters, Stream& interface);
 static void Reset(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void SerialErrorHandler(SCPI_C commands, SCPI_P parameters, Stream& interface);
 static void GetLastError(SCPI_C commands, SCPI_P parameters, Stream& interface);
 static void GetErrorSize(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void ClearStatus(SCPI_C commands, SCPI_P parameters, Stream& interface);
 static void SCPIversion(SCPI_C commands, SCPI_P parameters, Stream& interface);
 
-static void dacSetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void dacGetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void timeGet(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void timeProbe(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void timeSync(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void timeGetSync(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displayGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void i2cGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void schedulerGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void schedulerReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void perfGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void perfReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void framesGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void operationGetCondition(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void traceSetPoints(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void traceGetPoints(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void traceGetActualPoints(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void traceGetData(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void traceInitiate(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void traceAbort(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void triggerSetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetSource(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetSource(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetType(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetType(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetSlope(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetSlope(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetLevel(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetLevel(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetWindow(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetWindow(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerSetSegment(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetSegment(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetEvent(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void triggerGetEventCount(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void statsGetSummary(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void statsGetAllan(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void statsReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void estimatorSet(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void estimatorGet(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void historyGetInfo(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void historyGetData(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void integratorStart(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void integratorStop(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void integratorReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void integratorGetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void filterSetType(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterGetType(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterSetLength(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterGetLength(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterSetTimeConstant(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterGetTimeConstant(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterSetOutput(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void filterGetOutput(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void calibrationSetGain(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetGain(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationSetOffset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetOffset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationSetPump(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetPump(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationSetTemperature(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetTemperature(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetData(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationSave(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationLoad(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationDefault(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaStart(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaAbort(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaSetActivations(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaGetActivations(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaGetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void quantaGetData(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void sweepSetChannel(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepGetChannel(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepSetRange(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepGetRange(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepSetWindows(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepGetWindows(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepStart(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepAbort(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepGetProgress(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sweepGetData(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void dacSetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void dacGetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void displaySetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displayGetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displaySetRate(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displayGetRate(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displaySetAverage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void displayGetAverage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void i2cSetClock(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void i2cGetClock(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void adcSetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void adcGetState(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void adcGetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void adcGetCurrent(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void sht41Get(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void serialSetStream(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void serialGetStream(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void serialSetRaw(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void serialGetRaw(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void serialSetIntegral(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void serialGetIntegral(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void accurateSetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetCooldown(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetCooldown(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetTCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetTCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetTInjection(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetTInjection(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetDisableCP(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetDisableCP(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetSingly(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetSingly(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateSetPeriod(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void accurateGetPeriod(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+static void printHelp(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void DoNothing(SCPI_C commands, SCPI_P parameters, Stream& interface);
+
+void addErrorToBuffer(enum ScpiError error);
+bool checkNumberParameters(SCPI_P parameters, uint8_t number);
+static void printInt64(Stream& interface, int64_t value);
+static void printUint64(Stream& interface, uint64_t value);
+
+// RTC object, defined in the main file
+extern RTC_PCF8523 rtc;
+
+/**
+ * @brief After the function is executed, all the parameters are updated in the FPGA
+ * @param func The function to be executed before updating the FPGA parameters
+ */
+template <SCPI_caller_t func>
+static void paramUpdate(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    func(commands, parameters, interface);
+    // The sweep steps or the quanta would not be measured with the same parameters
+    sweep_abort();
+    quanta_abort();
+    fpgaUpdateAllParam();
+}
+#define PARAM_UPDATE(func) &paramUpdate<&func>
+
+
+/**
+ * @brief Code and message of each error, indexed by ScpiError
+ */
+static const struct {
+    int16_t code;
+    const char* message;
+} errorTable[SCPI_ERR_COUNT] = {
+    {0, "No Error"},
+    {-100, "Buffer overflow error"},
+    {-100, "Communication timeout error"},
+    {-100, "Command not implemented"},
+    {-102, "Unknown command received"},
+    {-108, "Parameter not allowed"},
+    {-109, "Missing parameter"},
+    {-222, "Data out of range"},
+    {-230, "Data corrupt or stale"},
+    {-240, "Hardware error"},
+    {-350, "Queue overflow"}
+};
+
+/**
+ * @brief An error in the queue
+ */
+struct ErrorRecord {
+    uint8_t error;   // ScpiError
+    uint8_t command; // Slot in scpiCommands of the command raising it
+    uint32_t timeMs; // millis() when raised
+};
+
+// Slot of the command being executed, SCPI_NO_COMMAND outside of one
+static uint8_t currentCommand = SCPI_NO_COMMAND;
+
+/**
+ * @brief Error queue, implemented as a static FIFO buffer
+ * 
+ * All the errors generated by the SCPI parser AND the commands are stored in
+ * this queue and read back oldest first. When only one entry is left, it is
+ * taken by a "-350, Queue overflow" error and the following errors are lost,
+ * until some are read.
+*/
+static SPSCbuf<struct ErrorRecord, ERROR_QUEUE_SIZE> errorQueue;
+
+// Local time at which the first byte of the message being executed was read,
+// the reception stamp of SYSTem:TIME:PROBe?
+static uint64_t messageArrivalUs = 0;
+
+/**
+ * @brief Command table, stored in flash with its perfect hash
+ *
+ * Each pattern is the full command path, the uppercase part of a mnemonic
+ * being its short form. A '#' allows a numeric suffix.
+ */
+static constexpr struct ScpiCommand scpiCommands[] = {
+    // ---------------- Not implemented commands ----------------
+    // STATus:OPERation
+    {"STATus:OPERation:ENABle", &DoNothing},
+    {"STATus:OPERation:EVENt?", &DoNothing},
+
+    // STATus:QUEStionable
+    {"STATus:QUEStionable:CONDition?", &DoNothing},
+    {"STATus:QUEStionable:ENABle", &DoNothing},
+    {"STATus:QUEStionable:EVENt?", &DoNothing},
+
+    // STATus
+    {"STATus:OPERation?", &DoNothing},
+    {"STATus:QUEStionable?", &DoNothing},
+    {"STATus:PRESet", &DoNothing},
+
+    // IEEE mandated commands
+    {"*CLS", &ClearStatus},
+    {"*ESE", &DoNothing},
+    {"*ESE?", &DoNothing},
+    {"*ESR", &DoNothing},
+    {"*OPC", &DoNothing},
+    {"*OPC?", &DoNothing},
+    {"*SRE", &DoNothing},
+    {"*SRE?", &DoNothing},
+    {"*STB", &DoNothing},
+    {"*TST?", &DoNothing},
+    {"*WAI", &DoNothing},
+
+    // ---------------- Implemented commands ----------------
+    // SYSTem
+    {"SYSTem:ERRor?", &GetLastError},
+    {"SYSTem:ERRor:NEXT?", &GetLastError},
+    {"SYSTem:ERRor:COUNt?", &GetErrorSize},
+    {"SYSTem:VERSion?", &SCPIversion},
+    {"SYSTem:TIME?", &timeGet},
+    {"SYSTem:TIME:PROBe?#", &timeProbe},
+    {"SYSTem:TIME:SYNC#", &timeSync},
+    {"SYSTem:TIME:SYNC?", &timeGetSync},
+    {"SYSTem:DISPlay:STATistics?", &displayGetStatistics},
+    {"SYSTem:I2C:STATistics?", &i2cGetStatistics},
+    {"SYSTem:SCHEDuler?", &schedulerGetStatistics},
+    {"SYSTem:SCHEDuler:RESet", &schedulerReset},
+    {"SYSTem:PERFormance?", &perfGetStatistics},
+    {"SYSTem:PERFormance:RESet", &perfReset},
+    {"SYSTem:FRAMes?", &framesGetStatistics},
+
+    // STATus
+    {"STATus:OPERation:CONDition?", &operationGetCondition},
+
+    // TRACe, INITiate and ABORt
+    {"TRACe:POINts", &traceSetPoints},
+    {"TRACe:POINts?", &traceGetPoints},
+    {"TRACe:POINts:ACTual?", &traceGetActualPoints},
+    {"TRACe:DATA?", &traceGetData},
+    {"INITiate", &traceInitiate},
+    {"ABORt", &traceAbort},
+
+    // TRIGger
+    {"TRIGger:STATE", &triggerSetState},
+    {"TRIGger:STATE?", &triggerGetState},
+    {"TRIGger:SOURce", &triggerSetSource},
+    {"TRIGger:SOURce?", &triggerGetSource},
+    {"TRIGger:TYPE", &triggerSetType},
+    {"TRIGger:TYPE?", &triggerGetType},
+    {"TRIGger:SLOPe", &triggerSetSlope},
+    {"TRIGger:SLOPe?", &triggerGetSlope},
+    {"TRIGger:LEVel", &triggerSetLevel},
+    {"TRIGger:LEVel?", &triggerGetLevel},
+    {"TRIGger:WINDow", &triggerSetWindow},
+    {"TRIGger:WINDow?", &triggerGetWindow},
+    {"TRIGger:SEGMent", &triggerSetSegment},
+    {"TRIGger:SEGMent?", &triggerGetSegment},
+    {"TRIGger:EVENt?", &triggerGetEvent},
+    {"TRIGger:EVENt:COUNt?", &triggerGetEventCount},
+
+    // CALCulate
+    {"CALCulate:STATistics?", &statsGetSummary},
+    {"CALCulate:ALLan?", &statsGetAllan},
+    {"CALCulate:RESet", &statsReset},
+    {"CALCulate:ESTimator", &estimatorSet},
+    {"CALCulate:ESTimator?", &estimatorGet},
+
+    // HISTory
+    {"HISTory:INFO?", &historyGetInfo},
+    {"HISTory:DATA?", &historyGetData},
+
+    // INTegrator
+    {"INTegrator:STARt", &integratorStart},
+    {"INTegrator:STOP", &integratorStop},
+    {"INTegrator:RESet", &integratorReset},
+    {"INTegrator:CHARge?", &integratorGetCharge},
+    // FILTer
+    {"FILTer:TYPE", &filterSetType},
+    {"FILTer:TYPE?", &filterGetType},
+    {"FILTer:LENGth", &filterSetLength},
+    {"FILTer:LENGth?", &filterGetLength},
+    {"FILTer:TCONstant", &filterSetTimeConstant},
+    {"FILTer:TCONstant?", &filterGetTimeConstant},
+    {"FILTer:OUTPut", &filterSetOutput},
+    {"FILTer:OUTPut?", &filterGetOutput},
+    // CALibration
+    {"CALibration:GAIN", &calibrationSetGain},
+    {"CALibration:GAIN?", &calibrationGetGain},
+    {"CALibration:OFFSet", &calibrationSetOffset},
+    {"CALibration:OFFSet?", &calibrationGetOffset},
+    {"CALibration:PUMP", &calibrationSetPump},
+    {"CALibration:PUMP?", &calibrationGetPump},
+    {"CALibration:TEMPerature", &calibrationSetTemperature},
+    {"CALibration:TEMPerature?", &calibrationGetTemperature},
+    {"CALibration:DATA?", &calibrationGetData},
+    {"CALibration:SAVE", &calibrationSave},
+    {"CALibration:LOAD", &calibrationLoad},
+    {"CALibration:DEFault", &calibrationDefault},
+    {"CALibration:QUANta:STARt", &quantaStart},
+    {"CALibration:QUANta:ABORt", &quantaAbort},
+    {"CALibration:QUANta:ACTivations", &quantaSetActivations},
+    {"CALibration:QUANta:ACTivations?", &quantaGetActivations},
+    {"CALibration:QUANta?", &quantaGetState},
+    {"CALibration:QUANta:DATA?", &quantaGetData},
+
+    // SWEep
+    {"SWEep:CHANnel", &sweepSetChannel},
+    {"SWEep:CHANnel?", &sweepGetChannel},
+    {"SWEep:RANGe", &sweepSetRange},
+    {"SWEep:RANGe?", &sweepGetRange},
+    {"SWEep:WINDows", &sweepSetWindows},
+    {"SWEep:WINDows?", &sweepGetWindows},
+    {"SWEep:STARt", &sweepStart},
+    {"SWEep:ABORt", &sweepAbort},
+    {"SWEep:PROGress?", &sweepGetProgress},
+    {"SWEep:DATA?", &sweepGetData},
+
+    // CONFigure:DAC
+    {"CONFigure:DAC:VOLTage#", PARAM_UPDATE(dacSetVoltage)},
+    {"CONFigure:DAC:VOLTage?", &dacGetVoltage},
+
+    // CONFigure:ACCUrate
+    {"CONFigure:ACCUrate:CHARGE#", PARAM_UPDATE(accurateSetCharge)},
+    {"CONFigure:ACCUrate:CHARGE?#", &accurateGetCharge},
+    {"CONFigure:ACCUrate:COOLdown#", PARAM_UPDATE(accurateSetCooldown)},
+    {"CONFigure:ACCUrate:COOLdown?#", &accurateGetCooldown},
+    {"CONFigure:ACCUrate:RESET#", PARAM_UPDATE(accurateSetReset)},
+    {"CONFigure:ACCUrate:RESET?", &accurateGetReset},
+    {"CONFigure:ACCUrate:TCHARGE#", PARAM_UPDATE(accurateSetTCharge)},
+    {"CONFigure:ACCUrate:TCHARGE?", &accurateGetTCharge},
+    {"CONFigure:ACCUrate:TINJection#", PARAM_UPDATE(accurateSetTInjection)},
+    {"CONFigure:ACCUrate:TINJection?", &accurateGetTInjection},
+    {"CONFigure:ACCUrate:DISABLE#", PARAM_UPDATE(accurateSetDisableCP)},
+    {"CONFigure:ACCUrate:DISABLE?#", &accurateGetDisableCP},
+    {"CONFigure:ACCUrate:SINGLY#", PARAM_UPDATE(accurateSetSingly)},
+    {"CONFigure:ACCUrate:SINGLY?", &accurateGetSingly},
+    {"CONFigure:ACCUrate:PERiod#", PARAM_UPDATE(accurateSetPeriod)},
+    {"CONFigure:ACCUrate:PERiod?", &accurateGetPeriod},
+
+    // CONFigure:SERIal
+    {"CONFigure:SERIal:STREAM#", &serialSetStream},
+    {"CONFigure:SERIal:STREAM?", &serialGetStream},
+    {"CONFigure:SERIal:RAW#", &serialSetRaw},
+    {"CONFigure:SERIal:RAW?", &serialGetRaw},
+    {"CONFigure:SERIal:INTegral#", &serialSetIntegral},
+    {"CONFigure:SERIal:INTegral?", &serialGetIntegral},
+
+    // CONFigure:DISPlay
+    {"CONFigure:DISPlay:STATE#", &displaySetState},
+    {"CONFigure:DISPlay:STATE?", &displayGetState},
+    {"CONFigure:DISPlay:RATE#", &displaySetRate},
+    {"CONFigure:DISPlay:RATE?", &displayGetRate},
+    {"CONFigure:DISPlay:AVERage#", &displaySetAverage},
+    {"CONFigure:DISPlay:AVERage?", &displayGetAverage},
+
+    // CONFigure:I2C
+    {"CONFigure:I2C:CLOCk#", &i2cSetClock},
+    {"CONFigure:I2C:CLOCk?", &i2cGetClock},
+
+    // CONFigure:ADC
+    {"CONFigure:ADC:STATE#", &adcSetState},
+    {"CONFigure:ADC:STATE?", &adcGetState},
+
+    // MEASure:ADC
+    {"MEASure:ADC:VOLTage?", &adcGetVoltage},
+    {"MEASure:ADC:CURRent?", &adcGetCurrent},
+
+    // MEASure:SHT41
+    {"MEASure:SHT41?", &sht41Get},
+
+    // Identification, reset and help
+    {"*IDN?", &Identify},
+    {"*RST", &Reset},
+    {"HELP?", &printHelp}
+};
+
+static constexpr uint8_t SCPI_COMMAND_COUNT = sizeof(scpiCommands) / sizeof(scpiCommands[0]);
+typedef ScpiPerfectHash<scpiCommands, SCPI_COMMAND_COUNT> ScpiHash;
+static_assert(ScpiHash::valid, "Two SCPI commands have the same key: first 3 characters of each mnemonic and query mark");
+static_assert(sizeof(scpiCommands) / sizeof(scpiCommands[0]) < SCPI_NO_COMMAND, "The command slots must fit in an error record");
+
+/**
+ * @brief Execute a complete message
+ * @param message The message, without terminator, modified in place
+ * @param interface The stream to answer to
+ */
+static void executeMessage(char* message, Stream& interface) {
+    SCPI_P parameters;
+    char* header = scpi_split(message, parameters);
+    if (*header == '\0') {
+        return;
+    }
+
+    int16_t index = ScpiHash::find(header);
+    if (index < 0) {
+        addErrorToBuffer(SCPI_ERR_UNKNOWN_COMMAND);
+        return;
+    }
+    // No command takes that many, do not run one on a truncated list
+    if (parameters.Overflow()) {
+        currentCommand = index;
+        addErrorToBuffer(SCPI_ERR_PARAM_NOT_ALLOWED);
+        currentCommand = SCPI_NO_COMMAND;
+        return;
+    }
+
+    SCPI_C commands;
+    scpi_split_header(header, commands);
+    currentCommand = index;
+    scpiCommands[index].handler(commands, parameters, interface);
+    currentCommand = SCPI_NO_COMMAND;
+}
+
+void process_scpiInterface(Stream& interface) {
+    static char message[SCPI_BUFFER_LENGTH + 1];
+    static uint8_t length = 0;
+    static bool overflow = false;
+    static uint32_t lastCharMs = 0;
+
+    // A message must arrive in one go, drop what is left of an interrupted one
+    if ((length > 0 || overflow) && millis() - lastCharMs > SCPI_TIMEOUT_MS) {
+        addErrorToBuffer(SCPI_ERR_TIMEOUT);
+        length = 0;
+        overflow = false;
+    }
+
+    // The bytes of a message are stamped when first seen, before parsing
+    uint64_t arrivalUs = timesync_local_us();
+    while (interface.available()) {
+        char c = interface.read();
+        lastCharMs = millis();
+        if (length == 0 && !overflow) {
+            messageArrivalUs = arrivalUs;
+        }
+
+        if (c == '\n') {
+            if (overflow) {
+                addErrorToBuffer(SCPI_ERR_BUFFER_OVERFLOW);
+            } else {
+                message[length] = '\0';
+                executeMessage(message, interface);
+            }
+            length = 0;
+            overflow = false;
+        } else if (c == '\r') {
+            continue;
+        } else if (length < SCPI_BUFFER_LENGTH) {
+            message[length++] = c;
+        } else {
+            // The rest of the message is discarded up to its terminator
+            overflow = true;
+        }
+    }
+}
+
+
+// -------------------------------------------------------------------
+// ---------------- Functions of implemented commands ----------------
+// -------------------------------------------------------------------
+
+static void Identify(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    String outMessage = "CERN, REV1, ";
+    for (uint8_t i = 0; i < 4; i++) {
+        outMessage += String(( *(conf.UUID+i) ), HEX);
+    }
+    outMessage += ", 1.4.0";
+    interface.println(outMessage);
+}
+
+static void Reset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    delay(1000);
+    /*
+    CMSIS (Cortex Microcontroller Software Interface Standard) function
+    Set the SYSRESETREQ in the NVIC (Nested Vectored Interrupt Controller),
+    causing the MCU to reset.
+    */
+    NVIC_SystemReset();
+}
+
+static void GetLastError(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <code>, <message>; <time(ms)>; <command>
+    struct ErrorRecord record;
+    if (errorQueue.pop(record) == false) {
+        interface.println("0, No Error");
+        return;
+    }
+    interface.print(errorTable[record.error].code);
+    interface.print(", ");
+    interface.print(errorTable[record.error].message);
+    interface.print("; ");
+    interface.print(record.timeMs);
+    interface.print("; ");
+    // The pattern of the command, without the '#' of its numeric suffix
+    if (record.command != SCPI_NO_COMMAND) {
+        for (const char* c = scpiCommands[record.command].pattern; *c != '\0'; c++) {
+            if (*c != '#') {
+                interface.print(*c);
+            }
+        }
+    }
+    interface.println();
+}
+
+static void GetErrorSize(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(errorQueue.size());
+}
+
+static void ClearStatus(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    errorQueue.clear();
+}
+
+static void SCPIversion(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println("NOT SCPI COMPLIANT");
+}
+
+static void timeGet(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    printUint64(interface, timesync_now_us());
+    interface.println();
+}
+
+static void timeProbe(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    // The host stamp is not needed here, it comes back with SYNC
+    printUint64(interface, messageArrivalUs);
+    interface.print(",");
+    printUint64(interface, timesync_local_us());
+    interface.println();
+}
+
+static void timeSync(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 4) == false) return;
+
+    uint64_t t[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        t[i] = strtoull(parameters[i], nullptr, 10);
+    }
+
+    struct TimeSyncStatus status;
+    timesync_get_status(&status);
+    bool firstSync = !status.synced;
+
+    if (timesync_add_exchange(t[0], t[1], t[2], t[3]) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+
+    // Host time is Unix epoch based, use it instead of the compile time
+    if (firstSync) {
+        i2cbus_wait_idle();
+        rtc.adjust(DateTime((uint32_t)(timesync_now_us() / 1000000)));
+    }
+}
+
+static void timeGetSync(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    struct TimeSyncStatus status;
+    timesync_get_status(&status);
+
+    // <synced>,<offset(us)>,<drift(ppb)>,<delay(us)>,<residual(us)>,<samples>
+    interface.print(status.synced);
+    interface.print(",");
+    printInt64(interface, status.offsetUs);
+    interface.print(",");
+    interface.print(status.driftPpb);
+    interface.print(",");
+    interface.print(status.delayUs);
+    interface.print(",");
+    interface.print(status.residualUs);
+    interface.print(",");
+    interface.println(status.samples);
+}
+
+static void displayGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    const struct Ssd1306Stats* stats = ssd1306_get_stats();
+
+    // <updates>,<lastBytes>,<lastTime(us)>,<maxTime(us)>,<totalBytes>
+    interface.print(stats->updates);
+    interface.print(",");
+    interface.print(stats->lastBytes);
+    interface.print(",");
+    interface.print(stats->lastUs);
+    interface.print(",");
+    interface.print(stats->maxUs);
+    interface.print(",");
+    interface.println(stats->totalBytes);
+}
+
+static void i2cGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    uint8_t count;
+    const struct I2cDeviceStats* stats = i2cbus_get_stats(&count);
+
+    // <address>,<transactions>,<errors>,<bytes>,<busTime(us)>,<maxTime(us)> per device, separated by ';'
+    for (uint8_t i = 0; i < count; i++) {
+        if (i > 0) {
+            interface.print(";");
+        }
+        interface.print("0x");
+        interface.print(stats[i].address, HEX);
+        interface.print(",");
+        interface.print(stats[i].transactions);
+        interface.print(",");
+        interface.print(stats[i].errors);
+        interface.print(",");
+        interface.print(stats[i].bytes);
+        interface.print(",");
+        interface.print(stats[i].busyUs);
+        interface.print(",");
+        interface.print(stats[i].maxUs);
+    }
+    interface.println();
+}
+
+static void schedulerGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <name>,<runs>,<overruns>,<maxLatency(us)>,<maxRun(us)> per task, separated by ';'
+    for (uint8_t i = 0; i < sched_task_count(); i++) {
+        const struct SchedTask* task = sched_get_task(i);
+        if (i > 0) {
+            interface.print(";");
+        }
+        interface.print(task->name);
+        interface.print(",");
+        interface.print(task->stats.runs);
+        interface.print(",");
+        interface.print(task->stats.overruns);
+        interface.print(",");
+        interface.print(task->stats.maxLatencyUs);
+        interface.print(",");
+        interface.print(task->stats.maxRunUs);
+    }
+    interface.println();
+}
+
+static void schedulerReset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    sched_reset_stats();
+}
+
+static void perfGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <name>,<count>,<min>,<mean>,<max>,<bin 0>,...,<bin 23> per probe, in
+    // cycles of the 48 MHz clock, separated by ';'
+    for (uint8_t i = 0; i < PERF_PROBE_COUNT; i++) {
+        const struct PerfStats* stats = perf_get((enum PerfProbe)i);
+        uint32_t mean = stats->count > 0 ? stats->totalCycles / stats->count : 0;
+        if (i > 0) {
+            interface.print(";");
+        }
+        interface.print(perf_name((enum PerfProbe)i));
+        interface.print(",");
+        interface.print(stats->count);
+        interface.print(",");
+        interface.print(stats->minCycles);
+        interface.print(",");
+        interface.print(mean);
+        interface.print(",");
+        interface.print(stats->maxCycles);
+        for (uint8_t bin = 0; bin < PERF_HIST_BINS; bin++) {
+            interface.print(",");
+            interface.print(stats->histogram[bin]);
+        }
+    }
+    interface.println();
+}
+
+static void perfReset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    perf_reset();
+}
+
+static void framesGetStatistics(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <unread stream>,<unread log>,<unread display>,<unread trigger>,
+    // <unread statistics>,<unread history>,<unread integrator>,<unread sweep>,
+    // <unread quanta>,<highWater>,<dropped>, in the order of the readers
+    for (uint8_t reader = 0; reader < FPGA_READER_COUNT; reader++) {
+        interface.print(fpgaFrameQueue.size(reader));
+        interface.print(",");
+    }
+    interface.print(fpgaFrameQueue.highWater());
+    interface.print(",");
+    interface.println(fpgaFrameQueue.dropped());
+}
+
+static void operationGetCondition(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    uint16_t condition = 0;
+    if (trace_running()) {
+        condition |= STAT_OPER_MEASURING;
+    }
+    if (trigger_waiting()) {
+        condition |= STAT_OPER_WAITING_TRIGGER;
+    }
+    if (sweep_running()) {
+        condition |= STAT_OPER_SWEEPING;
+    }
+    if (quanta_state() == QUANTA_RUNNING) {
+        condition |= STAT_OPER_CALIBRATING;
+    }
+    interface.println(condition);
+}
+
+static void traceSetPoints(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long points = atol(parameters.First());
+    if (points < 1 || points > TRACE_MAX_POINTS) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+    trace_set_points(points);
+}
+
+static void traceGetPoints(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(trace_get_points());
+}
+
+static void traceGetActualPoints(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(trace_count());
+}
+
+static void traceGetData(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    trace_write_block(interface);
+}
+
+static void traceInitiate(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    trace_initiate();
+}
+
+static void traceAbort(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    trace_abort();
+}
+
+static const char* triggerSourceNames[] = {"CURRent", "CP1", "CP2", "CP3"};
+static const char* triggerTypeNames[] = {"EDGE", "SLOPe", "WINDow"};
+
+/**
+ * @brief Index of a keyword parameter, in its short or long form
+ * @return -1 if it is none of the names
+ */
+static int8_t findKeyword(const char* parameter, const char* const* names, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (scpi_match(names[i], parameter)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void triggerSetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    String first_parameter = String(parameters.First());
+    first_parameter.toUpperCase();
+
+    if (first_parameter == "ON") {
+        trigger_enable(true);
+    } else if (first_parameter == "OFF") {
+        trigger_enable(false);
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void triggerGetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(trigger_enabled());
+}
+
+static void triggerSetSource(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t source = findKeyword(parameters.First(), triggerSourceNames, 4);
+    if (source < 0) {
+        interface.println("Invalid parameter");
+        return;
+    }
+    trigger_set_source((enum TriggerSource)source);
+}
+
+static void triggerGetSource(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(triggerSourceNames[trigger_get_source()]);
+}
+
+static void triggerSetType(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t type = findKeyword(parameters.First(), triggerTypeNames, 3);
+    if (type < 0) {
+        interface.println("Invalid parameter");
+        return;
+    }
+    trigger_set_type((enum TriggerType)type);
+}
+
+static void triggerGetType(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(triggerTypeNames[trigger_get_type()]);
+}
+
+static void triggerSetSlope(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    if (scpi_match("POSitive", parameters.First())) {
+        trigger_set_slope(true);
+    } else if (scpi_match("NEGative", parameters.First())) {
+        trigger_set_slope(false);
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void triggerGetSlope(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(trigger_get_slope() ? "POSitive" : "NEGative");
+}
+
+static void triggerSetLevel(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+    trigger_set_level(atof(parameters.First()));
+}
+
+static void triggerGetLevel(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(trigger_get_level());
+}
+
+static void triggerSetWindow(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    if (!trigger_set_window(atof(parameters.First()), atof(parameters.Last()))) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+    }
+}
+
+static void triggerGetWindow(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    float low, high;
+    trigger_get_window(&low, &high);
+    interface.print(low);
+    interface.print(",");
+    interface.println(high);
+}
+
+static void triggerSetSegment(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    long pre = atol(parameters.First());
+    long post = atol(parameters.Last());
+    if (pre < 0 || post < 0 || pre + 1 + post > TRIGGER_SEGMENT_MAX) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+    trigger_set_segment(pre, post);
+}
+
+static void triggerGetSegment(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    uint8_t pre, post;
+    trigger_get_segment(&pre, &post);
+    interface.print(pre);
+    interface.print(",");
+    interface.println(post);
+}
+
+static void triggerGetEvent(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <samples>,<trigger index>;<timestamp(us)>,<current(fA)>,<cp1>,<cp2>,<cp3>;...
+    const struct TriggerEvent* event = trigger_peek_event();
+    if (event == NULL) {
+        interface.println("0,0");
+        return;
+    }
+
+    interface.print(event->count);
+    interface.print(",");
+    interface.print(event->trigger);
+    for (uint8_t i = 0; i < event->count; i++) {
+        const struct TriggerSample* sample = &event->samples[i];
+        interface.print(";");
+        printUint64(interface, sample->timestamp);
+        interface.print(",");
+        interface.print(sample->current);
+        for (uint8_t cp = 0; cp < 3; cp++) {
+            interface.print(",");
+            interface.print(sample->cpCount[cp]);
+        }
+    }
+    interface.println();
+    trigger_pop_event();
+}
+
+static void triggerGetEventCount(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <queued>,<dropped>
+    interface.print(trigger_event_count());
+    interface.print(",");
+    interface.println(trigger_dropped());
+}
+
+static void statsGetSummary(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <count>,<mean(fA)>,<stdDev(fA)>,<min(fA)>,<max(fA)>
+    struct StatsSummary summary;
+    stats_get_summary(&summary);
+    interface.print(summary.count);
+    interface.print(",");
+    interface.print(summary.mean, 3);
+    interface.print(",");
+    interface.print(summary.stdDev, 3);
+    interface.print(",");
+    interface.print(summary.min, 3);
+    interface.print(",");
+    interface.println(summary.max, 3);
+}
+
+static void statsGetAllan(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <tau(windows)>,<deviation(fA)>,<terms> for each tau with terms, separated by ;
+    bool first = true;
+    for (uint8_t level = 0; level < STATS_ALLAN_LEVELS; level++) {
+        uint32_t terms;
+        double deviation = stats_get_allan(level, &terms);
+        if (terms == 0) {
+            break;
+        }
+
+        if (!first) {
+            interface.print(";");
+        }
+        first = false;
+        interface.print(1UL << level);
+        interface.print(",");
+        interface.print(deviation, 3);
+        interface.print(",");
+        interface.print(terms);
+    }
+    interface.println();
+}
+
+static void statsReset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    stats_reset();
+}
+
+static const char* const estimatorNames[] = {"WINDow", "INTerval"};
+
+static void estimatorSet(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t estimator = findKeyword(parameters.First(), estimatorNames, 2);
+    if (estimator < 0) {
+        interface.println("Invalid parameter");
+        return;
+    }
+
+    // The statistics would mix the two estimators
+    if ((estimator == 1) != estimator_get_interval()) {
+        estimator_set_interval(estimator == 1);
+        stats_reset();
+    }
+}
+
+static void estimatorGet(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    interface.println(estimatorNames[estimator_get_interval() ? 1 : 0]);
+}
+
+static void historyGetInfo(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <period(s)>,<points>,<capacity>,<last timestamp(us)> for each level, separated by ;
+    for (uint8_t level = 0; level < HISTORY_LEVEL_COUNT; level++) {
+        if (level > 0) {
+            interface.print(";");
+        }
+        interface.print(history_period(level));
+        interface.print(",");
+        interface.print(history_size(level));
+        interface.print(",");
+        interface.print(HISTORY_POINTS);
+        interface.print(",");
+        printUint64(interface, history_last_timestamp(level));
+    }
+    interface.println();
+}
+
+static void historyGetData(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long level = atol(parameters.First());
+    if (level < 0 || level >= HISTORY_LEVEL_COUNT) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+
+    // Oldest point first, <min><mean><max> as little endian floats
+    uint16_t size = history_size(level);
+    scpi_write_block_header(interface, (uint32_t)size * sizeof(struct HistoryPoint));
+    for (uint16_t i = 0; i < size; i++) {
+        struct HistoryPoint point = history_get(level, i);
+        interface.write((const uint8_t*)&point, sizeof(point));
+    }
+    interface.println();
+}
+
+static void integratorStart(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    integrator_start();
+}
+
+static void integratorStop(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    integrator_stop();
+}
+
+static void integratorReset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    integrator_reset();
+}
+
+static void integratorGetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <charge(LSB)>,<charge(fC)>,<frames>,<running>,<overflow>
+    printInt64(interface, integrator_charge());
+    interface.print(",");
+    interface.print(integrator_charge_fc(), 3);
+    interface.print(",");
+    interface.print(integrator_frames());
+    interface.print(",");
+    interface.print(integrator_running());
+    interface.print(",");
+    interface.println(integrator_overflow());
+}
+
+static const char* const filterTypeNames[FILTER_TYPE_COUNT] = {"NONE", "IIR", "AVERage", "MEDian"};
+static const char* const filterOutputNames[] = {"DISPlay", "STREam", "LOG"};
+
+static void filterSetType(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t type = findKeyword(parameters.First(), filterTypeNames, FILTER_TYPE_COUNT);
+    if (type < 0) {
+        interface.println("Invalid parameter");
+        return;
+    }
+
+    conf.filter.type = type;
+    filter_reset();
+}
+
+static void filterGetType(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(filterTypeNames[conf.filter.type]);
+}
+
+static void filterSetLength(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long length = atol(parameters.First());
+    if (length < 1 || length > FILTER_MAX_LENGTH) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+
+    conf.filter.length = length;
+    filter_reset();
+}
+
+static void filterGetLength(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.filter.length);
+}
+
+static void filterSetTimeConstant(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    // A power of two, the IIR coefficient is a shift
+    long windows = atol(parameters.First());
+    uint8_t shift = 0;
+    while (shift < FILTER_MAX_SHIFT && (1L << shift) < windows) {
+        shift++;
+    }
+    if (windows < 1 || (1L << shift) != windows) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+
+    conf.filter.shift = shift;
+    filter_reset();
+}
+
+static void filterGetTimeConstant(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(1L << conf.filter.shift);
+}
+
+/**
+ * @brief Flag of an output of the filter, or nullptr if unknown.
+ */
+static bool* filterOutputFlag(const char* parameter) {
+    switch (findKeyword(parameter, filterOutputNames, 3)) {
+    case 0:
+        return &conf.filter.display;
+    case 1:
+        return &conf.filter.stream;
+    case 2:
+        return &conf.filter.log;
+    default:
+        return nullptr;
+    }
+}
+
+static void filterSetOutput(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    bool* flag = filterOutputFlag(parameters.First());
+    String state = String(parameters.Last());
+    state.toUpperCase();
+
+    if (flag == nullptr) {
+        interface.println("Invalid output parameter");
+    } else if (state == "ON") {
+        *flag = true;
+    } else if (state == "OFF") {
+        *flag = false;
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void filterGetOutput(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    bool* flag = filterOutputFlag(parameters.First());
+    if (flag == nullptr) {
+        interface.println("Invalid output parameter");
+        return;
+    }
+    interface.println(*flag);
+}
+
+static const char* const calibrationRangeNames[CALIBRATION_RANGE_COUNT] = {"FA", "PA", "NA", "UA"};
+
+/**
+ * @brief Apply a modified copy of the calibration in use.
+ */
+static void calibrationApply(const struct CalibrationRecord& record) {
+    if (calibration_set(record) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+    }
+}
+
+static void calibrationSetGain(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    int8_t range = findKeyword(parameters.First(), calibrationRangeNames, CALIBRATION_RANGE_COUNT);
+    if (range < 0) {
+        interface.println("Invalid range parameter");
+        return;
+    }
+
+    struct CalibrationRecord record = *calibration_get();
+    record.gain[range] = atof(parameters.Last());
+    calibrationApply(record);
+}
+
+static void calibrationGetGain(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t range = findKeyword(parameters.First(), calibrationRangeNames, CALIBRATION_RANGE_COUNT);
+    if (range < 0) {
+        interface.println("Invalid range parameter");
+        return;
+    }
+    interface.println(calibration_get()->gain[range], 6);
+}
+
+static void calibrationSetOffset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    int8_t range = findKeyword(parameters.First(), calibrationRangeNames, CALIBRATION_RANGE_COUNT);
+    if (range < 0) {
+        interface.println("Invalid range parameter");
+        return;
+    }
+
+    struct CalibrationRecord record = *calibration_get();
+    record.offset[range] = atof(parameters.Last());
+    calibrationApply(record);
+}
+
+static void calibrationGetOffset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int8_t range = findKeyword(parameters.First(), calibrationRangeNames, CALIBRATION_RANGE_COUNT);
+    if (range < 0) {
+        interface.println("Invalid range parameter");
+        return;
+    }
+    interface.println(calibration_get()->offset[range], 3);
+}
+
+static void calibrationSetPump(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    uint8_t channel = atoi(parameters.First());
+    if (channel < 1 || channel > CALIBRATION_PUMP_COUNT) {
+        interface.println("Invalid channel number");
+        return;
+    }
+
+    struct CalibrationRecord record = *calibration_get();
+    record.pumpGain[channel - 1] = atof(parameters.Last());
+    calibrationApply(record);
+}
 
-static void serialSetStream(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void serialGetStream(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void serialSetRaw(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void serialGetRaw(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationGetPump(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
 
-static void accurateSetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetCooldown(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetCooldown(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetReset(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetTCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetTCharge(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetTInjection(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetTInjection(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetDisableCP(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetDisableCP(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateSetSingly(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void accurateGetSingly(SCPI_C commands, SCPI_P parameters, Stream& interface);
+    uint8_t channel = atoi(parameters.First());
+    if (channel < 1 || channel > CALIBRATION_PUMP_COUNT) {
+        interface.println("Invalid channel number");
+        return;
+    }
+    interface.println(calibration_get()->pumpGain[channel - 1], 6);
+}
 
-static void printHelp(SCPI_C commands, SCPI_P parameters, Stream& interface);
-static void DoNothing(SCPI_C commands, SCPI_P parameters, Stream& interface);
+static void calibrationSetTemperature(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
 
-void addErrorToBuffer(String error);
-bool checkNumberParameters(SCPI_P parameters, uint8_t number);
+    struct CalibrationRecord record = *calibration_get();
+    record.tempCoef = atof(parameters.First());
+    record.tempRef = atof(parameters.Last());
+    calibrationApply(record);
+}
 
-/**
- * @brief After the function is executed, all the parameters are updated in the FPGA
- * @param func The function to be executed before updating the FPGA parameters
- */
-#define PARAM_UPDATE(func) [](SCPI_C commands, SCPI_P parameters, Stream& interface) { \
-    func(commands, parameters, interface); \
-    fpgaUpdateAllParam(); \
+static void calibrationGetTemperature(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <coef(ppm/°C)>,<ref(°C)>
+    const struct CalibrationRecord* record = calibration_get();
+    interface.print(record->tempCoef, 3);
+    interface.print(",");
+    interface.println(record->tempRef, 2);
+}
+
+static void calibrationGetData(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <gain>,<offset(fA)> for each range;<gain> for each pump;<coef(ppm/°C)>,<ref(°C)>
+    const struct CalibrationRecord* record = calibration_get();
+    for (uint8_t i = 0; i < CALIBRATION_RANGE_COUNT; i++) {
+        interface.print(record->gain[i], 6);
+        interface.print(",");
+        interface.print(record->offset[i], 3);
+        interface.print(";");
     }
+    for (uint8_t i = 0; i < CALIBRATION_PUMP_COUNT; i++) {
+        interface.print(record->pumpGain[i], 6);
+        interface.print(";");
+    }
+    interface.print(record->tempCoef, 3);
+    interface.print(",");
+    interface.println(record->tempRef, 2);
+}
 
+static void calibrationSave(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
 
-/**
- * @brief Error buffer, implemented as LIFO buffer
- * 
- * All the errors generated by the SCPI parser AND the commands are stored in
- * this buffer. If the error queue overflows, the last error is replaced with a 
- * "Queue Overflow" error.
-*/
-static LIFObuf<String> errorBuffer(ERROR_BUFFER_SIZE);
+    if (calibration_save() == false) {
+        addErrorToBuffer(SCPI_ERR_HARDWARE);
+    }
+}
 
-void init_scpiInterface() {
-    /*
-    To fix hash crashes, the hashing magic numbers can be changed before 
-    registering commands.
-    Use prime numbers up to the SCPI_HASH_TYPE size.
-    */
-    my_instrument.hash_magic_number = 37; //Default value = 37
-    my_instrument.hash_magic_offset = 7;  //Default value = 7
-
-    my_instrument.timeout = 10; //value in miliseconds. Default value = 10
-
-
-    my_instrument.SetCommandTreeBase(F("STATus:OPERation"));
-        my_instrument.RegisterCommand(F(":CONDition?"), &DoNothing);
-        my_instrument.RegisterCommand(F(":ENABle"), &DoNothing);
-        my_instrument.RegisterCommand(F(":EVENt?"), &DoNothing);
-    my_instrument.SetCommandTreeBase(F("STATus:QUEStionable"));
-        my_instrument.RegisterCommand(F(":CONDition?"), &DoNothing);
-        my_instrument.RegisterCommand(F(":ENABle"), &DoNothing);
-        my_instrument.RegisterCommand(F(":EVENt?"), &DoNothing);
-    my_instrument.SetCommandTreeBase(F("STATus"));
-        my_instrument.RegisterCommand(F(":OPERation?"), &DoNothing);
-        my_instrument.RegisterCommand(F(":QUEStionable?"), &DoNothing);
-        my_instrument.RegisterCommand(F(":PRESet"), &DoNothing);
-    my_instrument.SetCommandTreeBase(F(""));
-    my_instrument.RegisterCommand(F("*CLS"), &DoNothing);
-    my_instrument.RegisterCommand(F("*ESE"), &DoNothing);
-    my_instrument.RegisterCommand(F("*ESE?"), &DoNothing);
-    my_instrument.RegisterCommand(F("*ESR"), &DoNothing);
-    my_instrument.RegisterCommand(F("*OPC"), &DoNothing);
-    my_instrument.RegisterCommand(F("*OPC?"), &DoNothing);
-    my_instrument.RegisterCommand(F("*SRE"), &DoNothing);
-    my_instrument.RegisterCommand(F("*SRE?"), &DoNothing);
-    my_instrument.RegisterCommand(F("*STB"), &DoNothing);
-    my_instrument.RegisterCommand(F("*TST?"), &DoNothing);
-    my_instrument.RegisterCommand(F("*WAI"), &DoNothing);
-    
-    // ---------------- Implemented commands ----------------
-    my_instrument.SetCommandTreeBase(F("SYSTem"));
-        my_instrument.RegisterCommand(F(":ERRor?"), &GetLastError);
-        my_instrument.RegisterCommand(F(":ERRor:NEXT?"), &GetLastError);
-        my_instrument.RegisterCommand(F(":ERRor:COUNt?"), &GetErrorSize);
-        my_instrument.RegisterCommand(F(":VERSion?"), &SCPIversion);
-    my_instrument.SetCommandTreeBase(F("CONFigure:DAC"));
-        my_instrument.RegisterCommand(F(":VOLTage#"), PARAM_UPDATE(dacSetVoltage));
-        my_instrument.RegisterCommand(F(":VOLTage?"), &dacGetVoltage);
-    my_instrument.SetCommandTreeBase(F("CONFigure:ACCUrate"));
-        my_instrument.RegisterCommand(F(":CHARGE#"), PARAM_UPDATE(accurateSetCharge));
-        my_instrument.RegisterCommand(F(":CHARGE?#"), &accurateGetCharge);
-        my_instrument.RegisterCommand(F(":COOLdown#"), PARAM_UPDATE(accurateSetCooldown));
-        my_instrument.RegisterCommand(F(":COOLdown?#"), &accurateGetCooldown);
-        my_instrument.RegisterCommand(F(":RESET#"), PARAM_UPDATE(accurateSetReset));
-        my_instrument.RegisterCommand(F(":RESET?"), &accurateGetReset);
-        my_instrument.RegisterCommand(F(":TCHARGE#"), PARAM_UPDATE(accurateSetTCharge));
-        my_instrument.RegisterCommand(F(":TCHARGE?"), &accurateGetTCharge);
-        my_instrument.RegisterCommand(F(":TINJection#"), PARAM_UPDATE(accurateSetTInjection));
-        my_instrument.RegisterCommand(F(":TINJection?"), &accurateGetTInjection);
-        my_instrument.RegisterCommand(F(":DISABLE#"), PARAM_UPDATE(accurateSetDisableCP));
-        my_instrument.RegisterCommand(F(":DISABLE?#"), &accurateGetDisableCP);
-        my_instrument.RegisterCommand(F(":SINGLY#"), PARAM_UPDATE(accurateSetSingly));
-        my_instrument.RegisterCommand(F(":SINGLY?"), &accurateGetSingly);
-    my_instrument.SetCommandTreeBase(F("CONFigure:SERIal"));
-        my_instrument.RegisterCommand(F(":STREAM#"), &serialSetStream);
-        my_instrument.RegisterCommand(F(":STREAM?"), &serialGetStream);
-        my_instrument.RegisterCommand(F(":RAW#"), &serialSetRaw);
-        my_instrument.RegisterCommand(F(":RAW?"), &serialGetRaw);
-    my_instrument.SetCommandTreeBase(F(""));
-    my_instrument.RegisterCommand(F("*IDN?"), &Identify);
-    my_instrument.RegisterCommand(F("*RST"), &Reset);
-    my_instrument.RegisterCommand(F("HELP?"), &printHelp);
-
-
-    // my_instrument.PrintDebugInfo(Serial);
-    my_instrument.SetErrorHandler(&SerialErrorHandler);
+static void calibrationLoad(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // Nominal if none is stored
+    if (calibration_init() == false) {
+        interface.println("No stored calibration");
+    }
 }
 
+static void calibrationDefault(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    calibration_reset();
+}
 
-// -------------------------------------------------------------------
-// ---------------- Functions of implemented commands ----------------
-// -------------------------------------------------------------------
+static void quantaStart(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    sweep_abort();
+    quanta_start();
+}
 
-static void Identify(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+static void quantaAbort(SCPI_C commands, SCPI_P parameters, Stream& interface) {
     if (checkNumberParameters(parameters, 0) == false) return;
+    quanta_abort();
+}
 
-    String outMessage = "CERN, REV1, ";
-    for (uint8_t i = 0; i < 4; i++) {
-        outMessage += String(( *(conf.UUID+i) ), HEX);
+static void quantaSetActivations(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long activations = atol(parameters.First());
+    if (activations < 0 || quanta_set_activations(activations) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
     }
-    outMessage += ", 1.4.0";
-    interface.println(outMessage);
 }
 
-static void Reset(SCPI_C commands, SCPI_P parameters, Stream& interface) {
-    delay(1000);
-    /*
-    CMSIS (Cortex Microcontroller Software Interface Standard) function
-    Set the SYSRESETREQ in the NVIC (Nested Vectored Interrupt Controller),
-    causing the MCU to reset.
-    */
-    NVIC_SystemReset();
+static void quantaGetActivations(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(quanta_get_activations());
 }
 
-static void GetLastError(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+static const char* quantaStateNames[] = {"IDLE", "RUNNING", "DONE", "FAILED", "ABORTED"};
+
+static void quantaGetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
     if (checkNumberParameters(parameters, 0) == false) return;
 
-    if (errorBuffer.empty()) {
-        interface.println("0, No Error");
-    } else {
-        interface.println(errorBuffer.pop());
+    // <state>,<phase>,<CP2 ratio>,<CP3 ratio>
+    interface.print(quantaStateNames[quanta_state()]);
+    interface.print(",");
+    interface.print(quanta_phase());
+    interface.print(",");
+    interface.print(quanta_ratio(1), 6);
+    interface.print(",");
+    interface.println(quanta_ratio(2), 6);
+}
+
+static void quantaGetData(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <pumps>,<cp1>,<cp2>,<cp3>,<time(ms)> for each combination, separated by ';'
+    for (uint8_t k = 0; k < QUANTA_PHASE_COUNT; k++) {
+        const struct QuantaPhase* phase = quanta_get_phase(k);
+        if (k > 0) {
+            interface.print(";");
+        }
+        interface.print(phase->pumps);
+        for (uint8_t i = 0; i < QUANTA_PUMP_COUNT; i++) {
+            interface.print(",");
+            interface.print(phase->counts[i]);
+        }
+        interface.print(",");
+        interface.print(phase->timeMs);
     }
+    interface.println();
 }
 
-static void GetErrorSize(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+static void sweepSetChannel(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    uint8_t channel = toupper(parameters.First()[0]) - 'A';
+    if (sweep_set_channel(channel) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+    }
+}
+
+static void sweepGetChannel(SCPI_C commands, SCPI_P parameters, Stream& interface) {
     if (checkNumberParameters(parameters, 0) == false) return;
-    interface.println(errorBuffer.size());
+    interface.println((char)('A' + sweep_get_channel()));
 }
 
-static void SCPIversion(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+static void sweepSetRange(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 3) == false) return;
+
+    float start = atof(parameters[0]);
+    float stop = atof(parameters[1]);
+    float step = atof(parameters[2]);
+    if (sweep_set_range(start, stop, step) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+    }
+}
+
+static void sweepGetRange(SCPI_C commands, SCPI_P parameters, Stream& interface) {
     if (checkNumberParameters(parameters, 0) == false) return;
-    interface.println("NOT SCPI COMPLIANT");
+
+    // <start(V)>,<stop(V)>,<step(V)>,<steps>
+    float start, stop, step;
+    sweep_get_range(&start, &stop, &step);
+    interface.print(start, 4);
+    interface.print(",");
+    interface.print(stop, 4);
+    interface.print(",");
+    interface.print(step, 4);
+    interface.print(",");
+    interface.println(sweep_steps());
+}
+
+static void sweepSetWindows(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 2) == false) return;
+
+    long settle = atol(parameters.First());
+    long measure = atol(parameters.Last());
+    // Checked against the maximum before any narrowing
+    if (settle < 0 || measure < 0 || sweep_set_windows((uint32_t)settle, (uint32_t)measure) == false) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+    }
+}
+
+static void sweepGetWindows(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    uint16_t settle, measure;
+    sweep_get_windows(&settle, &measure);
+    interface.print(settle);
+    interface.print(",");
+    interface.println(measure);
+}
+
+static void sweepStart(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    quanta_abort();
+    sweep_start();
+}
+
+static void sweepAbort(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    sweep_abort();
+}
+
+static void sweepGetProgress(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <running>,<points>
+    interface.print(sweep_running());
+    interface.print(",");
+    interface.println(sweep_count());
+}
+
+static void sweepGetData(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // First step first, <voltage><count><mean><stdDev><min><max> little endian
+    uint16_t size = sweep_count();
+    scpi_write_block_header(interface, (uint32_t)size * sizeof(struct SweepPoint));
+    for (uint16_t i = 0; i < size; i++) {
+        struct SweepPoint point = sweep_get(i);
+        interface.write((const uint8_t*)&point, sizeof(point));
+    }
+    interface.println();
 }
 
 static void dacSetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface) {
@@ -241,6 +1626,155 @@ static void serialGetRaw(SCPI_C commands, SCPI_P parameters, Stream& interface)
     interface.println(conf.serial.rawOutput);
 }
 
+static void serialSetIntegral(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    String first_parameter = String(parameters.First());
+    first_parameter.toUpperCase();
+
+    if (first_parameter == "ON") {
+        conf.serial.integral = true;
+    } else if (first_parameter == "OFF") {
+        conf.serial.integral = false;
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void serialGetIntegral(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.serial.integral);
+}
+
+static void displaySetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    String first_parameter = String(parameters.First());
+    first_parameter.toUpperCase();
+
+    if (first_parameter == "ON") {
+        screen_enable(true);
+    } else if (first_parameter == "OFF") {
+        screen_enable(false);
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void displayGetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.display.enable);
+}
+
+static void displaySetRate(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    int rate = atoi(parameters.First());
+    if (rate < 1 || rate > MAX_DISPLAY_RATE) {
+        interface.println("Invalid rate");
+        return;
+    }
+
+    conf.display.maxRate = rate;
+}
+
+static void displayGetRate(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.display.maxRate);
+}
+
+static void displaySetAverage(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    String first_parameter = String(parameters.First());
+    first_parameter.toUpperCase();
+
+    if (first_parameter == "ON") {
+        conf.display.average = true;
+    } else if (first_parameter == "OFF") {
+        conf.display.average = false;
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void displayGetAverage(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.display.average);
+}
+
+static void i2cSetClock(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long clock = atol(parameters.First());
+    if (clock < I2C_CLOCK_SM || clock > I2C_CLOCK_FMPLUS) {
+        interface.println("Invalid clock");
+        return;
+    }
+
+    conf.i2c.clock = clock;
+    i2cbus_set_clock(clock);
+}
+
+static void i2cGetClock(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.i2c.clock);
+}
+
+static void adcSetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    String first_parameter = String(parameters.First());
+    first_parameter.toUpperCase();
+
+    if (first_parameter == "ON") {
+        ltc2471_enable(true);
+    } else if (first_parameter == "OFF") {
+        ltc2471_enable(false);
+    } else {
+        interface.println("Invalid parameter");
+    }
+}
+
+static void adcGetState(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+    interface.println(conf.adc.enable);
+}
+
+static void adcGetVoltage(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    float voltage;
+    if (ltc2471_read_voltage(&voltage) == false) {
+        addErrorToBuffer(SCPI_ERR_DATA_STALE);
+        return;
+    }
+    interface.println(voltage, 6);
+}
+
+static void adcGetCurrent(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <current>,<status>, status 0: ok, 1: not enough samples, 2: saturated, 3: I2C error
+    float current = 0;
+    LTC2471_Status status = ltc2471_read_current(&current);
+    interface.print(current, 6);
+    interface.print(",");
+    interface.println(status);
+}
+
+static void sht41Get(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    // <temperature(C)>,<humidity(%)>,<status>, status 0: ok, 1: I2C error, 2: CRC error, 3: none yet or read failed
+    TempHumMeasurement measurement = sht41_get_latest();
+    interface.print(measurement.temperature, 2);
+    interface.print(",");
+    interface.print(measurement.humidity, 2);
+    interface.print(",");
+    interface.println(measurement.status);
+}
+
 static void printHelp(SCPI_C commands, SCPI_P parameters, Stream& interface) {
     if (checkNumberParameters(parameters, 0) == false) return;
     interface.println(scpiCommandTree);
@@ -415,8 +1949,26 @@ static void accurateGetSingly(SCPI_C commands, SCPI_P parameters, Stream& interf
     interface.println(conf.acc.singlyCPActivation);
 }
 
+static void accurateSetPeriod(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 1) == false) return;
+
+    long period = atol(parameters.First());
+    if (period < MIN_WINDOW_PERIOD || period > MAX_WINDOW_PERIOD) {
+        addErrorToBuffer(SCPI_ERR_OUT_OF_RANGE);
+        return;
+    }
+
+    conf.acc.windowPeriod = period;
+}
+
+static void accurateGetPeriod(SCPI_C commands, SCPI_P parameters, Stream& interface) {
+    if (checkNumberParameters(parameters, 0) == false) return;
+
+    interface.println(conf.acc.windowPeriod);
+}
+
 static void DoNothing(SCPI_C commands, SCPI_P parameters, Stream& interface) {
-    addErrorToBuffer("Command not implemented");
+    addErrorToBuffer(SCPI_ERR_NOT_IMPLEMENTED);
 }
 
 
@@ -425,19 +1977,22 @@ static void DoNothing(SCPI_C commands, SCPI_P parameters, Stream& interface) {
 // ------------------------------------------------------------
 
 /**
- * @brief Add an error to the error buffer 
- * @param error Error message to add to the buffer
+ * @brief Add an error to the error queue
+ * @param error Error to add to the queue
  * 
- * The function check if the buffer is full, if so it replace the last error
- * with a "Queue Overflow" error.
+ * The function check if the queue is almost full, if so the error is replaced
+ * by a "Queue overflow" error. Once full, the errors are discarded.
 */
-void addErrorToBuffer(String error) {
-    if (errorBuffer.full()) {
-        errorBuffer.pop();
-        errorBuffer.push("Queue Overflow");
-    } else {
-        errorBuffer.push(error);
+void addErrorToBuffer(enum ScpiError error) {
+    if (errorQueue.full()) {
+        return;
     }
+
+    struct ErrorRecord record;
+    record.error = (errorQueue.size() == ERROR_QUEUE_SIZE - 1) ? SCPI_ERR_QUEUE_OVERFLOW : error;
+    record.command = currentCommand;
+    record.timeMs = millis();
+    errorQueue.push(record);
 }
 
 /**
@@ -452,48 +2007,44 @@ void addErrorToBuffer(String error) {
  */
 bool checkNumberParameters(SCPI_P parameters, uint8_t number) {
     if (parameters.Size() > number) {
-        addErrorToBuffer("-108, Parameter not allowed");
+        addErrorToBuffer(SCPI_ERR_PARAM_NOT_ALLOWED);
         return false;
     } else if (parameters.Size() < number) {
-        addErrorToBuffer("-109, Missing parameter");
+        addErrorToBuffer(SCPI_ERR_MISSING_PARAM);
         return false;
     }
     return true;
 }
 
 /**
- * @brief Serial error handler
- * 
- * This function is called every time an error occurs on the parser side.
- * It checks the error code and adds the corresponding error message to the
- * error buffer.
+ * @brief Print a signed 64-bit value
+ * @param interface The stream to print to
+ * @param value The value to print
+ *
+ * Print() does not support 64-bit integers.
  */
-static void SerialErrorHandler(SCPI_C commands, SCPI_P parameters, Stream& interface) {
-    // This function is called every time an error occurs on the parser side
-    switch(my_instrument.last_error){
-        case my_instrument.ErrorCode::BufferOverflow: 
-            errorBuffer.push("-100, Buffer overflow error");
-            break;
-        case my_instrument.ErrorCode::Timeout:
-            errorBuffer.push("-100, Communication timeout error");
-            break;
-        case my_instrument.ErrorCode::UnknownCommand:
-            errorBuffer.push("-102, Unknown command received");
-            break;
-        case my_instrument.ErrorCode::NoError:
-            break;
-    }
-    my_instrument.last_error = my_instrument.ErrorCode::NoError;
-
-    /* For BufferOverflow errors, the rest of the message, still in the interface
-    buffer or not yet received, will be processed later and probably 
-    trigger another kind of error.
-    Here we flush the incoming message*/
-    if (my_instrument.last_error == SCPI_Parser::ErrorCode::BufferOverflow) {
-        delay(2);
-        while (interface.available()) {
-        delay(2);
-        interface.read();
-        }
+static void printInt64(Stream& interface, int64_t value) {
+    if (value < 0) {
+        interface.print("-");
+        printUint64(interface, (uint64_t)(-value));
+    } else {
+        printUint64(interface, (uint64_t)value);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Print an unsigned 64-bit value
+ * @param interface The stream to print to
+ * @param value The value to print
+ */
+static void printUint64(Stream& interface, uint64_t value) {
+    char buffer[21]; // maximum value for uint64_t is 20 digits
+    char* ndx = &buffer[sizeof(buffer) - 1];
+    *ndx = '\0';
+    do {
+        *--ndx = value % 10 + '0';
+        value = value / 10;
+    } while (value != 0);
+
+    interface.print(ndx);
+}
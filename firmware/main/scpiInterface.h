@@ -3,32 +3,17 @@
  * @brief SCPI interface for the project
  * @author Mattia Consani
  * 
- * This file contains the SCPI parser library implementation for the project.
- * The SCPI parser object is initialized in the main file.
+ * This file contains the SCPI command set of the project. The commands are
+ * dispatched through a perfect hash table built at compile time, see
+ * scpiDispatch.h.
 */
 
-/*
-The SCPI library supports the following macros to optimize RAM usage:
-- SCPI_ARRAY_SYZE : Max branches of the command tree and max number of parameters.
-- SCPI_MAX_TOKENS : Max number of valid tokens.
-- SCPI_MAX_COMMANDS : Max number of registered commands.
-- SCPI_MAX_SPECIAL_COMMANDS : Max number of special commands.
-- SCPI_BUFFER_LENGTH : Length of the message buffer.
-- SCPI_HASH_TYPE : Integer size used for hashes.
-*/
-#define SCPI_ARRAY_SYZE 4 //Default value = 6
-#define SCPI_MAX_TOKENS 50 //Default value = 15
-#define SCPI_MAX_COMMANDS 50 //Default value = 20
-#define SCPI_MAX_SPECIAL_COMMANDS 0 //Default value = 0
-#define SCPI_BUFFER_LENGTH 128 //Default value = 64
-#define SCPI_HASH_TYPE uint16_t //Default value = uint8_t
-
 #ifndef SCPIINTERFACE_H
 #define SCPIINTERFACE_H
 
 
 #include <Arduino.h>
-#include "Vrekrer_scpi_parser.h"
+#include "scpiDispatch.h"
 
 /*
 Command tree with only SCPI Required Commands and IEEE Mandated Commands:
@@ -91,24 +76,46 @@ CONFigure
 
 
 /**
- * @brief Error buffer size
+ * @brief Error queue size, power of two, the last entry is for the overflow
  */
-#define ERROR_BUFFER_SIZE 15
+#define ERROR_QUEUE_SIZE 16
 
 /**
- * @brief The SCPI parser object
- * 
- * The SCPI_Parser object is defined in the main file.
+ * @defgroup stat_oper Bits of STATus:OPERation:CONDition?
+ * @{
+ */
+#define STAT_OPER_CALIBRATING (1 << 0) // The charge quanta are being measured
+#define STAT_OPER_SWEEPING (1 << 3) // A DAC sweep is running
+#define STAT_OPER_MEASURING (1 << 4) // A trace capture is running
+#define STAT_OPER_WAITING_TRIGGER (1 << 5) // The trigger is armed
+/** @} */
+
+/**
+ * @brief Errors of the SCPI interface, see errorTable for the codes
  */
-extern SCPI_Parser my_instrument;
+enum ScpiError {
+    SCPI_ERR_NONE,
+    SCPI_ERR_BUFFER_OVERFLOW,
+    SCPI_ERR_TIMEOUT,
+    SCPI_ERR_NOT_IMPLEMENTED,
+    SCPI_ERR_UNKNOWN_COMMAND,
+    SCPI_ERR_PARAM_NOT_ALLOWED,
+    SCPI_ERR_MISSING_PARAM,
+    SCPI_ERR_OUT_OF_RANGE,
+    SCPI_ERR_DATA_STALE,
+    SCPI_ERR_HARDWARE,
+    SCPI_ERR_QUEUE_OVERFLOW,
+    SCPI_ERR_COUNT
+};
 
 /**
- * @brief Initialize the SCPI interface
+ * @brief Read the available characters and execute the complete messages
+ * @param interface The stream to read from and answer to
  * 
- * Set the parser command tree and other settings. The SCPI_Parser object is
- * defined in the main file.
+ * Never waits for characters. The messages end with '\n', a message
+ * interrupted for more than SCPI_TIMEOUT_MS is dropped.
  */
-void init_scpiInterface();
+void process_scpiInterface(Stream& interface);
 
 
 #endif // SCPIINTERFACE_H
\ No newline at end of file
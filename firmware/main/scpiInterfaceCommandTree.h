@@ -25,6 +25,19 @@ const __FlashStringHelper* scpiCommandTree = F(
     "    :ERRor\n"
     "        [:NEXT]?\n"
     "    :VERSion?\n"
+    "    :TIME?\n"
+    "        :PROBe? <t1(us)>\n"
+    "        :SYNC <t1(us)> ,<t2(us)> ,<t3(us)> ,<t4(us)>\n"
+    "        :SYNC?\n"
+    "    :DISPlay\n"
+    "        :STATistics?\n"
+    "    :I2C\n"
+    "        :STATistics?\n"
+    "    :SCHEDuler?\n"
+    "        :RESet\n"
+    "    :PERFormance?\n"
+    "        :RESet\n"
+    "    :FRAMes?\n"
     "*CLS\n"
     "*ESE\n"
     "*ESE?\n"
@@ -59,11 +72,110 @@ const __FlashStringHelper* scpiCommandTree = F(
     "        :DISABLE? 1|2|3\n"
     "        :SINGLY 1|0\n"
     "        :SINGLY?\n"
+    "        :PERiod <period(ms)>\n"
+    "        :PERiod?\n"
     "    :SERIal\n"
     "        :STREAM ON|OFF\n"
     "        :STREAM?\n"
     "        :RAW ON|OFF\n"
     "        :RAW?\n"
+    "        :INTegral ON|OFF\n"
+    "        :INTegral?\n"
     "        :LOG ON|OFF\n"
     "        :LOG?\n"
+    "    :DISPlay\n"
+    "        :STATE ON|OFF\n"
+    "        :STATE?\n"
+    "        :RATE <rate(Hz)>\n"
+    "        :RATE?\n"
+    "        :AVERage ON|OFF\n"
+    "        :AVERage?\n"
+    "    :I2C\n"
+    "        :CLOCk <frequency(Hz)>\n"
+    "        :CLOCk?\n"
+    "    :ADC\n"
+    "        :STATE ON|OFF\n"
+    "        :STATE?\n"
+    "TRACe\n"
+    "    :POINts <frames>\n"
+    "    :POINts?\n"
+    "        :ACTual?\n"
+    "    :DATA?\n"
+    "INITiate\n"
+    "ABORt\n"
+    "TRIGger\n"
+    "    :STATE ON|OFF\n"
+    "    :STATE?\n"
+    "    :SOURce CURRent|CP1|CP2|CP3\n"
+    "    :SOURce?\n"
+    "    :TYPE EDGE|SLOPe|WINDow\n"
+    "    :TYPE?\n"
+    "    :SLOPe POSitive|NEGative\n"
+    "    :SLOPe?\n"
+    "    :LEVel <level>\n"
+    "    :LEVel?\n"
+    "    :WINDow <low> ,<high>\n"
+    "    :WINDow?\n"
+    "    :SEGMent <pre> ,<post>\n"
+    "    :SEGMent?\n"
+    "    :EVENt?\n"
+    "        :COUNt?\n"
+    "CALCulate\n"
+    "    :STATistics?\n"
+    "    :ALLan?\n"
+    "    :RESet\n"
+    "    :ESTimator WINDow|INTerval\n"
+    "    :ESTimator?\n"
+    "HISTory\n"
+    "    :INFO?\n"
+    "    :DATA? 0|1|2|3\n"
+    "INTegrator\n"
+    "    :STARt\n"
+    "    :STOP\n"
+    "    :RESet\n"
+    "    :CHARge?\n"
+    "FILTer\n"
+    "    :TYPE NONE|IIR|AVERage|MEDian\n"
+    "    :TYPE?\n"
+    "    :LENGth <taps>\n"
+    "    :LENGth?\n"
+    "    :TCONstant <windows>\n"
+    "    :TCONstant?\n"
+    "    :OUTPut DISPlay|STREam|LOG ,ON|OFF\n"
+    "    :OUTPut? DISPlay|STREam|LOG\n"
+    "CALibration\n"
+    "    :GAIN FA|PA|NA|UA ,<gain>\n"
+    "    :GAIN? FA|PA|NA|UA\n"
+    "    :OFFSet FA|PA|NA|UA ,<offset(fA)>\n"
+    "    :OFFSet? FA|PA|NA|UA\n"
+    "    :PUMP 1|2|3 ,<gain>\n"
+    "    :PUMP? 1|2|3\n"
+    "    :TEMPerature <coef(ppm/C)> ,<ref(C)>\n"
+    "    :TEMPerature?\n"
+    "    :DATA?\n"
+    "    :SAVE\n"
+    "    :LOAD\n"
+    "    :DEFault\n"
+    "    :QUANta?\n"
+    "        :STARt\n"
+    "        :ABORt\n"
+    "        :ACTivations <activations>\n"
+    "        :ACTivations?\n"
+    "        :DATA?\n"
+    "SWEep\n"
+    "    :CHANnel A|B|C|D|E|F|G|H\n"
+    "    :CHANnel?\n"
+    "    :RANGe <start(V)> ,<stop(V)> ,<step(V)>\n"
+    "    :RANGe?\n"
+    "    :WINDows <settle> ,<measure>\n"
+    "    :WINDows?\n"
+    "    :STARt\n"
+    "    :ABORt\n"
+    "    :PROGress?\n"
+    "    :DATA?\n"
+    "MEASure\n"
+    "    :ADC\n"
+    "        :VOLTage?\n"
+    "        :CURRent?\n"
+    "    :SHT41?\n"
 );
\ No newline at end of file
@@ -0,0 +1,229 @@
+/**
+ * @file screen.cpp
+ * @brief Source file for the screen refresh task.
+ */
+
+#include "screen.h"
+#include "ssd1306.h"
+#include "sht41.h"
+#include "trend.h"
+#include "config.h"
+#include "perf.h"
+#include "integrator.h"
+#include "estimator.h"
+
+static enum ScreenMode screenMode = CURRENT_DISPLAY;
+static enum ScreenMode drawnMode = CURRENT_DISPLAY; // Mode of the last refresh
+
+// Snapshot of the frames received since the last refresh
+static struct rawDataFPGA lastSample;
+static uint64_t chargeSum = 0;
+static float currentSum = 0;  // [fA]
+static float lastCurrent = 0; // [fA]
+static uint32_t sampleCount = 0;
+
+static uint32_t lastRefreshMs = 0;
+
+// Trend graph state
+static uint32_t trendDrawn = 0;   // Absolute index of the next point to draw
+static float trendMin = 0;        // Current vertical scale [fA]
+static float trendMax = 0;
+static bool trendRescale = true;  // Force a full replot
+
+static void updateScreen(const struct rawDataFPGA& rawData, uint64_t charge, float current);
+static void drawTrend();
+
+
+void screen_push_sample(const struct rawDataFPGA& rawData) {
+    lastSample = rawData;
+    chargeSum += rawData.charge;
+    lastCurrent = conf.filter.display ? rawData.filtered / 1000.0f : estimator_current(rawData);
+    currentSum += lastCurrent;
+    sampleCount++;
+
+    // The trend is fed in every mode, so it is ready when shown
+    trend_push(lastCurrent);
+}
+
+void screen_task() {
+    if (conf.display.enable == false || sampleCount == 0) {
+        return;
+    }
+
+    uint32_t now = millis();
+    if (now - lastRefreshMs < 1000 / conf.display.maxRate) {
+        return;
+    }
+    // The previous frame is still on its way, draw when the bus is done with it
+    if (ssd1306_busy()) {
+        return;
+    }
+    lastRefreshMs = now;
+
+    uint64_t charge = conf.display.average ? chargeSum / sampleCount : lastSample.charge;
+    float current = conf.display.average ? currentSum / sampleCount : lastCurrent;
+    chargeSum = 0;
+    currentSum = 0;
+    sampleCount = 0;
+
+    uint32_t drawStart = perf_now();
+    updateScreen(lastSample, charge, current);
+    perf_record(PERF_DISPLAY, drawStart);
+}
+
+void screen_next_mode() {
+    switch (screenMode) {
+    case CHARGE_DETECTION:
+        screenMode = CHARGE_INTEGRATION;
+        break;
+    case CHARGE_INTEGRATION:
+        screenMode = VAR_SEMPLING_TIME;
+        break;
+    case VAR_SEMPLING_TIME:
+        screenMode = CURRENT_DISPLAY;
+        break;
+    case CURRENT_DISPLAY:
+        screenMode = CURRENT_TREND;
+        break;
+    case CURRENT_TREND:
+        screenMode = CHARGE_DETECTION;
+        break;
+    default:
+        break;
+    }
+}
+
+void screen_enable(bool enable) {
+    conf.display.enable = enable;
+    ssd1306_power(enable);
+}
+
+
+/**
+ * @brief Update the screen mode
+ * @param rawData The last raw data coming from the FPGA
+ * @param charge The charge to show, latest or averaged [LSB]
+ * @param current The current to show, latest or averaged [fA]
+ * @return void
+ *
+ * Calculate the cahrge value based on the current screen mode and print it
+ * to display.
+ */
+static void updateScreen(const struct rawDataFPGA& rawData, uint64_t charge, float current) {
+    // The trend uses a different layout, start from a blank screen
+    if ((drawnMode == CURRENT_TREND) != (screenMode == CURRENT_TREND)) {
+        ssd1306_clear();
+        trendRescale = true;
+    }
+    drawnMode = screenMode;
+
+    // Format the current
+    CurrentMeasurement current_measurement = fpga_format_current(current);
+
+    // Calculate temperature and humidity from raw data
+    TempHumMeasurement measuredTempHum;
+    sht41_calculate(rawData.tempSht41, rawData.humidSht41, &measuredTempHum);
+    String temp = String(measuredTempHum.temperature, 2);
+    String humidity = String(measuredTempHum.humidity, 2);
+
+    // Screen update
+    float chargefA = (charge * DEFAULT_LSB) / 1000;
+    switch (screenMode) {
+    case CHARGE_DETECTION:
+        ssd1306_print_charge(chargefA, temp, humidity, "Single sample");
+        break;
+    case CHARGE_INTEGRATION:
+        // Integrated by the integrator on every frame, not only the shown ones
+        ssd1306_print_charge(integrator_charge_fc(), temp, humidity,
+                             integrator_running() ? "Integration" : "Integr. stop");
+        break;
+    case VAR_SEMPLING_TIME:
+        // ssd1306_print_transition(screenMode);
+        ssd1306_print_charge(charge, temp, humidity, "Multi sample");
+        break;
+    case CURRENT_DISPLAY:
+        ssd1306_print_current_temp_humidity(current_measurement.convertedCurrent, current_measurement.range, temp, humidity);
+        break;
+    case CURRENT_TREND:
+        drawTrend();
+        break;
+    default:
+        break;
+    }
+}
+
+
+/**
+ * @brief Map a current to the graph vertical axis.
+ */
+static int16_t trendToY(float current) {
+    return (int16_t)((current - trendMin) / (trendMax - trendMin) * (GRAPH_HEIGHT - 1));
+}
+
+/**
+ * @brief Draw the column of one trend point.
+ * @param index Absolute index of the point.
+ * @param first Index of the oldest point on screen, not connected to its predecessor.
+ */
+static void drawTrendPoint(uint32_t index, uint32_t first) {
+    int16_t y = trendToY(trend_get(index));
+    int16_t yPrevious = (index > first) ? trendToY(trend_get(index - 1)) : y;
+    ssd1306_graph_column(index % TREND_POINTS, yPrevious, y);
+}
+
+/**
+ * @brief Draw the current trend graph.
+ *
+ * The graph is drawn like a sweeping oscilloscope trace: each new point
+ * overwrites the column of the oldest one and a blank column in front of it
+ * marks the position of the sweep. Only the new columns are sent to the
+ * display. The whole graph is replotted only when the scale changes, that is
+ * when a point falls out of it or when the span it would get, margins
+ * included, is below a quarter of it. A flat trace keeps its scale.
+ */
+static void drawTrend() {
+    uint32_t count = trend_count();
+
+    float low, high;
+    if (trend_range(&low, &high) == false) {
+        ssd1306_set_field(FIELD_TITLE, "Trend...");
+        ssd1306_commit();
+        return;
+    }
+
+    // Title: latest point
+    CurrentMeasurement last = fpga_format_current(trend_get(count - 1));
+    ssd1306_set_field(FIELD_TITLE, (String(last.convertedCurrent, 2) + " " + last.range).c_str());
+
+    uint32_t first = (count > TREND_POINTS) ? count - TREND_POINTS : 0;
+
+    // A flat trace still gets a span, from its margin
+    float margin = (high - low) * 0.1;
+    if (margin == 0) {
+        margin = max(fabs(high) * 0.1, 1.0);
+    }
+    bool shrink = (high - low) + 2 * margin < (trendMax - trendMin) / 4;
+
+    if (trendRescale || low < trendMin || high > trendMax || shrink) {
+        trendMin = low - margin;
+        trendMax = high + margin;
+        trendRescale = false;
+
+        // Full replot
+        for (uint8_t x = 0; x < TREND_POINTS; x++) {
+            ssd1306_graph_clear_column(x);
+        }
+        trendDrawn = first;
+    }
+
+    // Draw only the points not yet on screen
+    if (trendDrawn < first) {
+        trendDrawn = first;
+    }
+    for (; trendDrawn < count; trendDrawn++) {
+        drawTrendPoint(trendDrawn, first);
+    }
+    ssd1306_graph_clear_column(count % TREND_POINTS);
+
+    ssd1306_commit();
+}
@@ -0,0 +1,46 @@
+/**
+ * @file screen.h
+ * @brief Screen refresh task, decoupled from the acquisition.
+ *
+ * The acquisition only hands every valid frame to screen_push_sample(),
+ * which is cheap. The screen itself is redrawn by screen_task() at most
+ * conf.display.maxRate times per second, using the latest frame or the
+ * average of the frames received since the previous refresh.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+#include "fpga.h"
+
+/**
+ * @brief Store a new frame in the screen snapshot.
+ * @param rawData The raw data coming from the FPGA
+ *
+ * Must be called for every valid frame, as the trend relies on it.
+ */
+void screen_push_sample(const struct rawDataFPGA& rawData);
+
+/**
+ * @brief Redraw the screen if the refresh period elapsed.
+ *
+ * To be called as often as possible, it returns immediately if there is
+ * nothing to do or if the display is disabled.
+ */
+void screen_task();
+
+/**
+ * @brief Cycle to the next screen mode, shown at the next refresh.
+ */
+void screen_next_mode();
+
+/**
+ * @brief Turn the display on or off.
+ * @param enable True to turn it on.
+ *
+ * When off, the panel is put to sleep and no refresh is done at all.
+ */
+void screen_enable(bool enable);
+
+#endif // SCREEN_H
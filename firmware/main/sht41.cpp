@@ -6,10 +6,29 @@
  */
 
 #include "sht41.h"
+#include "i2cBus.h"
 #include <Arduino.h>
-#include <Wire.h>
 #include <math.h>
 
+// Measurement state machine
+enum sht41State {
+    STATE_IDLE,       // Nothing to do
+    STATE_COMMAND,    // Measure command queued on the bus
+    STATE_CONVERTING, // Waiting for the conversion
+    STATE_READING,    // Read of the result queued on the bus
+    STATE_READY       // Result or error available
+};
+
+static enum sht41State state = STATE_IDLE;
+static struct I2cTransaction transaction;
+static uint8_t buffer[SHT41_RD_LEN];
+static SHT41_Status result = SHT41_OK;
+static uint32_t commandDoneUs = 0;
+
+// Periodic measurement
+static uint32_t lastStartMs = 0;
+static TempHumMeasurement latest = { 0, 0, SHT41_ERR_MEASUREMENT };
+
  // CRC-8 polynomial: x^8 + x^5 + x^4 + 1 (0x31)
 uint8_t crc8(const uint8_t* data, int len) {
     uint8_t crc = 0xFF;
@@ -22,27 +41,82 @@ uint8_t crc8(const uint8_t* data, int len) {
     return crc;
 }
 
-// Read temperature and humidity from sensor
-TempHumMeasurement sht41_read_temp_humidity(void) {
-    TempHumMeasurement tempHum = { 0, 0, SHT41_OK };
+bool sht41_start(void) {
+    if (state != STATE_IDLE) {
+        return false;
+    }
 
-    Wire.beginTransmission(SHT41_ADDR);
-    Wire.write(SHT41_CMD_MEASURE);
-    if (Wire.endTransmission() != 0) {
-        tempHum.status = SHT41_ERR_I2C;
-        return tempHum;
+    i2cbus_prepare(&transaction, SHT41_ADDR, I2C_PRIORITY_NORMAL);
+    transaction.header[0] = SHT41_CMD_MEASURE;
+    transaction.headerLen = 1;
+    if (i2cbus_submit(&transaction) == false) {
+        return false;
+    }
+
+    state = STATE_COMMAND;
+    return true;
+}
+
+SHT41_PollStatus sht41_poll(void) {
+    switch (state) {
+    case STATE_IDLE:
+        return SHT41_IDLE;
+
+    case STATE_COMMAND:
+        if (transaction.status == I2C_PENDING) {
+            return SHT41_PENDING;
+        }
+        if (transaction.status != I2C_OK) {
+            result = SHT41_ERR_I2C;
+            state = STATE_READY;
+            return SHT41_READY;
+        }
+        // The conversion started at the end of the command, now at the latest
+        commandDoneUs = micros();
+        state = STATE_CONVERTING;
+        return SHT41_PENDING;
+
+    case STATE_CONVERTING:
+        if (micros() - commandDoneUs < SHT41_MEAS_TIME_US) {
+            return SHT41_PENDING;
+        }
+        i2cbus_prepare(&transaction, SHT41_ADDR, I2C_PRIORITY_NORMAL);
+        transaction.rxData = buffer;
+        transaction.rxLen = SHT41_RD_LEN;
+        if (i2cbus_submit(&transaction) == false) {
+            result = SHT41_ERR_I2C;
+            state = STATE_READY;
+            return SHT41_READY;
+        }
+        state = STATE_READING;
+        return SHT41_PENDING;
+
+    case STATE_READING:
+        if (transaction.status == I2C_PENDING) {
+            return SHT41_PENDING;
+        }
+        result = (transaction.status == I2C_OK) ? SHT41_OK : SHT41_ERR_MEASUREMENT;
+        state = STATE_READY;
+        return SHT41_READY;
+
+    case STATE_READY:
+    default:
+        return SHT41_READY;
     }
+}
 
-    delay(85);  // Delay for maximum measurement time
+TempHumMeasurement sht41_get_result(void) {
+    TempHumMeasurement tempHum = { 0, 0, SHT41_OK };
 
-    if (Wire.requestFrom(SHT41_ADDR, SHT41_RD_LEN) != SHT41_RD_LEN) {
+    if (state != STATE_READY) {
         tempHum.status = SHT41_ERR_MEASUREMENT;
         return tempHum;
     }
+    state = STATE_IDLE;
 
-    uint8_t buffer[SHT41_RD_LEN];
-    for (int i = 0; i < SHT41_RD_LEN; i++) {
-        buffer[i] = Wire.read();
+    if (result != SHT41_OK) {
+        tempHum.status = result;
+        return tempHum;
     }
 
     // Validate CRC
@@ -59,6 +133,26 @@ TempHumMeasurement sht41_read_temp_humidity(void) {
     return tempHum;
 }
 
+void sht41_task(void) {
+    switch (sht41_poll()) {
+    case SHT41_IDLE:
+        if (millis() - lastStartMs >= SHT41_RD_PERIOD * 1000UL) {
+            lastStartMs = millis();
+            sht41_start();
+        }
+        break;
+    case SHT41_READY:
+        latest = sht41_get_result();
+        break;
+    default:
+        break;
+    }
+}
+
+TempHumMeasurement sht41_get_latest(void) {
+    return latest;
+}
+
 void sht41_calculate(uint16_t rawTemperature, uint16_t rawHumidity, TempHumMeasurement* measurement) {
     measurement->temperature = -45 + 175 * rawTemperature / 65535.0;
     measurement->humidity = -6 + 125 * rawHumidity / 65535.0;
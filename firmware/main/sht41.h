@@ -18,6 +18,7 @@
 #define SHT41_ADDR          0x44 // SHT41 I2C address
 #define SHT41_CMD_MEASURE   0xFD // measurement command for temperature, high precision
 #define SHT41_RD_PERIOD     1    // periodic read interval [s]
+#define SHT41_MEAS_TIME_US  9000 // max measurement duration, high precision (8.3 ms)
 
 typedef enum {
     SHT41_OK = 0,
@@ -26,6 +27,12 @@ typedef enum {
     SHT41_ERR_MEASUREMENT = 3
 } SHT41_Status;
 
+typedef enum {
+    SHT41_IDLE = 0,             // No measurement started
+    SHT41_PENDING = 1,          // Measurement or transfer in progress
+    SHT41_READY = 2             // Result available with sht41_get_result()
+} SHT41_PollStatus;
+
 
 struct TempHumMeasurement {
     float temperature;          // Temperature in C
@@ -33,8 +40,20 @@ struct TempHumMeasurement {
     SHT41_Status status;        // Error status
 };
 
-// Read temperature and humidity temperature
-TempHumMeasurement sht41_read_temp_humidity(void);
+// Send the measure command, returns false if a measurement is already running
+bool sht41_start(void);
+
+// Advance the measurement without blocking, the i2c engine must be running
+SHT41_PollStatus sht41_poll(void);
+
+// Get the result of a READY measurement, CRC checked, and go back to IDLE
+TempHumMeasurement sht41_get_result(void);
+
+// Periodic measurement every SHT41_RD_PERIOD seconds, to be called from loop()
+void sht41_task(void);
+
+// Last result of the periodic measurement, returned by MEASure:SHT41?
+TempHumMeasurement sht41_get_latest(void);
 
 // Calculate temperature and humidity from raw data
 void sht41_calculate(uint16_t rawTemperature, uint16_t rawHumidity, TempHumMeasurement* measurement);
@@ -5,6 +5,7 @@
  */
 
 #include "ssd1306.h"
+#include "i2cBus.h"
 
 #include <Wire.h>
 #include <Adafruit_GFX.h>
@@ -15,6 +16,77 @@ char *dtostrf (double val, signed char width, unsigned char prec, char *sout);
 
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 
+/**
+ * @brief Position and content of a text field.
+ */
+struct screenField {
+    int16_t x;       //!< Left border [px]
+    int16_t y;       //!< Top border [px]
+    uint8_t size;    //!< Text size, characters are 6*size x 8*size pixels
+    char text[SSD1306_FIELD_LEN]; //!< Text currently in the framebuffer
+};
+
+static struct screenField fields[FIELD_COUNT] = {
+    {0,  0, 2, ""}, // FIELD_TITLE
+    {0, 20, 2, ""}, // FIELD_VALUE
+    {0, 40, 1, ""}, // FIELD_ENV
+    {0, 54, 1, ""}  // FIELD_MODE
+};
+
+// Dirty column range of each page. dirtyStart > dirtyEnd means clean page
+static uint8_t dirtyStart[SCREEN_PAGES];
+static uint8_t dirtyEnd[SCREEN_PAGES];
+
+static struct Ssd1306Stats stats = {0, 0, 0, 0, 0};
+static uint32_t updateBytes = 0;
+
+// Bus time of the page transactions not all done yet. Should an update be
+// flushed before the previous one is done, both are counted as one
+static uint8_t flushPending = 0;
+static uint32_t flushBusUs = 0;
+
+// Flush of each page: window command and data
+static struct I2cTransaction pageTransactions[SCREEN_PAGES][2];
+static struct I2cTransaction powerTransaction;
+
+/**
+ * @brief Mark a rectangle of the framebuffer as dirty.
+ */
+static void markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (w <= 0 || h <= 0) return;
+
+    int16_t x1 = min(x + w - 1, SCREEN_WIDTH - 1);
+    int16_t y1 = min(y + h - 1, SCREEN_HEIGHT - 1);
+    for (int16_t page = y / 8; page <= y1 / 8; page++) {
+        if (dirtyStart[page] > dirtyEnd[page]) {
+            dirtyStart[page] = x;
+            dirtyEnd[page] = x1;
+        } else {
+            dirtyStart[page] = min((int16_t)dirtyStart[page], x);
+            dirtyEnd[page] = max((int16_t)dirtyEnd[page], x1);
+        }
+    }
+}
+
+/**
+ * @brief Completion of a page transaction, adds its time on the bus.
+ */
+static void pageDone(struct I2cTransaction* transaction) {
+    flushBusUs += transaction->endUs - transaction->startUs;
+    if (--flushPending == 0) {
+        stats.lastUs = flushBusUs;
+        stats.maxUs = max(stats.maxUs, stats.lastUs);
+        flushBusUs = 0;
+    }
+}
+
+static void clearDirty() {
+    for (uint8_t page = 0; page < SCREEN_PAGES; page++) {
+        dirtyStart[page] = SCREEN_WIDTH - 1;
+        dirtyEnd[page] = 0;
+    }
+}
+
 void ssd1306_init() {
     if (!display.begin(SSD1306_SWITCHCAPVCC, SSD1306_ADDR)) {
         Serial.println(F("SSD1306 allocation failed"));
@@ -22,49 +94,148 @@ void ssd1306_init() {
     }
     delay(2000);
     display.clearDisplay();
+    display.display();
     display.setTextColor(WHITE);
+    // A field must never spill over the others
+    display.setTextWrap(false);
+    clearDirty();
 }
 
-void ssd1306_print_current_temp_humidity(float current, String current_range, String temp, String humidity) {
+void ssd1306_set_field(enum ScreenField field, const char* text) {
+    struct screenField& f = fields[field];
+    if (strncmp(f.text, text, SSD1306_FIELD_LEN - 1) == 0) {
+        return;
+    }
+
+    // Both the old and the new text area must be refreshed
+    int16_t oldWidth = strlen(f.text) * 6 * f.size;
+    strncpy(f.text, text, SSD1306_FIELD_LEN - 1);
+    f.text[SSD1306_FIELD_LEN - 1] = '\0';
+    int16_t newWidth = strlen(f.text) * 6 * f.size;
+    int16_t width = max(oldWidth, newWidth);
+    int16_t height = 8 * f.size;
+
+    display.fillRect(f.x, f.y, width, height, BLACK);
+    display.setTextSize(f.size);
+    display.setCursor(f.x, f.y);
+    display.print(f.text);
+
+    markDirty(f.x, f.y, width, height);
+}
+
+void ssd1306_clear() {
     display.clearDisplay();
-    display.setTextSize(2);
-    display.setCursor(0, 0);
-    display.print("Current: ");
-    display.setCursor(0, 20);
-    display.print(current);
-    display.print(" " + current_range);
-    display.setCursor(0, 40);
-    display.setTextSize(1);
-    display.print("T: ");
-    display.print(temp);
-    display.print(" H: ");
-    display.print(humidity);
-    display.print(" %");
-    display.setCursor(0, 54);
-    display.print("Mode: Current Display");
-    display.display();
+    for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+        fields[i].text[0] = '\0';
+    }
+    markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+void ssd1306_graph_clear_column(uint8_t x) {
+    display.drawFastVLine(x, GRAPH_TOP, GRAPH_HEIGHT, BLACK);
+    markDirty(x, GRAPH_TOP, 1, GRAPH_HEIGHT);
+}
+
+void ssd1306_graph_column(uint8_t x, int16_t yFrom, int16_t yTo) {
+    yFrom = constrain(yFrom, 0, GRAPH_HEIGHT - 1);
+    yTo = constrain(yTo, 0, GRAPH_HEIGHT - 1);
+    int16_t top = SCREEN_HEIGHT - 1 - max(yFrom, yTo);
+    int16_t length = abs(yTo - yFrom) + 1;
+
+    ssd1306_graph_clear_column(x);
+    display.drawFastVLine(x, top, length, WHITE);
+}
+
+void ssd1306_flush() {
+    uint8_t* buffer = display.getBuffer();
+
+    for (uint8_t page = 0; page < SCREEN_PAGES; page++) {
+        if (dirtyStart[page] > dirtyEnd[page]) continue;
+
+        // Set the window of the transfer, all commands in one transaction
+        struct I2cTransaction* t = &pageTransactions[page][0];
+        i2cbus_prepare(t, SSD1306_ADDR, I2C_PRIORITY_LOW);
+        t->header[0] = 0x00; // Co = 0, D/C = 0: command stream
+        t->header[1] = SSD1306_PAGEADDR;
+        t->header[2] = page;
+        t->header[3] = page;
+        t->header[4] = SSD1306_COLUMNADDR;
+        t->header[5] = dirtyStart[page];
+        t->header[6] = dirtyEnd[page];
+        t->headerLen = 7;
+        t->callback = pageDone;
+        flushPending += i2cbus_submit(t);
+        updateBytes += 8;
+
+        // Send the dirty columns of the page, straight from the framebuffer
+        t = &pageTransactions[page][1];
+        i2cbus_prepare(t, SSD1306_ADDR, I2C_PRIORITY_LOW);
+        t->header[0] = 0x40; // Co = 0, D/C = 1: data stream
+        t->headerLen = 1;
+        t->txData = buffer + page * SCREEN_WIDTH + dirtyStart[page];
+        t->txLen = dirtyEnd[page] - dirtyStart[page] + 1;
+        t->callback = pageDone;
+        flushPending += i2cbus_submit(t);
+        updateBytes += t->txLen + 2;
+    }
+    clearDirty();
+}
+
+bool ssd1306_busy() {
+    for (uint8_t page = 0; page < SCREEN_PAGES; page++) {
+        if (pageTransactions[page][0].status == I2C_PENDING || pageTransactions[page][1].status == I2C_PENDING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ssd1306_power(bool on) {
+    i2cbus_prepare(&powerTransaction, SSD1306_ADDR, I2C_PRIORITY_LOW);
+    powerTransaction.header[0] = 0x00; // Co = 0, D/C = 0: command stream
+    powerTransaction.header[1] = on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF;
+    powerTransaction.headerLen = 2;
+    i2cbus_submit(&powerTransaction);
+}
+
+const struct Ssd1306Stats* ssd1306_get_stats() {
+    return &stats;
+}
+
+void ssd1306_commit() {
+    ssd1306_flush();
+
+    stats.updates++;
+    // The bus time is set when the transfer is done
+    if (flushPending == 0) {
+        stats.lastUs = 0;
+    }
+    stats.lastBytes = updateBytes;
+    stats.totalBytes += updateBytes;
+    updateBytes = 0;
+}
+
+void ssd1306_print_current_temp_humidity(float current, String current_range, String temp, String humidity) {
+
+    ssd1306_set_field(FIELD_TITLE, "Current: ");
+    ssd1306_set_field(FIELD_VALUE, (String(current, 2) + " " + current_range).c_str());
+    ssd1306_set_field(FIELD_ENV, ("T: " + temp + " H: " + humidity + " %").c_str());
+    ssd1306_set_field(FIELD_MODE, "Mode: Current Display");
+
+    ssd1306_commit();
 }
 
 
 void ssd1306_print_charge(float charge, String temp, String humidity, String mode) {
-    display.clearDisplay();
-    display.setTextSize(2);
-    display.setCursor(0, 0);
-    display.print("Charge[fC]");
-    display.setCursor(0, 20);
+
+    ssd1306_set_field(FIELD_TITLE, "Charge[fC]");
     if (charge < 10000) {
-        display.print(charge);
+        ssd1306_set_field(FIELD_VALUE, String(charge, 2).c_str());
     } else {
-        display.print(sci(charge, 3));
+        ssd1306_set_field(FIELD_VALUE, sci(charge, 3));
     }
-    display.setCursor(0, 40);
-    display.setTextSize(1);
-    display.print("T: ");
-    display.print(temp);
-    display.print(" H: ");
-    display.print(humidity);
-    display.print(" %");
-    display.setCursor(0, 54);
-    display.print("Mode: " + mode);
-    display.display();
-}
\ No newline at end of file
+    ssd1306_set_field(FIELD_ENV, ("T: " + temp + " H: " + humidity + " %").c_str());
+    ssd1306_set_field(FIELD_MODE, ("Mode: " + mode).c_str());
+
+    ssd1306_commit();
+}
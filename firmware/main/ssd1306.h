@@ -2,11 +2,21 @@
  * @file ssd1306.h
  * @brief Header file for the SSD1306 OLED display helper functions.
  * @author Mattia Consani, hliverud
- * 
+ *
  * Contains the init function and the print to oled functions.
- * 
+ *
+ * The screen is handled in retained mode: it is divided in text fields and
+ * each field remembers the text currently shown. Only the fields whose text
+ * changed are redrawn in the framebuffer, and only the columns of the pages
+ * touched by the redraw are sent to the display.
+ *
+ * The transfer is queued on the I2C engine straight from the framebuffer, so
+ * nothing must be drawn while ssd1306_busy() is true.
  */
 
+#ifndef SSD1306_H
+#define SSD1306_H
+
 #include <stdint.h>
 #include <Arduino.h>
 #include "config.h"
@@ -19,14 +29,42 @@ enum ScreenMode {
     CHARGE_DETECTION,
     CHARGE_INTEGRATION,
     VAR_SEMPLING_TIME,
-    CURRENT_DISPLAY
+    CURRENT_DISPLAY,
+    CURRENT_TREND
+};
+
+/**
+ * @brief Text fields the screen is divided in.
+ */
+enum ScreenField {
+    FIELD_TITLE, //!< First line, size 2
+    FIELD_VALUE, //!< Second line, size 2
+    FIELD_ENV,   //!< Temperature and humidity, size 1
+    FIELD_MODE,  //!< Last line, size 1
+    FIELD_COUNT
+};
+
+/**
+ * @brief Cost of the screen updates, to keep an eye on the I2C bus usage.
+ */
+struct Ssd1306Stats {
+    uint32_t updates;    //!< Number of screen updates
+    uint32_t lastBytes;  //!< Bytes sent over I2C by the last update, address bytes included
+    uint32_t lastUs;     //!< I2C bus time of the last update, set once all its transactions are done
+    uint32_t maxUs;      //!< Longest I2C bus time of an update
+    uint32_t totalBytes; //!< Bytes sent over I2C since boot
 };
 
 
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels
+#define SCREEN_PAGES (SCREEN_HEIGHT / 8) // 8 pixel rows per page
+
+#define GRAPH_TOP 16 // First row of the graph area, just below the title field
+#define GRAPH_HEIGHT (SCREEN_HEIGHT - GRAPH_TOP)
 
 #define SSD1306_ADDR 0x3C
+#define SSD1306_FIELD_LEN 22 // Max characters per field, 21 fit a size 1 line
 
 void ssd1306_init();
 
@@ -40,4 +78,77 @@ void ssd1306_print_current_temp_humidity(float current, String current_range, St
  * @param humidity The humidity value to print [%].
  * @param mode The current screen mode.
  */
-void ssd1306_print_charge(float charge, String temp, String humidity, String mode);
\ No newline at end of file
+void ssd1306_print_charge(float charge, String temp, String humidity, String mode);
+
+/**
+ * @brief Set the text of a field.
+ * @param field The field to update.
+ * @param text The new text, truncated to SSD1306_FIELD_LEN - 1 characters.
+ *
+ * If the text is the same as the one already shown nothing happens, otherwise
+ * the field is redrawn in the framebuffer and its area marked as dirty.
+ * Nothing is sent to the display until ssd1306_flush() is called.
+ */
+void ssd1306_set_field(enum ScreenField field, const char* text);
+
+/**
+ * @brief Clear the whole screen.
+ *
+ * Used when switching between layouts. All the fields are emptied and the
+ * whole framebuffer is marked dirty.
+ */
+void ssd1306_clear();
+
+/**
+ * @brief Draw one column of the graph area.
+ * @param x The column.
+ * @param yFrom Start of the vertical segment, 0 is the bottom of the graph.
+ * @param yTo End of the vertical segment, 0 is the bottom of the graph.
+ *
+ * The column is cleared before drawing, so a segment from the previous to the
+ * current point gives a continuous line.
+ */
+void ssd1306_graph_column(uint8_t x, int16_t yFrom, int16_t yTo);
+
+/**
+ * @brief Clear one column of the graph area.
+ * @param x The column.
+ */
+void ssd1306_graph_clear_column(uint8_t x);
+
+/**
+ * @brief Send the dirty areas of the framebuffer to the display.
+ *
+ * For each page, only the columns between the first and the last dirty one
+ * are transferred. The transfer is queued at low priority and the function
+ * returns before it is done.
+ */
+void ssd1306_flush();
+
+/**
+ * @brief Check if the last flush is still being transferred.
+ * @return True if the framebuffer must not be touched yet.
+ */
+bool ssd1306_busy();
+
+/**
+ * @brief Close a screen update: flush it and account for its cost.
+ *
+ * Its bus time is the sum of the times on the bus of its transactions, set
+ * in the statistics once they are done.
+ */
+void ssd1306_commit();
+
+/**
+ * @brief Turn the panel on or off.
+ * @param on True to turn it on, false to put it to sleep.
+ */
+void ssd1306_power(bool on);
+
+/**
+ * @brief Get the cost of the screen updates.
+ * @return Pointer to the statistics struct.
+ */
+const struct Ssd1306Stats* ssd1306_get_stats();
+
+#endif // SSD1306_H
@@ -0,0 +1,132 @@
+/**
+ * @file stats.cpp
+ * @brief Source file for the running statistics and Allan deviation.
+ *
+ * Doubles are used throughout: there is no FPU either way, and the sums
+ * run for hours at the frame rate.
+ */
+
+#include "stats.h"
+#include "estimator.h"
+
+// Welford accumulators
+static uint32_t count = 0;
+static double mean = 0;
+static double m2 = 0;
+static float minimum = 0;
+static float maximum = 0;
+static uint16_t period = 0; // Window period of the samples [ms]
+
+/**
+ * @brief A stream of the cascade, the averages of 2^k windows.
+ */
+struct AllanStream {
+    double last[4];   // Last averages, newest last
+    uint8_t filled;   // Valid entries of last, up to 4
+    double pending;   // First half of the next average of level k+1
+    bool hasPending;
+};
+
+static struct AllanStream streams[STATS_ALLAN_LEVELS - 1];
+static double diffSum[STATS_ALLAN_LEVELS];
+static uint32_t diffTerms[STATS_ALLAN_LEVELS];
+
+
+/**
+ * @brief Add an average of 2^level windows to the cascade.
+ */
+static void pushStream(uint8_t level, double value) {
+    struct AllanStream* stream = &streams[level];
+
+    stream->last[0] = stream->last[1];
+    stream->last[1] = stream->last[2];
+    stream->last[2] = stream->last[3];
+    stream->last[3] = value;
+    if (stream->filled < 4) {
+        stream->filled++;
+    }
+
+    // tau = 1 window, consecutive windows
+    if (level == 0 && stream->filled >= 2) {
+        double diff = stream->last[3] - stream->last[2];
+        diffSum[0] += diff * diff;
+        diffTerms[0]++;
+    }
+
+    // tau = 2^(level+1) windows, pairs starting every 2^level windows
+    if (stream->filled == 4) {
+        double diff = ((stream->last[3] + stream->last[2]) - (stream->last[1] + stream->last[0])) / 2;
+        diffSum[level + 1] += diff * diff;
+        diffTerms[level + 1]++;
+    }
+
+    if (!stream->hasPending) {
+        stream->pending = value;
+        stream->hasPending = true;
+        return;
+    }
+    stream->hasPending = false;
+    if (level + 1 < STATS_ALLAN_LEVELS - 1) {
+        pushStream(level + 1, (stream->pending + value) / 2);
+    }
+}
+
+
+void stats_push(const struct rawDataFPGA& frame) {
+    if (!frame.valid) {
+        return;
+    }
+    // The windows of the cascade must all have the same duration
+    if (count > 0 && frame.periodMs != period) {
+        stats_reset();
+    }
+    period = frame.periodMs;
+    float current = estimator_current(frame);
+
+    count++;
+    double delta = current - mean;
+    mean += delta / count;
+    m2 += delta * (current - mean);
+
+    if (count == 1 || current < minimum) {
+        minimum = current;
+    }
+    if (count == 1 || current > maximum) {
+        maximum = current;
+    }
+
+    pushStream(0, current);
+}
+
+void stats_reset() {
+    count = 0;
+    mean = 0;
+    m2 = 0;
+    minimum = 0;
+    maximum = 0;
+
+    for (uint8_t i = 0; i < STATS_ALLAN_LEVELS - 1; i++) {
+        streams[i].filled = 0;
+        streams[i].hasPending = false;
+    }
+    for (uint8_t i = 0; i < STATS_ALLAN_LEVELS; i++) {
+        diffSum[i] = 0;
+        diffTerms[i] = 0;
+    }
+}
+
+void stats_get_summary(struct StatsSummary* summary) {
+    summary->count = count;
+    summary->mean = mean;
+    summary->stdDev = count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    summary->min = minimum;
+    summary->max = maximum;
+}
+
+double stats_get_allan(uint8_t level, uint32_t* terms) {
+    *terms = diffTerms[level];
+    if (diffTerms[level] == 0) {
+        return 0;
+    }
+    return sqrt(diffSum[level] / (2.0 * diffTerms[level]));
+}
@@ -0,0 +1,60 @@
+/**
+ * @file stats.h
+ * @brief Running statistics and Allan deviation of the current.
+ *
+ * Every valid frame adds its current to Welford accumulators (count, mean,
+ * sum of squared deviations) and to an octave cascade for the Allan
+ * deviation, so the noise of the sensor is characterised on the board.
+ *
+ * Level k of the cascade holds the averages of 2^k consecutive windows,
+ * each made from two averages of level k-1. The Allan variance at
+ * tau = 2^k windows is half the mean squared difference of two adjacent
+ * averages of 2^k windows. At tau = 1 window every pair of consecutive
+ * windows is used. At the higher levels the pairs start every 2^(k-1)
+ * windows, half overlapping, from the last four averages of level k-1.
+ * A level takes a few words, whatever the duration: memory is O(log N) and
+ * the cost per sample is constant on average.
+ *
+ * tau is counted in windows, so a change of the integration window period
+ * restarts the statistics.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "fpga.h"
+
+#define STATS_ALLAN_LEVELS 18 // tau up to 2^17 windows, 3.6 h at 100 ms
+
+/**
+ * @brief Running statistics of the current, all in fA.
+ */
+struct StatsSummary {
+    uint32_t count;
+    double mean;
+    double stdDev; //!< Sample standard deviation, 0 below 2 samples
+    float min;
+    float max;
+};
+
+/**
+ * @brief Add the current of a decoded frame.
+ */
+void stats_push(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Clear the statistics and the Allan deviation.
+ */
+void stats_reset();
+
+void stats_get_summary(struct StatsSummary* summary);
+
+/**
+ * @brief Allan deviation at tau = 2^level windows.
+ * @param terms Filled with the number of differences averaged.
+ * @return The deviation [fA], 0 if terms is 0.
+ */
+double stats_get_allan(uint8_t level, uint32_t* terms);
+
+#endif // STATS_H
@@ -0,0 +1,217 @@
+/**
+ * @file sweep.cpp
+ * @brief Source file for the DAC sweep.
+ */
+
+#include "sweep.h"
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "estimator.h"
+
+#define STEP_TOLERANCE 1e-3 // Of a stop on a step, against the rounding [steps]
+
+enum SweepState {
+    SWEEP_IDLE,
+    SWEEP_WRITE,   // Write the DAC of the next step
+    SWEEP_SETTLE,  // Skip the settle windows
+    SWEEP_MEASURE, // Accumulate the measure windows
+    SWEEP_RESTORE  // Write back the configured voltage
+};
+
+struct SweepSettings {
+    uint8_t channel;
+    float start;
+    float stop;
+    float step;
+    uint16_t settle;
+    uint16_t measure;
+};
+
+static struct SweepSettings settings = {2, 0, 1, 0.01, 1, 10}; // Vth1
+static struct SweepSettings active; // Settings of the running sweep
+static enum SweepState state = SWEEP_IDLE;
+
+static struct SweepPoint points[SWEEP_MAX_POINTS];
+static uint16_t completed = 0;
+static uint16_t total = 0;
+static uint16_t windowsLeft = 0;
+
+static_assert(SWEEP_MAX_POINTS * sizeof(struct SweepPoint) <= SWEEP_MAX_BYTES,
+    "The sweep points exceed their RAM budget");
+
+// Welford accumulators of the step
+static uint32_t count = 0;
+static double mean = 0;
+static double m2 = 0;
+static float minimum = 0;
+static float maximum = 0;
+
+
+static uint16_t stepCount(const struct SweepSettings& range) {
+    return (uint16_t)(fabs(range.stop - range.start) / range.step + STEP_TOLERANCE) + 1;
+}
+
+static float stepVoltage(uint16_t index) {
+    float offset = index * active.step;
+    return active.stop >= active.start ? active.start + offset : active.start - offset;
+}
+
+static void writeDac(float voltage) {
+    fpgaWriteParam(FPGA_DAC_VOUTA_ADDR + active.channel, fpga_convert_volt_to_DAC(voltage));
+}
+
+static void accumulate(const struct rawDataFPGA& frame) {
+    float current = estimator_current(frame);
+
+    count++;
+    double delta = current - mean;
+    mean += delta / count;
+    m2 += delta * (current - mean);
+
+    if (count == 1 || current < minimum) {
+        minimum = current;
+    }
+    if (count == 1 || current > maximum) {
+        maximum = current;
+    }
+}
+
+static void storePoint() {
+    struct SweepPoint* point = &points[completed];
+    point->voltage = stepVoltage(completed);
+    point->count = count;
+    point->mean = mean;
+    point->stdDev = count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    point->min = minimum;
+    point->max = maximum;
+    completed++;
+}
+
+/**
+ * @brief Count a window down, the step moving on at the last one.
+ */
+static void pushFrame(const struct rawDataFPGA& frame) {
+    if (state == SWEEP_SETTLE) {
+        if (--windowsLeft == 0) {
+            state = SWEEP_MEASURE;
+            windowsLeft = active.measure;
+        }
+    } else if (state == SWEEP_MEASURE) {
+        if (frame.valid) {
+            accumulate(frame);
+        }
+        if (--windowsLeft == 0) {
+            storePoint();
+            state = completed < total ? SWEEP_WRITE : SWEEP_RESTORE;
+        }
+    }
+}
+
+
+bool sweep_set_channel(uint8_t channel) {
+    if (channel >= SWEEP_CHANNEL_COUNT) {
+        return false;
+    }
+    settings.channel = channel;
+    return true;
+}
+
+uint8_t sweep_get_channel() {
+    return settings.channel;
+}
+
+bool sweep_set_range(float start, float stop, float step) {
+    if (!(start >= 0 && start <= REF_VOLTAGE && stop >= 0 && stop <= REF_VOLTAGE && step > 0)) {
+        return false;
+    }
+    if (fabs(stop - start) / step + STEP_TOLERANCE >= SWEEP_MAX_POINTS) {
+        return false;
+    }
+
+    settings.start = start;
+    settings.stop = stop;
+    settings.step = step;
+    return true;
+}
+
+void sweep_get_range(float* start, float* stop, float* step) {
+    *start = settings.start;
+    *stop = settings.stop;
+    *step = settings.step;
+}
+
+bool sweep_set_windows(uint32_t settle, uint32_t measure) {
+    if (measure == 0 || measure > SWEEP_MAX_WINDOWS || settle > SWEEP_MAX_WINDOWS) {
+        return false;
+    }
+    settings.settle = settle;
+    settings.measure = measure;
+    return true;
+}
+
+void sweep_get_windows(uint16_t* settle, uint16_t* measure) {
+    *settle = settings.settle;
+    *measure = settings.measure;
+}
+
+uint16_t sweep_steps() {
+    return stepCount(settings);
+}
+
+void sweep_start() {
+    if (state != SWEEP_IDLE) {
+        writeDac(conf.dac[active.channel]);
+    }
+    active = settings;
+    total = stepCount(active);
+    completed = 0;
+    state = SWEEP_WRITE;
+}
+
+void sweep_abort() {
+    if (state == SWEEP_IDLE) {
+        return;
+    }
+    writeDac(conf.dac[active.channel]);
+    state = SWEEP_IDLE;
+}
+
+bool sweep_running() {
+    return state != SWEEP_IDLE;
+}
+
+uint16_t sweep_count() {
+    return completed;
+}
+
+struct SweepPoint sweep_get(uint16_t index) {
+    return points[index];
+}
+
+void sweep_task() {
+    struct rawDataFPGA frame;
+    while (fpgaFrameQueue.pop(FPGA_READER_SWEEP, frame)) {
+        pushFrame(frame);
+    }
+
+    if (state == SWEEP_WRITE) {
+        writeDac(stepVoltage(completed));
+        // The frames queued meanwhile were integrated before the write
+        while (fpgaFrameQueue.pop(FPGA_READER_SWEEP, frame));
+
+        count = 0;
+        mean = 0;
+        m2 = 0;
+        if (active.settle > 0) {
+            state = SWEEP_SETTLE;
+            windowsLeft = active.settle;
+        } else {
+            state = SWEEP_MEASURE;
+            windowsLeft = active.measure;
+        }
+    } else if (state == SWEEP_RESTORE) {
+        writeDac(conf.dac[active.channel]);
+        state = SWEEP_IDLE;
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file sweep.h
+ * @brief On-device sweep of a DAC output, for the threshold characterisation.
+ *
+ * A sweep steps one DAC channel from a start to a stop voltage. At each step
+ * only that DAC register is written to the FPGA, the next settle windows are
+ * skipped and the current of the next measure windows is accumulated into
+ * one point: count, mean, standard deviation, min and max. The points are
+ * kept in RAM and read back at once, so a sweep takes about the sum of its
+ * windows instead of a host round trip and a full parameter update per step.
+ *
+ * The sweep drives the FPGA register directly, conf.dac is not modified: the
+ * configured voltage is written back when the sweep completes or is aborted.
+ * The settings are taken at the start, changing them during a sweep applies
+ * to the next one.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define SWEEP_MAX_POINTS 128 // Steps of a sweep
+#define SWEEP_MAX_BYTES 3072 // RAM budget of the points
+#define SWEEP_MAX_WINDOWS 1000 // Settle or measure windows of a step
+#define SWEEP_CHANNEL_COUNT 8 // DAC outputs A to H
+
+/**
+ * @brief Result of a step, the current in fA.
+ */
+struct SweepPoint {
+    float voltage; //!< DAC output [V]
+    uint32_t count; //!< Valid frames measured
+    float mean;
+    float stdDev; //!< Sample standard deviation, 0 below 2 frames
+    float min;
+    float max;
+};
+
+/**
+ * @brief Select the DAC output to sweep.
+ * @return False if out of 0..SWEEP_CHANNEL_COUNT - 1.
+ */
+bool sweep_set_channel(uint8_t channel);
+
+uint8_t sweep_get_channel();
+
+/**
+ * @brief Set the voltages, from start towards stop by steps of step.
+ * @return False if a voltage is out of 0..REF_VOLTAGE, the step not
+ * positive or the steps more than SWEEP_MAX_POINTS.
+ *
+ * The last step is the last one not past stop.
+ */
+bool sweep_set_range(float start, float stop, float step);
+
+void sweep_get_range(float* start, float* stop, float* step);
+
+/**
+ * @brief Set the windows skipped and measured at each step.
+ * @return False if measure is 0 or one is above SWEEP_MAX_WINDOWS.
+ */
+bool sweep_set_windows(uint32_t settle, uint32_t measure);
+
+void sweep_get_windows(uint16_t* settle, uint16_t* measure);
+
+/**
+ * @brief Number of steps of the configured range.
+ */
+uint16_t sweep_steps();
+
+/**
+ * @brief Start a sweep, dropping the points of the previous one.
+ */
+void sweep_start();
+
+/**
+ * @brief Stop the sweep and restore the configured voltage, the points
+ * completed so far are kept.
+ */
+void sweep_abort();
+
+/**
+ * @brief True until the last step is measured.
+ */
+bool sweep_running();
+
+/**
+ * @brief Number of points completed.
+ */
+uint16_t sweep_count();
+
+/**
+ * @brief A completed point, first step first.
+ */
+struct SweepPoint sweep_get(uint16_t index);
+
+/**
+ * @brief Measure the new frames and write the DAC at each step.
+ *
+ * Drains FPGA_READER_SWEEP, also when no sweep is running. The DAC is
+ * written with fpgaWriteParam(), which does not wait for the FPGA.
+ */
+void sweep_task();
+
+#endif // SWEEP_H
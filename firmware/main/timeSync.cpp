@@ -0,0 +1,214 @@
+/**
+ * @file timeSync.cpp
+ * @brief Source file for the host-to-device clock synchronisation.
+ */
+
+#include "timeSync.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+// Drift estimates above this value are considered nonsense and clamped
+#define TIMESYNC_MAX_DRIFT_PPB 1000000
+// Minimum time span of the exchanges before trusting the drift estimate
+#define TIMESYNC_MIN_DRIFT_SPAN_US 1000000
+
+/**
+ * @brief One processed exchange.
+ */
+struct syncSample {
+    uint64_t localUs; //!< Local time at the middle of the exchange
+    int64_t offsetUs; //!< Measured offset (host - local)
+    uint32_t delayUs; //!< Round trip delay, without the device processing time
+};
+
+static struct syncSample samples[TIMESYNC_WINDOW];
+static uint8_t sampleCount = 0;
+static uint8_t sampleHead = 0;
+
+// Target model: offset(t) = modelOffsetUs + (t - modelRefUs) * modelDriftPpb
+static uint64_t modelRefUs = 0;
+static int64_t modelOffsetUs = 0;
+static int32_t modelDriftPpb = 0;
+
+// Offset actually applied to the time base, converging to the model
+static int64_t appliedOffsetUs = 0;
+static uint64_t lastSlewUs = 0;
+
+static bool synced = false;
+static uint32_t lastDelayUs = 0;
+static uint32_t residualUs = 0;
+static uint8_t fitSamples = 0;
+
+
+uint64_t timesync_local_us() {
+    static uint32_t lastMicros = 0;
+    static uint32_t wraps = 0;
+
+    uint32_t now = micros();
+    if (now < lastMicros) {
+        wraps++;
+    }
+    lastMicros = now;
+
+    return ((uint64_t)wraps << 32) | now;
+}
+
+/**
+ * @brief Evaluate the target offset at a given local time.
+ */
+static int64_t modelOffsetAt(uint64_t localUs) {
+    int64_t dt = (int64_t)(localUs - modelRefUs);
+    return modelOffsetUs + (dt * modelDriftPpb) / 1000000000LL;
+}
+
+uint64_t timesync_now_us() {
+    return timesync_local_us() + appliedOffsetUs;
+}
+
+void timesync_task() {
+    uint64_t local = timesync_local_us();
+    if (!synced) {
+        return;
+    }
+
+    int64_t error = modelOffsetAt(local) - appliedOffsetUs;
+    if (error != 0) {
+        int64_t maxStep = (int64_t)((local - lastSlewUs) * TIMESYNC_MAX_SLEW_PPM / 1000000);
+        // Let the elapsed time accumulate until at least 1us can be slewed
+        if (maxStep == 0) {
+            return;
+        }
+        if (error > maxStep) {
+            error = maxStep;
+        } else if (error < -maxStep) {
+            error = -maxStep;
+        }
+        appliedOffsetUs += error;
+    }
+    lastSlewUs = local;
+}
+
+/**
+ * @brief Fit offset and drift over the stored exchanges.
+ *
+ * Exchanges with a delay much larger than the fastest one have most likely
+ * been delayed asymmetrically (USB scheduling, busy loop), so they are left
+ * out of the fit.
+ */
+static void fitModel() {
+    uint32_t minDelay = UINT32_MAX;
+    for (uint8_t i = 0; i < sampleCount; i++) {
+        if (samples[i].delayUs < minDelay) {
+            minDelay = samples[i].delayUs;
+        }
+    }
+
+    // Newest sample is the reference, keeps the doubles small
+    const struct syncSample& ref = samples[(sampleHead + TIMESYNC_WINDOW - 1) % TIMESYNC_WINDOW];
+
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    double minX = 0;
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < sampleCount; i++) {
+        if (samples[i].delayUs > minDelay + TIMESYNC_DELAY_MARGIN_US) {
+            continue;
+        }
+        double x = (double)(int64_t)(samples[i].localUs - ref.localUs);
+        double y = (double)(samples[i].offsetUs - ref.offsetUs);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        if (x < minX) {
+            minX = x;
+        }
+        n++;
+    }
+
+    double slope = modelDriftPpb * 1e-9;
+    double denominator = n * sumXX - sumX * sumX;
+    if (n >= 2 && -minX >= TIMESYNC_MIN_DRIFT_SPAN_US && denominator > 0) {
+        slope = (n * sumXY - sumX * sumY) / denominator;
+    }
+    if (slope * 1e9 > TIMESYNC_MAX_DRIFT_PPB) {
+        slope = TIMESYNC_MAX_DRIFT_PPB * 1e-9;
+    } else if (slope * 1e9 < -TIMESYNC_MAX_DRIFT_PPB) {
+        slope = -TIMESYNC_MAX_DRIFT_PPB * 1e-9;
+    }
+    double intercept = (sumY - slope * sumX) / n;
+
+    // RMS residual of the accepted exchanges
+    double sumRes = 0;
+    for (uint8_t i = 0; i < sampleCount; i++) {
+        if (samples[i].delayUs > minDelay + TIMESYNC_DELAY_MARGIN_US) {
+            continue;
+        }
+        double x = (double)(int64_t)(samples[i].localUs - ref.localUs);
+        double y = (double)(samples[i].offsetUs - ref.offsetUs);
+        double res = y - (intercept + slope * x);
+        sumRes += res * res;
+    }
+
+    modelRefUs = ref.localUs;
+    modelOffsetUs = ref.offsetUs + (int64_t)llround(intercept);
+    modelDriftPpb = (int32_t)lround(slope * 1e9);
+    residualUs = (uint32_t)lround(sqrt(sumRes / n));
+    fitSamples = n;
+}
+
+bool timesync_add_exchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    if (t4 < t1 || t3 < t2) {
+        return false;
+    }
+    int64_t delay = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+    if (delay < 0 || delay > UINT32_MAX) {
+        return false;
+    }
+
+    struct syncSample& sample = samples[sampleHead];
+    sample.localUs = t2 + (t3 - t2) / 2;
+    sample.offsetUs = ((int64_t)(t1 - t2) + (int64_t)(t4 - t3)) / 2;
+    sample.delayUs = (uint32_t)delay;
+
+    sampleHead = (sampleHead + 1) % TIMESYNC_WINDOW;
+    if (sampleCount < TIMESYNC_WINDOW) {
+        sampleCount++;
+    }
+    lastDelayUs = sample.delayUs;
+
+    fitModel();
+
+    // First exchange or too large error: step the clock instead of slewing
+    uint64_t local = timesync_local_us();
+    int64_t error = modelOffsetAt(local) - appliedOffsetUs;
+    if (!synced || error > TIMESYNC_STEP_THRESHOLD_US || error < -TIMESYNC_STEP_THRESHOLD_US) {
+        appliedOffsetUs = modelOffsetAt(local);
+        lastSlewUs = local;
+        synced = true;
+    }
+
+    return true;
+}
+
+void timesync_reset() {
+    sampleCount = 0;
+    sampleHead = 0;
+    modelRefUs = 0;
+    modelOffsetUs = 0;
+    modelDriftPpb = 0;
+    appliedOffsetUs = 0;
+    synced = false;
+    lastDelayUs = 0;
+    residualUs = 0;
+    fitSamples = 0;
+}
+
+void timesync_get_status(struct TimeSyncStatus* status) {
+    status->synced = synced;
+    status->offsetUs = appliedOffsetUs;
+    status->driftPpb = modelDriftPpb;
+    status->delayUs = lastDelayUs;
+    status->residualUs = residualUs;
+    status->samples = fitSamples;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file timeSync.h
+ * @brief Host-to-device clock synchronisation.
+ *
+ * The host periodically runs an NTP-like exchange over SCPI:
+ * 1. Host stamps t1 (host clock) and sends SYSTem:TIME:PROBe? <t1>
+ * 2. Device answers with t2 (reception) and t3 (transmission), local clock
+ * 3. Host stamps t4 (host clock) on reception and sends back all four stamps
+ *    with SYSTem:TIME:SYNC <t1>,<t2>,<t3>,<t4>
+ *
+ * From each exchange the device computes the offset and the round trip delay.
+ * A least-squares fit over the last TIMESYNC_WINDOW exchanges gives offset and
+ * drift of the local clock. The correction is not stepped but slewed into the
+ * time base at most at TIMESYNC_MAX_SLEW_PPM by timesync_task(), so frame
+ * timestamps stay monotonic. Only a large error (or the very first exchange)
+ * steps the clock.
+ *
+ * All the times are in microseconds. Host times are expected to be referred
+ * to the Unix epoch.
+ */
+
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <stdint.h>
+
+#define TIMESYNC_WINDOW 8             //!< Number of exchanges used for the offset/drift fit
+#define TIMESYNC_DELAY_MARGIN_US 500  //!< Exchanges slower than the fastest one plus this margin are discarded
+#define TIMESYNC_MAX_SLEW_PPM 500     //!< Maximum rate at which the correction is applied
+#define TIMESYNC_STEP_THRESHOLD_US 128000 //!< Errors larger than this are stepped, not slewed
+
+/**
+ * @brief Synchronisation quality report.
+ */
+struct TimeSyncStatus {
+    bool synced;        //!< True once at least one valid exchange was processed
+    int64_t offsetUs;   //!< Currently applied offset (host - local)
+    int32_t driftPpb;   //!< Estimated drift of the local clock w.r.t. host
+    uint32_t delayUs;   //!< Round trip delay of the last accepted exchange
+    uint32_t residualUs; //!< RMS residual of the offset fit
+    uint8_t samples;    //!< Number of exchanges used by the fit
+};
+
+/**
+ * @brief Local monotonic time, 64-bit extension of micros().
+ * @return Microseconds since boot.
+ *
+ * @warning Must be called at least once every ~71 minutes to catch the
+ * micros() wrap-around. Not safe to call from an ISR.
+ */
+uint64_t timesync_local_us();
+
+/**
+ * @brief Host-synchronised time.
+ * @return Local time corrected with the offset slewed so far.
+ *
+ * Before the first exchange it is equal to timesync_local_us(). It does not
+ * modify the correction, reading it twice gives the same offset.
+ */
+uint64_t timesync_now_us();
+
+/**
+ * @brief Slew the applied offset towards the offset and drift estimate.
+ *
+ * To be called periodically. The step is bounded by TIMESYNC_MAX_SLEW_PPM
+ * of the time elapsed since the last step, so the period only sets its
+ * granularity. Also keeps track of the micros() wrap-around.
+ */
+void timesync_task();
+
+/**
+ * @brief Process a complete exchange.
+ * @param t1 Host time at probe transmission.
+ * @param t2 Local time at probe reception.
+ * @param t3 Local time at reply transmission.
+ * @param t4 Host time at reply reception.
+ * @return False if the exchange is inconsistent and has been discarded.
+ */
+bool timesync_add_exchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+
+/**
+ * @brief Forget all the exchanges and go back to the free-running clock.
+ */
+void timesync_reset();
+
+/**
+ * @brief Get the synchronisation quality.
+ * @param status Struct filled with the current state.
+ */
+void timesync_get_status(struct TimeSyncStatus* status);
+
+#endif // TIMESYNC_H
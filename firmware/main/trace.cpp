@@ -0,0 +1,81 @@
+/**
+ * @file trace.cpp
+ * @brief Source file for the capture of raw FPGA frames.
+ */
+
+#include "trace.h"
+#include "scpiDispatch.h"
+
+struct TraceRecord {
+    uint64_t timestamp;
+    uint8_t payload[FPGA_UART_FRAME_LENGTH];
+};
+
+static_assert(TRACE_MAX_POINTS * sizeof(struct TraceRecord) <= TRACE_MAX_BYTES,
+              "Trace buffer exceeds its RAM budget");
+
+static struct TraceRecord records[TRACE_MAX_POINTS];
+static uint16_t points = TRACE_MAX_POINTS; // Frames of the next capture
+static uint16_t target = 0;                // Frames of the current capture
+static uint16_t count = 0;                 // Frames captured
+static bool running = false;
+
+
+bool trace_set_points(uint16_t newPoints) {
+    if (newPoints < 1 || newPoints > TRACE_MAX_POINTS) {
+        return false;
+    }
+    points = newPoints;
+    return true;
+}
+
+uint16_t trace_get_points() {
+    return points;
+}
+
+void trace_initiate() {
+    target = points;
+    count = 0;
+    running = true;
+}
+
+void trace_abort() {
+    running = false;
+}
+
+bool trace_running() {
+    return running;
+}
+
+uint16_t trace_count() {
+    return count;
+}
+
+void trace_capture(const uint8_t* payload, uint64_t timestamp) {
+    if (!running) {
+        return;
+    }
+
+    records[count].timestamp = timestamp;
+    memcpy(records[count].payload, payload, FPGA_UART_FRAME_LENGTH);
+    count++;
+
+    if (count == target) {
+        running = false;
+    }
+}
+
+void trace_write_block(Stream& interface) {
+    // The records below count are complete, a running capture only adds more
+    uint16_t frames = count;
+    uint32_t length = (uint32_t)frames * TRACE_RECORD_LENGTH;
+
+    scpi_write_block_header(interface, length);
+
+    // The M0+ is little endian, the timestamp is written as it is stored
+    for (uint16_t i = 0; i < frames; i++) {
+        interface.write((const uint8_t*)&records[i].timestamp, sizeof(records[i].timestamp));
+        interface.write(records[i].payload, FPGA_UART_FRAME_LENGTH);
+    }
+    interface.println();
+}
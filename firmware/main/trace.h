@@ -0,0 +1,68 @@
+/**
+ * @file trace.h
+ * @brief On-device capture of consecutive raw FPGA frames.
+ *
+ * Once initiated, the next TRACe:POINts frames are copied as received, with
+ * their timestamp, into a statically reserved buffer. Nothing is decoded or
+ * printed during the capture, so a burst faster than the serial output is
+ * kept whole and downloaded afterwards as a binary block.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "fpga.h"
+
+#define TRACE_MAX_POINTS 64 // Frames in the buffer, 40 bytes each
+#define TRACE_MAX_BYTES 2560 // RAM budget of the buffer
+#define TRACE_RECORD_LENGTH (8 + FPGA_UART_FRAME_LENGTH) // Bytes of a frame in the binary block
+
+/**
+ * @brief Set the number of frames of the next capture.
+ * @return False if out of 1..TRACE_MAX_POINTS.
+ */
+bool trace_set_points(uint16_t points);
+
+uint16_t trace_get_points();
+
+/**
+ * @brief Start a capture, dropping the previous one.
+ */
+void trace_initiate();
+
+/**
+ * @brief Stop the capture, the frames captured so far are kept.
+ */
+void trace_abort();
+
+/**
+ * @brief True while frames are being captured.
+ */
+bool trace_running();
+
+/**
+ * @brief Number of frames captured.
+ */
+uint16_t trace_count();
+
+/**
+ * @brief Store a received frame if a capture is running.
+ * @param payload The FPGA_UART_FRAME_LENGTH bytes following the start byte.
+ * @param timestamp Reception time of the frame [us]
+ *
+ * Called by the frame parser, on every complete frame.
+ */
+void trace_capture(const uint8_t* payload, uint64_t timestamp);
+
+/**
+ * @brief Write the captured frames as an IEEE 488.2 definite length block.
+ *
+ * The block is "#<digits><length>" followed by TRACE_RECORD_LENGTH bytes per
+ * frame: the timestamp [us], 8 bytes little endian, then the frame bytes as
+ * sent by the FPGA.
+ */
+void trace_write_block(Stream& interface);
+
+#endif // TRACE_H
@@ -0,0 +1,49 @@
+/**
+ * @file trend.cpp
+ * @brief Source file for the trend ring buffer.
+ */
+
+#include "trend.h"
+
+static float points[TREND_POINTS];
+static uint32_t pointCount = 0;
+
+// Decimation accumulator
+static float decimationSum = 0;
+static uint8_t decimationCount = 0;
+
+
+void trend_push(float current) {
+    decimationSum += current;
+    decimationCount++;
+
+    if (decimationCount == TREND_DECIMATION) {
+        points[pointCount % TREND_POINTS] = decimationSum / TREND_DECIMATION;
+        pointCount++;
+        decimationSum = 0;
+        decimationCount = 0;
+    }
+}
+
+uint32_t trend_count() {
+    return pointCount;
+}
+
+float trend_get(uint32_t index) {
+    return points[index % TREND_POINTS];
+}
+
+bool trend_range(float* min, float* max) {
+    if (pointCount == 0) {
+        return false;
+    }
+
+    uint32_t stored = pointCount < TREND_POINTS ? pointCount : TREND_POINTS;
+    *min = points[0];
+    *max = points[0];
+    for (uint32_t i = 1; i < stored; i++) {
+        if (points[i] < *min) *min = points[i];
+        if (points[i] > *max) *max = points[i];
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file trend.h
+ * @brief Fixed ring buffer of decimated current samples for the trend graph.
+ *
+ * Every TREND_DECIMATION samples are averaged into one point. The last
+ * TREND_POINTS points are kept, one per screen column. Points are addressed
+ * with their absolute index since boot, so the reader can tell which ones
+ * are new since its last look.
+ */
+
+#ifndef TREND_H
+#define TREND_H
+
+#include <stdint.h>
+#include "ssd1306.h"
+
+#define TREND_POINTS SCREEN_WIDTH // One point per column
+#define TREND_DECIMATION 10       // Samples averaged in one point
+
+/**
+ * @brief Add a sample to the trend.
+ * @param current The current sample [fA]
+ */
+void trend_push(float current);
+
+/**
+ * @brief Number of points produced since boot.
+ * @return Absolute index of the next point.
+ */
+uint32_t trend_count();
+
+/**
+ * @brief Get a point.
+ * @param index Absolute index, must be within the last TREND_POINTS points.
+ * @return The averaged current [fA]
+ */
+float trend_get(uint32_t index);
+
+/**
+ * @brief Minimum and maximum of the stored points.
+ * @param min Filled with the minimum [fA]
+ * @param max Filled with the maximum [fA]
+ * @return False if there are no points yet.
+ */
+bool trend_range(float* min, float* max);
+
+#endif // TREND_H
@@ -0,0 +1,241 @@
+/**
+ * @file trigger.cpp
+ * @brief Source file for the trigger engine.
+ *
+ * The engine runs in the main loop only, from the frame output task, and the
+ * events are read from the SCPI task: no locking is needed.
+ */
+
+#include "trigger.h"
+#include "estimator.h"
+
+// Configuration
+static bool enabled = false;
+static enum TriggerSource source = TRIGGER_SOURCE_CURRENT;
+static enum TriggerType type = TRIGGER_TYPE_EDGE;
+static bool positive = true;
+static float level = 0;
+static float windowLow = 0;
+static float windowHigh = 0;
+static uint8_t preSamples = 8;
+static uint8_t postSamples = 8;
+
+// Pre-trigger ring, the last TRIGGER_SEGMENT_MAX samples
+static struct TriggerSample ring[TRIGGER_SEGMENT_MAX];
+static uint32_t ringCount = 0;
+
+// Previous value of the source, for the comparison
+static float previous = 0;
+static bool havePrevious = false;
+
+// Segment being captured, in the event at queueHead
+static bool capturing = false;
+static uint8_t captureTarget = 0;
+
+// Event queue, filled at queueHead, read at queueTail
+static struct TriggerEvent events[TRIGGER_EVENT_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueTail = 0;
+static uint32_t dropped = 0;
+
+
+static float sourceValue(const struct TriggerSample& sample) {
+    if (source == TRIGGER_SOURCE_CURRENT) {
+        return sample.current;
+    }
+    return sample.cpCount[source - TRIGGER_SOURCE_CP1];
+}
+
+static bool inWindow(float value) {
+    return value >= windowLow && value <= windowHigh;
+}
+
+/**
+ * @brief Compare a value of the source with the previous one.
+ */
+static bool triggered(float value) {
+    switch (type) {
+        case TRIGGER_TYPE_EDGE:
+            return positive ? (previous < level && value >= level)
+                            : (previous > level && value <= level);
+        case TRIGGER_TYPE_SLOPE:
+            return positive ? (value - previous >= level)
+                            : (previous - value >= level);
+        case TRIGGER_TYPE_WINDOW:
+            return positive ? (inWindow(previous) && !inWindow(value))
+                            : (!inWindow(previous) && inWindow(value));
+    }
+    return false;
+}
+
+/**
+ * @brief Start an event with the pre-trigger samples and the trigger sample.
+ *
+ * The trigger sample is the last one of the ring.
+ */
+static void startEvent() {
+    struct TriggerEvent* event = &events[queueHead % TRIGGER_EVENT_QUEUE_SIZE];
+    uint8_t pre = ringCount - 1 < preSamples ? ringCount - 1 : preSamples;
+
+    for (uint8_t i = 0; i <= pre; i++) {
+        event->samples[i] = ring[(ringCount - 1 - pre + i) % TRIGGER_SEGMENT_MAX];
+    }
+    event->count = pre + 1;
+    event->trigger = pre;
+    captureTarget = pre + 1 + postSamples;
+    capturing = event->count < captureTarget;
+    if (!capturing) {
+        queueHead++;
+    }
+}
+
+/**
+ * @brief Configuration changed, the next comparison starts afresh.
+ */
+static void rearm() {
+    capturing = false;
+    havePrevious = false;
+}
+
+
+void trigger_enable(bool enable) {
+    enabled = enable;
+    rearm();
+}
+
+bool trigger_enabled() {
+    return enabled;
+}
+
+bool trigger_waiting() {
+    return enabled && !capturing;
+}
+
+void trigger_set_source(enum TriggerSource newSource) {
+    source = newSource;
+    rearm();
+}
+
+enum TriggerSource trigger_get_source() {
+    return source;
+}
+
+void trigger_set_type(enum TriggerType newType) {
+    type = newType;
+    rearm();
+}
+
+enum TriggerType trigger_get_type() {
+    return type;
+}
+
+void trigger_set_slope(bool newPositive) {
+    positive = newPositive;
+}
+
+bool trigger_get_slope() {
+    return positive;
+}
+
+void trigger_set_level(float newLevel) {
+    level = newLevel;
+}
+
+float trigger_get_level() {
+    return level;
+}
+
+bool trigger_set_window(float low, float high) {
+    if (low > high) {
+        return false;
+    }
+    windowLow = low;
+    windowHigh = high;
+    return true;
+}
+
+void trigger_get_window(float* low, float* high) {
+    *low = windowLow;
+    *high = windowHigh;
+}
+
+bool trigger_set_segment(uint8_t pre, uint8_t post) {
+    if (pre + 1 + post > TRIGGER_SEGMENT_MAX) {
+        return false;
+    }
+    preSamples = pre;
+    postSamples = post;
+    rearm();
+    return true;
+}
+
+void trigger_get_segment(uint8_t* pre, uint8_t* post) {
+    *pre = preSamples;
+    *post = postSamples;
+}
+
+void trigger_push(const struct rawDataFPGA& frame) {
+    if (!frame.valid) {
+        return;
+    }
+
+    struct TriggerSample sample;
+    sample.timestamp = frame.timestamp;
+    sample.current = estimator_current(frame);
+    sample.cpCount[0] = frame.cp1Count;
+    sample.cpCount[1] = frame.cp2Count;
+    sample.cpCount[2] = frame.cp3Count;
+
+    ring[ringCount % TRIGGER_SEGMENT_MAX] = sample;
+    ringCount++;
+
+    if (!enabled) {
+        return;
+    }
+
+    float value = sourceValue(sample);
+    bool fire = havePrevious && triggered(value);
+    previous = value;
+    havePrevious = true;
+
+    // Post-trigger samples, the trigger is re-armed once they are all in
+    if (capturing) {
+        struct TriggerEvent* event = &events[queueHead % TRIGGER_EVENT_QUEUE_SIZE];
+        event->samples[event->count++] = sample;
+        if (event->count == captureTarget) {
+            capturing = false;
+            queueHead++;
+        }
+        return;
+    }
+
+    if (!fire) {
+        return;
+    }
+    if ((uint8_t)(queueHead - queueTail) == TRIGGER_EVENT_QUEUE_SIZE) {
+        dropped++;
+        return;
+    }
+    startEvent();
+}
+
+const struct TriggerEvent* trigger_peek_event() {
+    if (queueHead == queueTail) {
+        return NULL;
+    }
+    return &events[queueTail % TRIGGER_EVENT_QUEUE_SIZE];
+}
+
+void trigger_pop_event() {
+    if (queueHead != queueTail) {
+        queueTail++;
+    }
+}
+
+uint8_t trigger_event_count() {
+    return queueHead - queueTail;
+}
+
+uint32_t trigger_dropped() {
+    return dropped;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file trigger.h
+ * @brief Trigger engine capturing segments of frames around rare events.
+ *
+ * Every decoded frame is reduced to a sample, the current and the charge
+ * pump counts, and kept in a pre-trigger ring. While armed, each sample of
+ * the source is compared with the previous one:
+ * - EDGE: the source crosses the level, upwards if the slope is positive.
+ * - SLOPe: the source changes by at least the level from one frame to the
+ *   next, upwards if the slope is positive.
+ * - WINDow: the source leaves the window if the slope is positive, enters
+ *   it if negative.
+ *
+ * On a trigger the pre-trigger samples, the trigger sample and the
+ * post-trigger samples are saved as an event in a queue, and the engine
+ * re-arms as soon as the segment is complete. Events are kept until read,
+ * the ones triggered while the queue is full are counted and lost.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#define TRIGGER_SEGMENT_MAX 32     // Samples in an event, trigger sample included
+#define TRIGGER_EVENT_QUEUE_SIZE 4 // Events kept until read
+
+enum TriggerSource {
+    TRIGGER_SOURCE_CURRENT, //!< Current [fA]
+    TRIGGER_SOURCE_CP1,     //!< Activations of CP1 in the frame
+    TRIGGER_SOURCE_CP2,
+    TRIGGER_SOURCE_CP3
+};
+
+enum TriggerType {
+    TRIGGER_TYPE_EDGE,
+    TRIGGER_TYPE_SLOPE,
+    TRIGGER_TYPE_WINDOW
+};
+
+/**
+ * @brief A frame as kept around a trigger.
+ */
+struct TriggerSample {
+    uint64_t timestamp; //!< Reception time of the frame [us]
+    float current;      //!< [fA]
+    uint32_t cpCount[3];
+};
+
+/**
+ * @brief A captured segment.
+ */
+struct TriggerEvent {
+    uint8_t count;   //!< Samples in the segment
+    uint8_t trigger; //!< Index of the trigger sample
+    struct TriggerSample samples[TRIGGER_SEGMENT_MAX];
+};
+
+/**
+ * @brief Arm or disarm the trigger, the queued events are kept.
+ */
+void trigger_enable(bool enable);
+
+bool trigger_enabled();
+
+/**
+ * @brief True while armed and not capturing the post-trigger samples.
+ */
+bool trigger_waiting();
+
+void trigger_set_source(enum TriggerSource source);
+enum TriggerSource trigger_get_source();
+
+void trigger_set_type(enum TriggerType type);
+enum TriggerType trigger_get_type();
+
+/**
+ * @brief Direction of the trigger.
+ * @param positive Rising edge or slope, leaving the window.
+ */
+void trigger_set_slope(bool positive);
+bool trigger_get_slope();
+
+/**
+ * @brief Level of an EDGE trigger, minimum change of a SLOPe trigger.
+ */
+void trigger_set_level(float level);
+float trigger_get_level();
+
+/**
+ * @brief Limits of a WINDow trigger.
+ * @return False if low is above high.
+ */
+bool trigger_set_window(float low, float high);
+void trigger_get_window(float* low, float* high);
+
+/**
+ * @brief Samples kept before and after the trigger sample.
+ * @return False if the segment would exceed TRIGGER_SEGMENT_MAX.
+ */
+bool trigger_set_segment(uint8_t pre, uint8_t post);
+void trigger_get_segment(uint8_t* pre, uint8_t* post);
+
+/**
+ * @brief Evaluate the trigger on a decoded frame.
+ */
+void trigger_push(const struct rawDataFPGA& frame);
+
+/**
+ * @brief Oldest captured event, without removing it.
+ * @return NULL if there is none.
+ */
+const struct TriggerEvent* trigger_peek_event();
+
+/**
+ * @brief Remove the oldest captured event.
+ */
+void trigger_pop_event();
+
+/**
+ * @brief Events waiting to be read.
+ */
+uint8_t trigger_event_count();
+
+/**
+ * @brief Triggers lost because the event queue was full.
+ */
+uint32_t trigger_dropped();
+
+#endif // TRIGGER_H
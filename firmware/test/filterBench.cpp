@@ -0,0 +1,130 @@
+/**
+ * @file filterBench.cpp
+ * @brief Host benchmark of the current pipeline of a frame, in cycles.
+ *
+ * Each estimator and filter runs on a sequence of noisy frames, and the
+ * cycles per call are the best of several rounds, read from the time stamp
+ * counter. They rank the stages and show how the median grows with its
+ * taps; the SAMD21 figures are those of the filter probe of
+ * SYSTem:PERFormance?, the Cortex-M0+ having no 64-bit multiplier nor
+ * divider.
+ */
+
+#include "filter.h"
+#include "estimator.h"
+#include "calibration.h"
+#include "nvm.h"
+#include <stdio.h>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t ticks() {
+    return __rdtsc();
+}
+#else
+#include <chrono>
+#define BENCH_UNIT "ns"
+static uint64_t ticks() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define FRAME_COUNT 4096
+#define ROUNDS 20
+
+struct confParam conf = defaultConf;
+
+bool nvm_read(void*, uint16_t) {
+    return false;
+}
+
+bool nvm_write(const void*, uint16_t) {
+    return false;
+}
+
+int64_t fpga_signed_charge(uint64_t charge) {
+    const uint64_t signBit = (uint64_t)1 << (FPGA_CHARGE_BITS - 1);
+    return (int64_t)((charge ^ signBit) - signBit);
+}
+
+static std::vector<struct rawDataFPGA> frames;
+static std::vector<int64_t> currents;
+static volatile int64_t sink;
+
+/**
+ * @brief Frames of about 1 pA, 100 ms, with CP1 activations only.
+ */
+static void makeFrames() {
+    std::mt19937_64 generator(47);
+    for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+        struct rawDataFPGA frame = {};
+        frame.cp1Count = 8 + generator() % 4;
+        frame.charge = (uint64_t)frame.cp1Count * DEFAULT_CHARGE_QUANTA_CP1 - generator() % 1000;
+        frame.cp1StartInterval = generator() % 500000;
+        frame.cp1EndInterval = generator() % 500000;
+        frame.tempSht41 = 26214;
+        frame.periodMs = DEFAULT_WINDOW_PERIOD;
+        frame.valid = true;
+        frames.push_back(frame);
+        currents.push_back(estimator_window_current(frame));
+    }
+}
+
+/**
+ * @brief Best cycles per call of a stage over the rounds.
+ */
+template <typename Stage>
+static double measure(Stage stage) {
+    uint64_t best = UINT64_MAX;
+    for (uint8_t round = 0; round < ROUNDS; round++) {
+        filter_reset();
+        int64_t sum = 0;
+        uint64_t start = ticks();
+        for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+            sum += stage(i);
+        }
+        uint64_t elapsed = ticks() - start;
+        sink = sum;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return (double)best / FRAME_COUNT;
+}
+
+static void printStage(const char* name, double perCall) {
+    printf("%-24s %10.1f\n", name, perCall);
+}
+
+static void benchFilter(const char* name, enum FilterType type, uint8_t length, uint8_t shift) {
+    conf.filter.type = type;
+    conf.filter.length = length;
+    conf.filter.shift = shift;
+    printStage(name, measure([](uint32_t i) { return filter_push(currents[i]); }));
+}
+
+int main() {
+    calibration_reset();
+    makeFrames();
+
+    printf("%-24s %10s\n", "stage", BENCH_UNIT "/call");
+    printStage("window estimator", measure([](uint32_t i) { return estimator_window_current(frames[i]); }));
+    printStage("interval estimator", measure([](uint32_t i) {
+        int64_t current = 0;
+        estimator_interval_current(frames[i], &current);
+        return current;
+    }));
+    printStage("calibrated current", measure([](uint32_t i) { return estimator_current_aa(frames[i]); }));
+
+    benchFilter("filter none", FILTER_NONE, 1, 0);
+    benchFilter("filter iir 2^3", FILTER_IIR, 1, 3);
+    benchFilter("filter iir 2^10", FILTER_IIR, 1, 10);
+    benchFilter("filter average 4", FILTER_AVERAGE, 4, 0);
+    benchFilter("filter average 16", FILTER_AVERAGE, 16, 0);
+    benchFilter("filter median 4", FILTER_MEDIAN, 4, 0);
+    benchFilter("filter median 16", FILTER_MEDIAN, 16, 0);
+    return 0;
+}
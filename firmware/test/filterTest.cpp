@@ -0,0 +1,316 @@
+/**
+ * @file filterTest.cpp
+ * @brief Host test of the integer filter stage and current estimators
+ * against a floating-point model.
+ *
+ * filter.cpp, estimator.cpp and calibration.cpp are built as on the board.
+ * Each output must stay within the error bound of its integer arithmetic
+ * from the model, and the mean error over a long random input must be near
+ * zero: a rounding toward minus infinity or toward zero passes the first
+ * check but biases the output.
+ *
+ * The filters are compared with a double model. The estimators handle
+ * products beyond the 53 bits of a double, they are compared with a long
+ * double one, 64 bits on x86.
+ */
+
+#include "filter.h"
+#include "estimator.h"
+#include "calibration.h"
+#include "nvm.h"
+#include "test.h"
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define SAMPLE_COUNT 200000
+#define MAX_BIAS_AA 0.01 // Mean error allowed [aA]
+
+struct confParam conf = defaultConf;
+
+// No flash on the host, the calibration is the nominal one until set
+bool nvm_read(void*, uint16_t) {
+    return false;
+}
+
+bool nvm_write(const void*, uint16_t) {
+    return false;
+}
+
+// fpga.cpp needs the board, as there
+int64_t fpga_signed_charge(uint64_t charge) {
+    const uint64_t signBit = (uint64_t)1 << (FPGA_CHARGE_BITS - 1);
+    return (int64_t)((charge ^ signBit) - signBit);
+}
+
+static std::mt19937_64 generator(47);
+
+static int64_t randomIn(int64_t min, int64_t max) {
+    return std::uniform_int_distribution<int64_t>(min, max)(generator);
+}
+
+/**
+ * @brief Max and mean of the errors of a run.
+ */
+struct Error {
+    double max;
+    double sum;
+    uint32_t count;
+
+    Error() : max(0), sum(0), count(0) {}
+
+    void add(double error) {
+        max = std::max(max, fabs(error));
+        sum += error;
+        count++;
+    }
+
+    double mean() const {
+        return sum / count;
+    }
+};
+
+static void setFilter(enum FilterType type, uint8_t length, uint8_t shift) {
+    conf.filter.type = type;
+    conf.filter.length = length;
+    conf.filter.shift = shift;
+    filter_reset();
+}
+
+/**
+ * @brief A noisy current around a level that changes now and then, of both
+ * signs.
+ */
+static std::vector<int64_t> noisyCurrents() {
+    std::vector<int64_t> currents;
+    int64_t level = 0;
+    for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+        if (i % 5000 == 0) {
+            level = randomIn(-2000000, 2000000);
+        }
+        currents.push_back(level + randomIn(-50000, 50000));
+    }
+    return currents;
+}
+
+/**
+ * @brief The IIR follows y += (x - y) / 2^k, to its rounding.
+ *
+ * A rounding error of half a Q.8 LSB per step adds up to 2^(k - 1) of them
+ * in the state, and the output is rounded to the aA.
+ */
+static void testIir() {
+    std::vector<int64_t> currents = noisyCurrents();
+
+    for (uint8_t shift = 0; shift <= FILTER_MAX_SHIFT; shift++) {
+        setFilter(FILTER_IIR, 1, shift);
+        double model = currents[0];
+        struct Error error;
+        for (int64_t current : currents) {
+            model += (current - model) / (1 << shift);
+            error.add(filter_push(current) - model);
+        }
+
+        double bound = 0.5 + ldexp(1, shift - 1 - FILTER_FRAC_BITS);
+        printf("iir 2^%-2u max error %.3f (bound %.3f), mean %+.5f aA\n", shift, error.max, bound, error.mean());
+        CHECK(error.max <= bound + 1e-9);
+        CHECK(fabs(error.mean()) < MAX_BIAS_AA);
+    }
+}
+
+/**
+ * @brief A constant input is reached from below as from above.
+ *
+ * The state stops once the step rounds to zero, up to 2^(k - 1) Q.8 LSB
+ * from the input on either side: the output is exact up to 2^7 windows.
+ * Rounded down, the state would stop up to 2^k - 1 Q.8 LSB below the input
+ * reached from below, one aA from 2^8 windows.
+ */
+static void testIirSettles() {
+    const int64_t levels[] = {0, 1000, -1000, 123457, -123457};
+    for (uint8_t shift = 0; shift <= FILTER_MAX_SHIFT; shift++) {
+        double bound = 0.5 + ldexp(1, shift - 1 - FILTER_FRAC_BITS);
+        for (int64_t from : levels) {
+            for (int64_t to : levels) {
+                setFilter(FILTER_IIR, 1, shift);
+                filter_push(from);
+                int64_t output = 0;
+                for (uint32_t i = 0; i < 100u << shift; i++) {
+                    output = filter_push(to);
+                }
+                if (fabs((double)(output - to)) > bound) {
+                    printf("iir 2^%u from %lld settles at %lld instead of %lld\n", shift, (long long)from,
+                           (long long)output, (long long)to);
+                }
+                CHECK(fabs((double)(output - to)) <= bound);
+                CHECK(shift >= 8 || output == to);
+            }
+        }
+    }
+}
+
+/**
+ * @brief The moving average and the median of the last currents, rounded
+ * to the nearest aA.
+ */
+static void testWindowFilters() {
+    std::vector<int64_t> currents = noisyCurrents();
+
+    for (uint8_t length = 1; length <= FILTER_MAX_LENGTH; length++) {
+        struct Error average;
+        setFilter(FILTER_AVERAGE, length, 0);
+        for (uint32_t i = 0; i < currents.size(); i++) {
+            uint32_t first = i + 1 >= length ? i + 1 - length : 0;
+            double sum = 0;
+            for (uint32_t j = first; j <= i; j++) {
+                sum += currents[j];
+            }
+            average.add(filter_push(currents[i]) - sum / (i + 1 - first));
+        }
+
+        struct Error median;
+        setFilter(FILTER_MEDIAN, length, 0);
+        for (uint32_t i = 0; i < currents.size(); i++) {
+            uint32_t first = i + 1 >= length ? i + 1 - length : 0;
+            std::vector<double> taps(currents.begin() + first, currents.begin() + i + 1);
+            std::sort(taps.begin(), taps.end());
+            size_t n = taps.size();
+            double model = n % 2 ? taps[n / 2] : (taps[n / 2 - 1] + taps[n / 2]) / 2;
+            median.add(filter_push(currents[i]) - model);
+        }
+
+        printf("length %-2u average max %.3f mean %+.5f, median max %.3f mean %+.5f aA\n", length,
+               average.max, average.mean(), median.max, median.mean());
+        CHECK(average.max <= 0.5);
+        CHECK(median.max <= 0.5);
+        CHECK(fabs(average.mean()) < MAX_BIAS_AA);
+        CHECK(fabs(median.mean()) < MAX_BIAS_AA);
+    }
+}
+
+/**
+ * @brief A spike shorter than half of the taps does not reach the median.
+ */
+static void testMedianSpike() {
+    setFilter(FILTER_MEDIAN, 9, 0);
+    for (uint8_t i = 0; i < 9; i++) {
+        filter_push(1000);
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        CHECK(filter_push(1000000000) == 1000);
+    }
+    CHECK(filter_push(-1000000000) == 1000);
+}
+
+static struct rawDataFPGA frameOf(int64_t charge, uint16_t periodMs) {
+    struct rawDataFPGA frame = {};
+    frame.charge = (uint64_t)charge & (((uint64_t)1 << FPGA_CHARGE_BITS) - 1);
+    frame.periodMs = periodMs;
+    frame.tempSht41 = 26214; // 25 °C
+    frame.valid = true;
+    return frame;
+}
+
+/**
+ * @brief The window estimate is the charge over the period, rounded to the
+ * nearest aA, over the whole 48-bit range of the charge.
+ */
+static void testWindowEstimator() {
+    calibration_reset();
+    struct Error error;
+    for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+        int64_t charge = i % 2 ? randomIn(-100000000, 100000000)
+            : randomIn(-((int64_t)1 << (FPGA_CHARGE_BITS - 1)), ((int64_t)1 << (FPGA_CHARGE_BITS - 1)) - 1);
+        uint16_t periodMs = randomIn(MIN_WINDOW_PERIOD, MAX_WINDOW_PERIOD);
+        long double model = (long double)charge * ESTIMATOR_LSB_ZC / periodMs;
+        error.add((double)(estimator_window_current(frameOf(charge, periodMs)) - model));
+    }
+    printf("window estimator max error %.3f, mean %+.5f aA\n", error.max, error.mean());
+    CHECK(error.max <= 0.5 + 1e-6);
+    CHECK(fabs(error.mean()) < MAX_BIAS_AA);
+}
+
+/**
+ * @brief The interval estimate is the charge of cp1Count - 1 quanta over
+ * the time between the first and last activations, rounded to the nearest
+ * aA, and only applies to the frames of CP1 alone within the counters.
+ */
+static void testIntervalEstimator() {
+    calibration_reset();
+    struct Error error;
+    for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+        uint16_t periodMs = randomIn(MIN_WINDOW_PERIOD, 335); // 2^24 cycles at 50 MHz
+        uint64_t windowCycles = (uint64_t)periodMs * ESTIMATOR_CLK_KHZ;
+        struct rawDataFPGA frame = frameOf(0, periodMs);
+        frame.cp1Count = randomIn(2, 100000);
+        frame.cp1StartInterval = randomIn(0, windowCycles / 3);
+        frame.cp1EndInterval = randomIn(0, windowCycles / 3);
+
+        long double cycles = windowCycles - frame.cp1StartInterval - frame.cp1EndInterval - 2;
+        long double model = (long double)(frame.cp1Count - 1) * conf.acc.chargeQuantaCP[0] * ESTIMATOR_LSB_ZC
+            * ESTIMATOR_CLK_KHZ / cycles;
+        int64_t current;
+        CHECK(estimator_interval_current(frame, &current));
+        error.add((double)(current - model));
+    }
+    printf("interval estimator max error %.3f, mean %+.5f aA\n", error.max, error.mean());
+    CHECK(error.max <= 0.5 + 1e-6);
+    CHECK(fabs(error.mean()) < MAX_BIAS_AA);
+
+    int64_t current;
+    struct rawDataFPGA frame = frameOf(0, 100);
+    frame.cp1Count = 1;
+    CHECK(!estimator_interval_current(frame, &current));
+    frame.cp1Count = 10;
+    frame.cp2Count = 1;
+    CHECK(!estimator_interval_current(frame, &current));
+    frame.cp2Count = 0;
+    frame.cp1StartInterval = 3000000;
+    frame.cp1EndInterval = 2000000;
+    CHECK(!estimator_interval_current(frame, &current));
+    frame = frameOf(0, 336); // The counters could wrap
+    frame.cp1Count = 10;
+    CHECK(!estimator_interval_current(frame, &current));
+}
+
+/**
+ * @brief The calibrated current is the uncalibrated one times the gain of
+ * its range plus the offset, rounded to the nearest aA.
+ */
+static void testCalibratedCurrent() {
+    struct CalibrationRecord record = *calibration_get();
+    for (uint8_t range = 0; range < CALIBRATION_RANGE_COUNT; range++) {
+        record.gain[range] = 1.0f + 0.0137f * (range + 1);
+        record.offset[range] = -0.25f * range; // [fA]
+    }
+    CHECK(calibration_set(record));
+    conf.calc.interval = false;
+
+    struct Error error;
+    for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+        int64_t charge = randomIn(-1000000000, 1000000000);
+        struct rawDataFPGA frame = frameOf(charge, DEFAULT_WINDOW_PERIOD);
+        int64_t uncalibrated = estimator_window_current(frame);
+        uint8_t range = calibration_range(uncalibrated);
+        // The multiplier is the Q24 gain, not the float one
+        long double gain = roundl((long double)record.gain[range] * (1 << CALIBRATION_Q)) / (1 << CALIBRATION_Q);
+        long double model = uncalibrated * gain + llround(record.offset[range] * 1000.0);
+        error.add((double)(estimator_current_aa(frame) - model));
+    }
+    printf("calibrated current max error %.3f, mean %+.5f aA\n", error.max, error.mean());
+    CHECK(error.max <= 0.5 + 1e-6);
+    CHECK(fabs(error.mean()) < MAX_BIAS_AA);
+    calibration_reset();
+}
+
+int main() {
+    testIir();
+    testIirSettles();
+    testWindowFilters();
+    testMedianSpike();
+    testWindowEstimator();
+    testIntervalEstimator();
+    testCalibratedCurrent();
+    return TEST_RESULT();
+}
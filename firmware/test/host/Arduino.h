@@ -0,0 +1,70 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in of the Arduino core, only what the tested modules
+ * use.
+ *
+ * A Stream keeps what is printed to it in output, for the tests to check.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class String {
+    private:
+        std::string _value;
+
+    public:
+        String(const char* value = "") : _value(value) {}
+        explicit String(unsigned long value) : _value(std::to_string(value)) {}
+        explicit String(unsigned int value) : _value(std::to_string(value)) {}
+
+        unsigned int length() const {
+            return _value.size();
+        }
+
+        const char* c_str() const {
+            return _value.c_str();
+        }
+};
+
+class Stream {
+    public:
+        std::string output;
+
+        size_t print(const char* value) {
+            output += value;
+            return strlen(value);
+        }
+
+        size_t print(const String& value) {
+            return print(value.c_str());
+        }
+
+        size_t print(unsigned long value) {
+            return print(std::to_string(value).c_str());
+        }
+
+        size_t print(unsigned int value) {
+            return print((unsigned long)value);
+        }
+
+        size_t print(long value) {
+            return print(std::to_string(value).c_str());
+        }
+
+        size_t print(int value) {
+            return print((long)value);
+        }
+
+        template <typename T>
+        size_t println(T value) {
+            return print(value) + print("\r\n");
+        }
+};
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,230 @@
+/**
+ * @file schedulerTest.cpp
+ * @brief Host test of the main loop tasks against a simulated clock.
+ *
+ * The tasks are registered as in setup(), from the sched_add() lines of
+ * main.ino, each advancing the clock by its budget when run. A frame arrives
+ * every FRAME_PERIOD_US and releases the event task. Over a minute of
+ * simulated time, across the wrap of the clock, every run of every task must
+ * complete within the deadline it is registered with, and every frame must
+ * be output.
+ *
+ * The scheduler also counts as overruns the releases of a periodic task that
+ * pass while it waits or runs. The tasks polling faster than the longest run
+ * of the others (adc, i2c, sht41) miss some by design, so the missed releases
+ * are only checked to account, with the runs, for every period.
+ *
+ * The budgets are the longest run allowed to each task, to be kept above the
+ * max of SYSTem:PERFormance? on the board. A task without a budget fails.
+ */
+
+#include "scheduler.h"
+#include "test.h"
+#include <string.h>
+
+#define FRAME_PERIOD_US 20000      // Shortest integration window
+#define FRAME_DECODE_US 150        // Decode and push of a complete frame
+#define IDLE_STEP_US 5             // A pass without any task
+#define SIMULATED_US 60000000UL
+#define START_US (0xFFFFFFFFUL - 5000000UL) // Wraps after 5 s
+
+/**
+ * @brief A task as registered in main.ino.
+ */
+struct TaskLine {
+    const char* name;
+    enum SchedKind kind;
+    uint8_t priority;
+    uint32_t periodUs;
+    uint32_t deadlineUs;
+};
+
+static const struct TaskLine mainTasks[] = {
+#include "tasks.inc"
+};
+
+#define TASK_COUNT (sizeof(mainTasks) / sizeof(mainTasks[0]))
+
+struct Budget {
+    const char* name;
+    uint32_t runUs;
+};
+
+static const struct Budget budgets[] = {
+    {"frame", 10},    // A pass without a complete frame
+    {"output", 800},
+    {"i2c", 30},
+    {"scpi", 500},
+    {"buttons", 20},
+    {"sweep", 100},
+    {"quanta", 100},
+    {"adc", 30},
+    {"sht41", 30},
+    {"timesync", 20},
+    {"screen", 300},
+};
+
+static uint32_t nowUs = 0;
+static uint32_t nextFrameUs = 0;
+static int8_t eventId = -1;
+static uint32_t runUs[SCHED_MAX_TASKS];
+static bool pollTask[SCHED_MAX_TASKS];
+static uint32_t lateRuns[SCHED_MAX_TASKS];     // Completed after their deadline
+static uint32_t maxCompletionUs[SCHED_MAX_TASKS]; // From release to completion
+
+
+static uint32_t simulatedClock() {
+    return nowUs;
+}
+
+static void runBody(uint8_t id) {
+    nowUs += runUs[id];
+    if (pollTask[id] && (int32_t)(nowUs - nextFrameUs) >= 0) {
+        nowUs += FRAME_DECODE_US;
+        nextFrameUs += FRAME_PERIOD_US;
+        sched_signal(eventId);
+    }
+
+    // The scheduler reads the clock again right after the body
+    const struct SchedTask* task = sched_get_task(id);
+    uint32_t completion = nowUs - task->releaseUs;
+    if (completion > maxCompletionUs[id]) {
+        maxCompletionUs[id] = completion;
+    }
+    if (task->deadlineUs != 0 && completion > task->deadlineUs) {
+        lateRuns[id]++;
+    }
+}
+
+#define TASK_BODY(id) static void task##id() { runBody(id); }
+TASK_BODY(0) TASK_BODY(1) TASK_BODY(2) TASK_BODY(3) TASK_BODY(4) TASK_BODY(5)
+TASK_BODY(6) TASK_BODY(7) TASK_BODY(8) TASK_BODY(9) TASK_BODY(10) TASK_BODY(11)
+
+static const SchedFunction bodies[SCHED_MAX_TASKS] = {
+    task0, task1, task2, task3, task4, task5, task6, task7, task8, task9, task10, task11
+};
+
+static const struct Budget* findBudget(const char* name) {
+    for (uint8_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+        if (strcmp(budgets[i].name, name) == 0) {
+            return &budgets[i];
+        }
+    }
+    return nullptr;
+}
+
+static void reset() {
+    memset(lateRuns, 0, sizeof(lateRuns));
+    memset(maxCompletionUs, 0, sizeof(maxCompletionUs));
+}
+
+static void run(uint32_t durationUs) {
+    uint32_t start = nowUs;
+    while (nowUs - start < durationUs) {
+        if (!sched_run()) {
+            nowUs += IDLE_STEP_US;
+        }
+    }
+}
+
+/**
+ * @brief The tasks of main.ino meet their deadlines.
+ */
+static void testMainTasks() {
+    nowUs = START_US;
+    nextFrameUs = START_US;
+    sched_init(simulatedClock);
+    reset();
+
+    CHECK(TASK_COUNT <= SCHED_MAX_TASKS);
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+        const struct TaskLine& line = mainTasks[i];
+        const struct Budget* budget = findBudget(line.name);
+        if (budget == nullptr) {
+            printf("No budget for task %s\n", line.name);
+        }
+        CHECK(budget != nullptr);
+
+        runUs[i] = budget != nullptr ? budget->runUs : 0;
+        pollTask[i] = line.kind == SCHED_POLL;
+        int8_t id = sched_add(line.name, bodies[i], line.kind, line.priority, line.periodUs, line.deadlineUs);
+        CHECK(id == i);
+        if (line.kind == SCHED_EVENT) {
+            eventId = id;
+        }
+    }
+    CHECK(eventId >= 0);
+
+    run(SIMULATED_US);
+
+    printf("%-10s %8s %6s %7s %12s %10s\n", "task", "runs", "late", "missed", "completion", "deadline");
+    for (uint8_t i = 0; i < sched_task_count(); i++) {
+        const struct SchedTask* task = sched_get_task(i);
+        printf("%-10s %8u %6u %7u %12u %10u\n", task->name, task->stats.runs, lateRuns[i],
+               task->stats.overruns - lateRuns[i], maxCompletionUs[i], task->deadlineUs);
+
+        CHECK(lateRuns[i] == 0);
+        CHECK(task->deadlineUs == 0 || maxCompletionUs[i] <= task->deadlineUs);
+        if (task->kind == SCHED_PERIODIC) {
+            uint32_t missed = task->stats.overruns - lateRuns[i];
+            CHECK(task->stats.runs + missed >= SIMULATED_US / task->periodUs);
+        } else if (task->kind == SCHED_EVENT) {
+            CHECK(task->stats.runs >= SIMULATED_US / FRAME_PERIOD_US);
+        }
+    }
+}
+
+/**
+ * @brief A run longer than its deadline is counted, so the test above can
+ * fail.
+ */
+static void testOverrunCounted() {
+    nowUs = START_US;
+    sched_init(simulatedClock);
+    reset();
+
+    runUs[0] = 3000;
+    pollTask[0] = false;
+    CHECK(sched_add("late", bodies[0], SCHED_PERIODIC, 0, 10000, 2000) == 0);
+
+    run(100000);
+
+    const struct SchedTask* task = sched_get_task(0);
+    CHECK(task->stats.runs == 10);
+    CHECK(task->stats.overruns == task->stats.runs);
+    CHECK(lateRuns[0] == task->stats.runs);
+    CHECK(task->stats.maxRunUs == 3000);
+}
+
+/**
+ * @brief A release delayed by a longer run is late from the time it should
+ * have been released, and the releases passed meanwhile are missed.
+ */
+static void testDelayedRelease() {
+    nowUs = START_US;
+    sched_init(simulatedClock);
+    reset();
+
+    runUs[0] = 100;
+    runUs[1] = 2500;
+    pollTask[0] = false;
+    pollTask[1] = false;
+    CHECK(sched_add("fast", bodies[0], SCHED_PERIODIC, 0, 250, 2000) == 0);
+    CHECK(sched_add("long", bodies[1], SCHED_PERIODIC, 1, 100000, 0) == 1);
+
+    run(100000);
+
+    const struct SchedTask* fast = sched_get_task(0);
+    CHECK(lateRuns[0] == 1);
+    CHECK(maxCompletionUs[0] == 2450); // Released at 250, run from 2600
+    // 400 releases in 100 ms, 9 more passed during the long run
+    CHECK(fast->stats.runs + fast->stats.overruns - lateRuns[0] == 400);
+    CHECK(fast->stats.overruns - lateRuns[0] == 9);
+}
+
+int main() {
+    testMainTasks();
+    testOverrunCounted();
+    testDelayedRelease();
+    return TEST_RESULT();
+}
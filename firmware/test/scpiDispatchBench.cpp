@@ -0,0 +1,100 @@
+/**
+ * @file scpiDispatchBench.cpp
+ * @brief Host benchmark of the SCPI dispatch, in commands per second.
+ *
+ * Every command of the table of scpiInterface.cpp is sent in its long and
+ * its short form, with a parameter, split and looked up as executeMessage()
+ * does. The perfect hash is compared with a linear scan of the same table,
+ * matching the header against each pattern in turn. The scan stands in for
+ * the parser used before the perfect hash (Vrekrer SCPI Parser), which is
+ * not part of the tree: it too compares the header, token by token, with the
+ * registered commands until one matches.
+ *
+ * The figures are host ones, only their ratio carries over to the SAMD21.
+ */
+
+#include "scpiDispatch.h"
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define ROUNDS 2000
+
+static void handler(SCPI_C, SCPI_P, Stream&) {}
+
+static constexpr struct ScpiCommand commands[] = {
+#include "commands.inc"
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+typedef ScpiPerfectHash<commands, COMMAND_COUNT> Hash;
+
+static int16_t findLinear(const char* header) {
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        if (scpi_match(commands[i].pattern, header)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief A message accepted by a pattern, in its long or short form.
+ */
+static std::string messageOf(const char* pattern, bool shortForm) {
+    std::string message;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        if (*p == '#') {
+            continue;
+        }
+        if (!shortForm || !(*p >= 'a' && *p <= 'z')) {
+            message += *p;
+        }
+    }
+    return message + " 1";
+}
+
+/**
+ * @brief Dispatch every message ROUNDS times.
+ * @return Commands per second.
+ */
+static double run(const std::vector<std::string>& messages, int16_t (*find)(const char*), uint32_t& found) {
+    char buffer[SCPI_BUFFER_LENGTH + 1];
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        for (const std::string& message : messages) {
+            // The message is split in place, as the received buffer is
+            memcpy(buffer, message.c_str(), message.size() + 1);
+            SCPI_P parameters;
+            char* header = scpi_split(buffer, parameters);
+            found += find(header) >= 0;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return (double)ROUNDS * messages.size() / elapsed.count();
+}
+
+int main() {
+    std::vector<std::string> messages;
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        messages.push_back(messageOf(commands[i].pattern, false));
+        messages.push_back(messageOf(commands[i].pattern, true));
+    }
+
+    uint32_t foundHash;
+    uint32_t foundLinear;
+    double hash = run(messages, Hash::find, foundHash);
+    double linear = run(messages, findLinear, foundLinear);
+
+    printf("%u commands, %u messages\n", (unsigned)COMMAND_COUNT, (unsigned)messages.size());
+    printf("%-12s %14s\n", "dispatch", "commands/s");
+    printf("%-12s %14.0f\n", "perfect hash", hash);
+    printf("%-12s %14.0f\n", "linear scan", linear);
+    printf("speedup %.1fx\n", hash / linear);
+
+    // Both must find every command, or the figures mean nothing
+    return foundHash == foundLinear && foundHash == ROUNDS * messages.size() ? 0 : 1;
+}
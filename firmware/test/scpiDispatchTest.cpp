@@ -0,0 +1,172 @@
+/**
+ * @file scpiDispatchTest.cpp
+ * @brief Host test of the perfect hash of the SCPI commands.
+ *
+ * The table is the one of scpiInterface.cpp, its patterns read from the
+ * source. Every command must be found at its own index from its long form,
+ * its short form, in lowercase and with a numeric suffix where allowed, no
+ * two keys may be equal and no slot may hold two commands. The splitting of
+ * the messages is checked as well, with too many parameters.
+ */
+
+#include "scpiDispatch.h"
+#include "test.h"
+#include <ctype.h>
+#include <string>
+
+static void handler(SCPI_C, SCPI_P, Stream&) {}
+
+static constexpr struct ScpiCommand commands[] = {
+#include "commands.inc"
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+typedef ScpiPerfectHash<commands, COMMAND_COUNT> Hash;
+
+enum Form {
+    FORM_LONG,
+    FORM_SHORT
+};
+
+/**
+ * @brief A header accepted by a pattern.
+ * @param lower Lowercase it.
+ * @param suffix Suffix of the mnemonics allowing one.
+ */
+static std::string headerOf(const char* pattern, enum Form form, bool lower, const char* suffix) {
+    std::string header;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        if (*p == '#') {
+            // The suffix goes before the query mark, "PROBe2?"
+            size_t end = !header.empty() && header.back() == '?' ? header.size() - 1 : header.size();
+            header.insert(end, suffix);
+        } else if (form == FORM_LONG || !islower(*p)) {
+            header += lower ? tolower(*p) : *p;
+        }
+    }
+    return header;
+}
+
+static uint8_t depthOf(const char* pattern) {
+    uint8_t depth = 1;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        depth += *p == ':';
+    }
+    return depth;
+}
+
+/**
+ * @brief The hash was built, without giving up on a bucket.
+ */
+static void testBuilt() {
+    printf("%u commands, %u slots\n", (unsigned)COMMAND_COUNT, Hash::slotCount);
+    CHECK(Hash::valid);
+    CHECK(Hash::slotCount < 2 * COMMAND_COUNT);
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        CHECK(Hash::seed.v[i] != SCPI_MAX_SEED);
+        // The mnemonics of a matched header fit the array
+        CHECK(depthOf(commands[i].pattern) <= SCPI_ARRAY_SIZE);
+    }
+}
+
+/**
+ * @brief No two patterns share a key and every command has its own slot.
+ */
+static void testNoCollision() {
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        for (uint8_t j = i + 1; j < COMMAND_COUNT; j++) {
+            if (Hash::key.v[i] == Hash::key.v[j]) {
+                printf("Same key: %s, %s\n", commands[i].pattern, commands[j].pattern);
+            }
+            CHECK(Hash::key.v[i] != Hash::key.v[j]);
+        }
+    }
+
+    uint16_t slots[COMMAND_COUNT] = {0};
+    for (uint16_t s = 0; s < Hash::slotCount; s++) {
+        if (Hash::slot.v[s] != SCPI_NO_COMMAND) {
+            CHECK(Hash::slot.v[s] < COMMAND_COUNT);
+            slots[Hash::slot.v[s]]++;
+        }
+    }
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        CHECK(slots[i] == 1);
+    }
+}
+
+/**
+ * @brief Every form of every command finds it.
+ */
+static void testFind() {
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        const char* pattern = commands[i].pattern;
+        const std::string headers[] = {
+            headerOf(pattern, FORM_LONG, false, ""),
+            headerOf(pattern, FORM_SHORT, false, ""),
+            headerOf(pattern, FORM_LONG, true, "2"),
+            headerOf(pattern, FORM_SHORT, true, "12"),
+            ":" + headerOf(pattern, FORM_SHORT, false, ""),
+        };
+        for (const std::string& header : headers) {
+            int16_t index = Hash::find(header.c_str());
+            if (index != i) {
+                printf("%s found %d instead of %u\n", header.c_str(), index, i);
+            }
+            CHECK(index == i);
+        }
+
+        // The query of a setting is another command, or none
+        if (strchr(pattern, '?') == nullptr) {
+            std::string query = headerOf(pattern, FORM_LONG, false, "") + "?";
+            int16_t index = Hash::find(query.c_str());
+            CHECK(index != i);
+        }
+    }
+}
+
+static void testUnknown() {
+    const char* headers[] = {"", ":", "FOO", "SYSTem:FOO", "SYSTem:ERRor:NEXT:MORE?", "SYSTe:ERRor?",
+                             "SYSTemX:ERRor?", "*IDN", "*IDN?2"};
+    for (const char* header : headers) {
+        CHECK(Hash::find(header) < 0);
+    }
+}
+
+/**
+ * @brief Too many parameters are flagged, not silently dropped.
+ */
+static void testSplit() {
+    char message[] = "  SYST:TIME:SYNC 1, 2 ,3,4  ";
+    SCPI_P parameters;
+    char* header = scpi_split(message, parameters);
+    CHECK(strcmp(header, "SYST:TIME:SYNC") == 0);
+    CHECK(parameters.Size() == 4);
+    CHECK(!parameters.Overflow());
+    CHECK(strcmp(parameters[1], "2") == 0);
+    CHECK(strcmp(parameters.Last(), "4") == 0);
+
+    char longer[] = "SYST:TIME:SYNC 1,2,3,4,5";
+    SCPI_P overflow;
+    scpi_split(longer, overflow);
+    CHECK(overflow.Size() == SCPI_ARRAY_SIZE);
+    CHECK(overflow.Overflow());
+
+    char query[] = "SYST:ERR?";
+    SCPI_P none;
+    header = scpi_split(query, none);
+    CHECK(none.Size() == 0);
+    SCPI_C mnemonics;
+    scpi_split_header(header, mnemonics);
+    CHECK(mnemonics.Size() == 2);
+    CHECK(strcmp(mnemonics.Last(), "ERR?") == 0);
+}
+
+int main() {
+    testBuilt();
+    testNoCollision();
+    testFind();
+    testUnknown();
+    testSplit();
+    return TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+/**
+ * @file spscbufTest.cpp
+ * @brief Host stress test of SPSCbuf and SPSCfanout, built with
+ * -fsanitize=thread.
+ *
+ * One producer thread pushes a sequence number per element, READER_COUNT
+ * reader threads drain the fan-out at different paces. Every reader must
+ * read the elements in order and all of them the same ones: those pushed,
+ * not counted as dropped. ThreadSanitizer reports any access to an element
+ * or an index not ordered by the acquire/release pairs, and then makes the
+ * test exit with an error.
+ */
+
+#include "SPSCbuf.h"
+#include "test.h"
+#include <thread>
+#include <vector>
+
+#define QUEUE_SIZE 16
+#define READER_COUNT 9 // As FPGA_READER_COUNT
+#define ELEMENT_COUNT 200000
+
+/**
+ * @brief An element larger than a word, so a torn copy is seen.
+ */
+struct Element {
+    uint32_t sequence;
+    uint32_t check; // ~sequence
+    uint8_t payload[24];
+};
+
+static SPSCfanout<struct Element, QUEUE_SIZE, READER_COUNT> fanout;
+static SPSCbuf<struct Element, QUEUE_SIZE> buffer;
+
+
+static struct Element makeElement(uint32_t sequence) {
+    struct Element element;
+    element.sequence = sequence;
+    element.check = ~sequence;
+    for (uint8_t i = 0; i < sizeof(element.payload); i++) {
+        element.payload[i] = (uint8_t)(sequence + i);
+    }
+    return element;
+}
+
+static bool intact(const struct Element& element) {
+    for (uint8_t i = 0; i < sizeof(element.payload); i++) {
+        if (element.payload[i] != (uint8_t)(element.sequence + i)) {
+            return false;
+        }
+    }
+    return element.check == ~element.sequence;
+}
+
+/**
+ * @brief Result of a reader, checked once joined.
+ */
+struct ReaderResult {
+    uint32_t count;
+    uint32_t outOfOrder;
+    uint32_t corrupt;
+    uint64_t sum; // Of the sequence numbers read
+};
+
+/**
+ * @brief One producer, every reader reads the same elements in order.
+ */
+static void testFanout() {
+    static struct ReaderResult results[READER_COUNT];
+    static uint32_t accepted = 0;
+    static uint64_t acceptedSum = 0;
+    static volatile bool done = false;
+
+    std::vector<std::thread> readers;
+    for (uint8_t reader = 0; reader < READER_COUNT; reader++) {
+        readers.emplace_back([reader]() {
+            struct ReaderResult& result = results[reader];
+            int64_t last = -1;
+            struct Element element;
+            while (true) {
+                bool finished = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+                if (!fanout.pop(reader, element)) {
+                    if (finished) {
+                        break;
+                    }
+                    // The slow readers make the producer drop
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (!intact(element)) {
+                    result.corrupt++;
+                }
+                if ((int64_t)element.sequence <= last) {
+                    result.outOfOrder++;
+                }
+                last = element.sequence;
+                result.count++;
+                result.sum += element.sequence;
+                // Reader 0 is the fastest, the last one the slowest
+                for (volatile uint32_t spin = 0; spin < reader * 20u; spin++);
+            }
+        });
+    }
+
+    std::thread producer([]() {
+        for (uint32_t sequence = 0; sequence < ELEMENT_COUNT; sequence++) {
+            if (fanout.push(makeElement(sequence))) {
+                accepted++;
+                acceptedSum += sequence;
+            } else {
+                // Let the readers run, so some elements only are dropped
+                std::this_thread::yield();
+            }
+        }
+        __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+    });
+
+    producer.join();
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    printf("fanout: %u accepted, %u dropped, high water %u\n", accepted, fanout.dropped(), fanout.highWater());
+    CHECK(accepted + fanout.dropped() == ELEMENT_COUNT);
+    CHECK(fanout.dropped() > 0); // The slowest reader did fall behind
+    CHECK(fanout.highWater() == QUEUE_SIZE);
+    for (uint8_t reader = 0; reader < READER_COUNT; reader++) {
+        const struct ReaderResult& result = results[reader];
+        CHECK(result.corrupt == 0);
+        CHECK(result.outOfOrder == 0);
+        CHECK(result.count == accepted);
+        CHECK(result.sum == acceptedSum);
+        CHECK(fanout.size(reader) == 0);
+    }
+}
+
+/**
+ * @brief One producer, one consumer, nothing lost when push() is retried.
+ */
+static void testBuffer() {
+    static uint32_t count = 0;
+    static uint32_t errors = 0;
+
+    std::thread consumer([]() {
+        struct Element element;
+        uint32_t expected = 0;
+        while (expected < ELEMENT_COUNT) {
+            if (!buffer.pop(element)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (!intact(element) || element.sequence != expected) {
+                errors++;
+            }
+            expected++;
+            count++;
+        }
+    });
+
+    std::thread producer([]() {
+        for (uint32_t sequence = 0; sequence < ELEMENT_COUNT; ) {
+            if (buffer.push(makeElement(sequence))) {
+                sequence++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    printf("buffer: %u read, high water %u\n", count, buffer.highWater());
+    CHECK(count == ELEMENT_COUNT);
+    CHECK(errors == 0);
+    CHECK(buffer.empty());
+}
+
+int main() {
+    testFanout();
+    testBuffer();
+    return TEST_RESULT();
+}
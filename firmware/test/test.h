@@ -0,0 +1,25 @@
+/**
+ * @file test.h
+ * @brief Checks of the host tests.
+ *
+ * A failed check prints its location and condition and the test goes on, so
+ * that one run shows all the failures. main() returns TEST_RESULT().
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static unsigned testFailures = 0;
+
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
+
+#endif // TEST_H
@@ -34,6 +34,8 @@
 --! |-> 0x17: singlyCPActivation
 --! 0x18 - 0x18: uart management
 --! |-> 0x18: if '1', allow streaming of data, disallow (n)ack to rx requests
+--! 0x19 - 0x19: window generator
+--! |-> 0x19: integration window period in ms
 
 library ieee;
 use ieee.std_logic_1164.all;
@@ -59,6 +61,9 @@ entity RegisterFile is
         -- Enable data streaming, hence disallowing (n)ack response to rx uart request
         enableDataStreamUartxDO : out std_logic;
 
+        -- Integration window period in ms
+        windowPeriodMsxDO : out unsigned(windowPeriodWidthC - 1 downto 0);
+
         -- Input port
         addressxDI   : in unsigned(registerFileAddressWidthC-1 downto 0); -- Address input
         dataxDI      : in std_logic_vector(registerFileDataWidthC-1 downto 0); -- Data input
@@ -102,6 +107,7 @@ architecture rtl of RegisterFile is
         22 => (0 => accurateRecordTDefault.disableCP3, others => '0'),
         23 => (0 => accurateRecordTDefault.singlyCPActivation, others => '0'),
         24 => (0 => '1', others => '0'),
+        25 => std_logic_vector(to_unsigned(defaultWindowPeriodMsC, registerFileDataWidthC)),
         others => (others => '0')
     );
 
@@ -169,6 +175,8 @@ begin
 
     enableDataStreamUartxDO <= regFilexDP(24)(0);
 
+    windowPeriodMsxDO <= unsigned(regFilexDP(25)(windowPeriodMsxDO'range));
+
     accurateConfigValidxDO <= '1';
 
     requestErrorxDO <= requestErrorxDP;
@@ -163,7 +163,9 @@ architecture rtl of TopLevel is
     signal cp1EndInterval : unsigned(24 - 1 downto 0);
 
     -- Window generator signals
-    signal wind100ms           : std_logic; -- 100ms window
+    signal windPeriod          : std_logic; -- Integration window
+    signal windowPeriodMsConfig : unsigned(windowPeriodWidthC - 1 downto 0); -- Requested period
+    signal windowPeriodMs       : unsigned(windowPeriodWidthC - 1 downto 0); -- Period of the last window
 
 
     -- RegisterFile signals
@@ -280,7 +282,7 @@ begin
             rst => '0',
 
             -- Sampling time, coming from window generator
-            samplexDI => wind100ms,
+            samplexDI => windPeriod,
 
             -- Amout of LSBs of charge counted in the last interval
             chargeMeasurementxDO => chargeMeasurementTmp,
@@ -327,7 +329,9 @@ begin
         port map (
             clk                   => clkGlobal,
             rst                   => '0',
-            wind100msxDO          => wind100ms
+            windowPeriodMsxDI     => windowPeriodMsConfig,
+            windowPeriodMsxDO     => windowPeriodMs,
+            windPeriodxDO         => windPeriod
     );
 
     uartWrapperMcuE : entity work.uartWrapper
@@ -336,7 +340,7 @@ begin
             baudRateG => 19_200,
             parityG => 0,
             parityEoG => '0',
-            txMessageLengthG => 31,
+            txMessageLengthG => 33,
             uartBusWidthG => 8,
             rxMessageLengthG => 6,
             rxMessageHeaderG => x"DD",
@@ -351,7 +355,8 @@ begin
             -- FIXME
             allowRespondToRxxDI => not enableDataStreamUart,
             txSendMessagexDI => voltageChangeRdy,
-            txMessagexDI => sht41Meas.humidity &
+            txMessagexDI => std_logic_vector(windowPeriodMs) &
+                            sht41Meas.humidity &
                             sht41Meas.temperature &
                             std_logic_vector(resize(cp1EndInterval, 32)) &
                             std_logic_vector(resize(cp1StartInterval, 32)) &
@@ -386,6 +391,8 @@ begin
 
             enableDataStreamUartxDO => enableDataStreamUart,
 
+            windowPeriodMsxDO => windowPeriodMsConfig,
+
             -- Input port
             addressxDI   => registerFileAddress,
             dataxDI      => registerFileData,
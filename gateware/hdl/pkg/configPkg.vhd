@@ -51,8 +51,12 @@ package configPkg is
     constant clkFreqMhzC     : real := 25.0;
     --!The period of the clock in nano seconds
     constant clkPeriodNsC    : natural := natural(1000.0 / clkFreqMhzC);
-    --!The 100ms cycle period converted to number of clock cycles
-    constant cyclePeriodC    : natural := 100_000_000 / clkPeriodNsC; --100ms
+    --!The default integration window period in ms
+    constant defaultWindowPeriodMsC : natural := 100;
+    --!The longest integration window period in ms
+    constant maxWindowPeriodMsC     : natural := 1000;
+    --!The width of the window period register and frame field
+    constant windowPeriodWidthC     : natural := 16;
     --!The period at which to read the IVCs ADC
     constant samplePeriodMsC : natural := 1;
     --!The sample period converted to number of clock cycles
@@ -0,0 +1,163 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.configPkg.all;
+
+-- Self-checking testbench for windowGenerator
+--
+-- The period is changed in the middle of a window, shorter and then longer,
+-- and just after a period window. The window in progress must keep its
+-- period, the next ones must last exactly the new one, windowPeriodMsxDO
+-- must give the period of each window just ended, and
+-- wind1msBeforePeriodxDO must come 1ms before each period window.
+entity windowGeneratorTB is
+end entity windowGeneratorTB;
+
+architecture test of windowGeneratorTB is
+    constant CLK_PERIOD : time := clkPeriodNsC * 1 ns;
+    constant ONE_MS     : time := 1 ms;
+
+    signal clk : std_logic := '0';
+    signal rst : std_logic := '0';
+
+    signal windowPeriodMsIn  : unsigned(windowPeriodWidthC - 1 downto 0) :=
+        to_unsigned(defaultWindowPeriodMsC, windowPeriodWidthC);
+    signal windowPeriodMsOut : unsigned(windowPeriodWidthC - 1 downto 0);
+
+    signal windPeriod          : std_logic;
+    signal wind1ms             : std_logic;
+    signal wind1msBeforePeriod : std_logic;
+    signal inhibRst            : std_logic;
+
+    signal lastBeforePeriod : time := 0 ns;
+    signal errors           : natural := 0;
+    signal checkErrors      : natural := 0;
+
+begin
+
+    windowGeneratorE : entity work.windowGenerator
+        port map (
+            clk => clk,
+            rst => rst,
+
+            windowPeriodMsxDI => windowPeriodMsIn,
+            windowPeriodMsxDO => windowPeriodMsOut,
+
+            windPeriodxDO          => windPeriod,
+            wind1msxDO             => wind1ms,
+            wind1msBeforePeriodxDO => wind1msBeforePeriod,
+            inhibRstxDO            => inhibRst
+    );
+
+    -- Clock process
+    clk_process : process
+    begin
+        clk <= '1';
+        wait for CLK_PERIOD/2;
+        clk <= '0';
+        wait for CLK_PERIOD/2;
+    end process;
+
+    -- The 1ms before period window precedes each period window by 1ms
+    beforePeriodCheck : process (clk)
+    begin
+        if rising_edge(clk) then
+            if wind1msBeforePeriod = '1' then
+                lastBeforePeriod <= now;
+            end if;
+            if windPeriod = '1' and now - lastBeforePeriod /= ONE_MS then
+                report "wind1msBeforePeriod " & time'image(now - lastBeforePeriod)
+                    & " before the period window" severity error;
+                checkErrors <= checkErrors + 1;
+            end if;
+        end if;
+    end process beforePeriodCheck;
+
+    -- Stimulus process
+    stimulus : process
+        variable windowStart : time;
+
+        --! Wait for the end of the window in progress
+        procedure waitWindowEnd is
+        begin
+            wait until rising_edge(clk) and windPeriod = '1';
+            windowStart := now;
+        end procedure;
+
+        --! Wait for the end of the next window, check its length and the
+        --! period given for it
+        procedure checkWindow(expected : natural) is
+        begin
+            wait until rising_edge(clk) and windPeriod = '1';
+            if now - windowStart /= expected * ONE_MS then
+                report "Window of " & time'image(now - windowStart) & " instead of "
+                    & natural'image(expected) & " ms" severity error;
+                errors <= errors + 1;
+            end if;
+            windowStart := now;
+
+            -- Updated the cycle after the period window
+            wait until rising_edge(clk);
+            wait for CLK_PERIOD/4;
+            if to_integer(windowPeriodMsOut) /= expected then
+                report "windowPeriodMsxDO " & natural'image(to_integer(windowPeriodMsOut)) & " instead of "
+                    & natural'image(expected) severity error;
+                errors <= errors + 1;
+            end if;
+        end procedure;
+
+        --! Request a period in the middle of a window: the window in progress
+        --! keeps the old one
+        procedure changeMidWindow(oldPeriod : natural; newPeriod : natural; after : time) is
+        begin
+            wait for after;
+            windowPeriodMsIn <= to_unsigned(newPeriod, windowPeriodWidthC);
+            checkWindow(oldPeriod);
+            checkWindow(newPeriod);
+            checkWindow(newPeriod);
+        end procedure;
+    begin
+        report "Starting test" severity note;
+
+        -- Reset
+        wait for CLK_PERIOD;
+        rst <= '1';
+        wait for CLK_PERIOD;
+        rst <= '0';
+
+        -- The first window after the reset is 1ms short
+        waitWindowEnd;
+        checkWindow(100);
+
+        -- Shorter, requested when the counter is already past the new period
+        changeMidWindow(100, 50, 70 ms);
+        -- Longer
+        changeMidWindow(50, 200, 20 ms);
+        -- Shortest, and below it clamped
+        changeMidWindow(200, 2, 150 ms);
+        windowPeriodMsIn <= to_unsigned(0, windowPeriodWidthC);
+        checkWindow(2);
+        checkWindow(2);
+        changeMidWindow(2, 7, 1.5 ms);
+
+        -- Requested in the first ms of a window, before the counter wraps:
+        -- applies to that window
+        waitWindowEnd;
+        wait for 10 * CLK_PERIOD;
+        windowPeriodMsIn <= to_unsigned(30, windowPeriodWidthC);
+        checkWindow(30);
+        checkWindow(30);
+
+        wait for CLK_PERIOD;
+        if errors + checkErrors = 0 then
+            report "Test passed" severity note;
+        else
+            report "Test failed, " & natural'image(errors + checkErrors) & " errors" severity failure;
+        end if;
+        std.env.stop;
+        wait;
+    end process stimulus;
+
+end architecture test;
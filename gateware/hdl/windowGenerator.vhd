@@ -1,7 +1,7 @@
 --! @file windowGenerator.vhd
---! @brief Generates a 1 clock cycle pulse each 1ms, each 100ms and 1ms before
---! the 100ms periods. Also generates an inhibit signal to prevent the IVC from
---! being reset before a window occurs
+--! @brief Generates a 1 clock cycle pulse each 1ms, each integration window
+--! period and 1ms before the end of the window. Also generates an inhibit
+--! signal to prevent the IVC from being reset before a window occurs
 --!
 --! The voltage from the IVC is read each 1ms.  If an IVC reset were to occur
 --! just before the sample window then voltage sample read would occur while the
@@ -11,14 +11,19 @@
 --! window. The inhibit reset signal falls to 0 at the same time as the window.
 --! \n
 --!
---! The 100ms window is also generated which sets the main cycle window for the
---! system. 1ms before the 100ms window occurs (at 99ms after the cycle started)
---! the wind1msBefore100msxDO signal goes high. This is used to read the
+--! The period window is also generated which sets the main cycle window for the
+--! system. Its period is set in ms by windowPeriodMsxDI, from 2ms to
+--! maxWindowPeriodMsC (1000ms by default). A new period is taken 1ms after
+--! a period window, when the period counter wraps to 0, and applies to the
+--! window ending with the next period window. windowPeriodMsxDO gives the
+--! period of the last complete window.
+--! 1ms before the period window occurs (e.g. at 99ms after the cycle started)
+--! the wind1msBeforePeriodxDO signal goes high. This is used to read the
 --! parameters from the ECC BRAM. Reading from this BRAM as late as possible
 --! (1ms before the parameters are used) ensure the data is stored in the ECC
 --! BRAM for as long as possible. Inside the ECC BRAM errors are corrected.
---! When a wind1msBefore100ms window occurs a 1ms window also happens, likewise
---! when a wind100ms window occurs a 1ms window also happens in the same click
+--! When a wind1msBeforePeriod window occurs a 1ms window also happens, likewise
+--! when a windPeriod window occurs a 1ms window also happens in the same click
 --! cycle.
 
 -- Example Outputs:
@@ -32,13 +37,13 @@
 --                                      ^ (always on rising edge of clock, ends along with 1ms falling edge)
 --
 -- clk:                     ____|****|__...__|****|__...__|****|____|****|__...__|****|____|****|____|****|____
---                         |<--------------100 ms ---------------------------------------->|
--- wind100msxDO:           |_____________________________________________________|*********|_____ ......
+--                         |<--------------period (e.g. 100 ms) ----------------------------->|
+-- windPeriodxDO:          |_____________________________________________________|*********|_____ ......
 --                                                                               ^(always on rising edge of clock)
 --                                                        .(always on rising edge of clock)
--- wind1msBefore100msxDO:  |______________________________|*********|___...______________________ ......
+-- wind1msBeforePeriodxDO: |______________________________|*********|___...______________________ ......
 --                                                        |<-------- 1ms ------->|
---                                                        (1ms difference w.r.t. 100ms rising edge)
+--                                                        (1ms difference w.r.t. period rising edge)
 
 -- Copyright (C) CERN CROME Project
 
@@ -48,7 +53,7 @@ library ieee;
 use ieee.std_logic_1164.all;
 --! For using natural type
 use ieee.numeric_std.all;
---! Required for *CLOCK_PERIOD_NS* constant
+--! Required for *CLOCK_PERIOD_NS* and window period constants
 use work.configPkg.all;
 
 
@@ -57,14 +62,19 @@ entity windowGenerator is
         clk : in  std_logic; --! Clock
         rst : in  std_logic; --! Synchronous active high reset signal
 
-        --! Window high for 1 clock cycle each 100ms
-        wind100msxDO          : out std_logic;
+        --! Period of the window in ms, clamped to 2 .. maxWindowPeriodMsC
+        windowPeriodMsxDI      : in  unsigned(windowPeriodWidthC - 1 downto 0);
+        --! Period in ms of the last complete window
+        windowPeriodMsxDO      : out unsigned(windowPeriodWidthC - 1 downto 0);
+
+        --! Window high for 1 clock cycle each period
+        windPeriodxDO          : out std_logic;
         --! Window high for 1 clock cycle each 1ms
-        wind1msxDO            : out std_logic;
-        --! Window high for 1 clock cycle 1ms before the 100ms window, i.e 99ms after the start of the cycle
-        wind1msBefore100msxDO : out std_logic;
+        wind1msxDO             : out std_logic;
+        --! Window high for 1 clock cycle 1ms before the period window, e.g 99ms after the start of a 100ms cycle
+        wind1msBeforePeriodxDO : out std_logic;
         --! High for a specified period before the window to block IVC resets
-        inhibRstxDO           : out std_logic
+        inhibRstxDO            : out std_logic
     );
 end entity windowGenerator;
 
@@ -79,18 +89,24 @@ architecture behavioral of windowGenerator is
 
     --! Convert 1ms to nano seconds and divide by clock freq
     constant oneMsPeriodC        : natural := (1 * 1_000_000) / clkPeriodNsC;
-    constant num1MsCyclesIn100Ms : natural := 100;
 
     --*************************************************************************
     --------------------------------- Signals ---------------------------------
     --*************************************************************************
 
-    signal cnt1msxDP, cnt1msxDN                         : natural range 0 to oneMsPeriodC - 1;
-    signal cnt100msxDP, cnt100msxDN                     : natural range 0 to num1MsCyclesIn100Ms - 1;
-    signal wind1msxDP, wind1msxDN                       : std_logic;
-    signal inhibRstxDP, inhibRstxDN                     : std_logic;
-    signal wind1msBefore100msxDP, wind1msBefore100msxDN : std_logic;
-    signal wind100msxDP, wind100msxDN                   : std_logic;
+    signal cnt1msxDP, cnt1msxDN                           : natural range 0 to oneMsPeriodC - 1;
+    signal cntPeriodxDP, cntPeriodxDN                     : natural range 0 to maxWindowPeriodMsC - 1;
+    signal wind1msxDP, wind1msxDN                         : std_logic;
+    signal inhibRstxDP, inhibRstxDN                       : std_logic;
+    signal wind1msBeforePeriodxDP, wind1msBeforePeriodxDN : std_logic;
+    signal windPeriodxDP, windPeriodxDN                   : std_logic;
+    --! The period counter wraps to 0 at this 1ms tick
+    signal periodWrap                                     : std_logic;
+    --! Requested period, clamped
+    signal periodRequest                                  : natural range 2 to maxWindowPeriodMsC;
+    --! Period of the window in progress and of the last complete one
+    signal periodxDP, periodxDN                           : natural range 2 to maxWindowPeriodMsC;
+    signal lastPeriodxDP, lastPeriodxDN                   : natural range 2 to maxWindowPeriodMsC;
 
 begin
 
@@ -102,19 +118,23 @@ begin
     begin
         if rising_edge(clk) then
             if (rst = '1') then
-                cnt1msxDP             <= 0;
-                wind1msxDP            <= '0';
-                inhibRstxDP           <= '0';
-                cnt100msxDP           <= 0;
-                wind100msxDP          <= '0';
-                wind1msBefore100msxDP <= '0';
+                cnt1msxDP              <= 0;
+                wind1msxDP             <= '0';
+                inhibRstxDP            <= '0';
+                cntPeriodxDP           <= 0;
+                windPeriodxDP          <= '0';
+                wind1msBeforePeriodxDP <= '0';
+                periodxDP              <= defaultWindowPeriodMsC;
+                lastPeriodxDP          <= defaultWindowPeriodMsC;
             else
-                cnt1msxDP             <= cnt1msxDN;
-                wind1msxDP            <= wind1msxDN;
-                inhibRstxDP           <= inhibRstxDN;
-                cnt100msxDP           <= cnt100msxDN;
-                wind100msxDP          <= wind100msxDN;
-                wind1msBefore100msxDP <= wind1msBefore100msxDN;
+                cnt1msxDP              <= cnt1msxDN;
+                wind1msxDP             <= wind1msxDN;
+                inhibRstxDP            <= inhibRstxDN;
+                cntPeriodxDP           <= cntPeriodxDN;
+                windPeriodxDP          <= windPeriodxDN;
+                wind1msBeforePeriodxDP <= wind1msBeforePeriodxDN;
+                periodxDP              <= periodxDN;
+                lastPeriodxDP          <= lastPeriodxDN;
 
             end if;
         end if;
@@ -127,14 +147,27 @@ begin
     cnt1msxDN  <= 0 when cnt1msxDP = oneMsPeriodC - 1 else cnt1msxDP + 1;
     wind1msxDN <= '1' when cnt1msxDN = oneMsPeriodC - 1 else '0';
 
-    cnt100msxDN <= 0 when (cnt100msxDP = num1MsCyclesIn100Ms - 1 and wind1msxDN = '1') else
-                   cnt100msxDP + 1 when wind1msxDN = '1' else
-                   cnt100msxDP;
+    periodRequest <= 2 when windowPeriodMsxDI < 2 else
+                     maxWindowPeriodMsC when windowPeriodMsxDI > maxWindowPeriodMsC else
+                     to_integer(windowPeriodMsxDI);
+
+    periodWrap <= '1' when (cntPeriodxDP = periodxDP - 1 and wind1msxDN = '1') else '0';
+
+    cntPeriodxDN <= 0 when periodWrap = '1' else
+                    cntPeriodxDP + 1 when wind1msxDN = '1' else
+                    cntPeriodxDP;
+
+    -- The period only changes when the counter wraps, 1ms after the period
+    -- window: the counter is then back to 0 and the next window comes
+    -- after exactly the new period, whether shorter or longer.
+    periodxDN     <= periodRequest when periodWrap = '1' else periodxDP;
+    lastPeriodxDN <= periodxDP when windPeriodxDP = '1' else lastPeriodxDP;
 
-    wind100msxDN          <= '1' when (wind1msxDN = '1' and cnt100msxDN = num1MsCyclesIn100Ms - 1) else
-                             '0';
-    wind1msBefore100msxDN <= '1' when (wind1msxDN = '1' and cnt100msxDN = num1MsCyclesIn100Ms - 2) else
-                             '0';
+    -- Compared with the period from the next cycle on, as the counter is
+    windPeriodxDN          <= '1' when (wind1msxDN = '1' and cntPeriodxDN = periodxDN - 1) else
+                              '0';
+    wind1msBeforePeriodxDN <= '1' when (wind1msxDN = '1' and cntPeriodxDN = periodxDN - 2) else
+                              '0';
 
     inhibRstxDN <= '1' when cnt1msxDN > ((oneMsPeriodC - 1) - inhibitIvcRstTimeC) else '0';
 
@@ -142,9 +175,10 @@ begin
     ------------------------------- Set Outputs -------------------------------
     --*************************************************************************
 
-    wind1msxDO            <= wind1msxDP;
-    wind100msxDO          <= wind100msxDP;
-    wind1msBefore100msxDO <= wind1msBefore100msxDP;
-    inhibRstxDO           <= inhibRstxDP;
+    wind1msxDO             <= wind1msxDP;
+    windPeriodxDO          <= windPeriodxDP;
+    wind1msBeforePeriodxDO <= wind1msBeforePeriodxDP;
+    inhibRstxDO            <= inhibRstxDP;
+    windowPeriodMsxDO      <= to_unsigned(lastPeriodxDP, windowPeriodMsxDO'length);
 
 end architecture behavioral;
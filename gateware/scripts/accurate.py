@@ -1,5 +1,5 @@
 # Script that interface with ACCURATE2 evaluation board's FPGA.
-# The communication format is the following (total 31B):
+# The communication format is the following (total 33B):
 # - 1B of header (0xDD) 
 # - 6B: chargeRaw
 # - 4B: cp1Count
@@ -9,6 +9,7 @@
 # - 4B: cp1EndIntervalRaw
 # - 2B: temperatureRaw
 # - 2B: humidityRaw
+# - 2B: periodRaw, integration window period in ms
 
 import typer
 import serial
@@ -108,7 +109,7 @@ def get_current(
     period: Annotated[
         int, typer.Option(
             "--period",
-            help="Sampling period in ms."
+            help="Sampling period in ms, used if the frame does not carry one."
         )
     ] = default_period,
     lsb: Annotated[
@@ -184,6 +185,7 @@ def get_current(
                     cp1EndIntervalRaw = ser.read(4)
                     tempRaw = ser.read(2)
                     humRaw = ser.read(2)
+                    periodRaw = ser.read(2)
                     # Extract data
                     chargeLsb = int.from_bytes(chargeRaw, byteorder='little')
                     cp1Count = int.from_bytes(cp1CountRaw, byteorder='little')
@@ -193,11 +195,13 @@ def get_current(
                     cp1EndInterval = int.from_bytes(cp1EndIntervalRaw, byteorder='little')
                     tempSht41 = int.from_bytes(tempRaw, byteorder='little')
                     humSht41 = int.from_bytes(humRaw, byteorder='little')
+                    framePeriod = int.from_bytes(periodRaw, byteorder='little')
+                    if framePeriod == 0: framePeriod = period
 
 
                     # Instantaneous current
                     charge = chargeLsb * lsb
-                    attoCurrent = charge / (period * 1e-3)
+                    attoCurrent = charge / (framePeriod * 1e-3)
                     femtoCurrent = attoCurrent * 1e-3
                     # Temperature (formula from the SHT41 datasheet)
                     temperature = -45 + 175 * tempSht41 / 65535.0
@@ -218,7 +222,7 @@ def get_current(
 
                     timestamp = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S.%f")
 
-                    ser_data = header + chargeRaw + cp1CountRaw + cp2CountRaw + cp3CountRaw + cp1StartIntervalRaw + cp1EndIntervalRaw + tempRaw + humRaw
+                    ser_data = header + chargeRaw + cp1CountRaw + cp2CountRaw + cp3CountRaw + cp1StartIntervalRaw + cp1EndIntervalRaw + tempRaw + humRaw + periodRaw
 
                     # Log to file in CSV format
                     if log is not None: